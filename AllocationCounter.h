@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+// Debug builds replace the global operator new with one that counts calls, so code that must not
+// touch the heap (a steady-state simulation step) can assert that it didn't
+#if defined(_DEBUG) && !defined(ALLOCATION_COUNTER)
+#define ALLOCATION_COUNTER 1
+#endif
+
+#ifdef ALLOCATION_COUNTER
+// Heap allocations made through operator new on any thread since startup
+uint64_t getAllocationCount();
+#endif
@@ -0,0 +1,221 @@
+#include "BatchRenderer.h"
+
+#include <algorithm>
+#include <cstddef>
+
+// Vertex shader source code: vertices arrive already in place, only the view is applied here
+const char* batchVertexShaderSource = R"(
+#version 330 core
+layout(location = 0) in vec2 aPos;
+layout(location = 1) in vec4 aColor;
+uniform mat4 transform;
+out vec4 color;
+void main()
+{
+    color = aColor;
+    gl_Position = transform * vec4(aPos, 0.0, 1.0);
+}
+)";
+
+// Fragment shader source code for the default flat-colour material
+const char* batchFragmentShaderSource = R"(
+#version 330 core
+in vec4 color;
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = color;
+}
+)";
+
+BatchRenderer::BatchRenderer()
+    : vertexBuffer(0), vao(0), persistent(false), mapped(nullptr), capacity(0), section(0),
+      writeBase(nullptr), vertexCount(0), droppedVertices(0) {
+    for (int i = 0; i < 16; i++) {
+        viewTransform[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+    }
+    for (int s = 0; s < sectionCount; s++) {
+        fences[s] = nullptr;
+    }
+}
+
+void BatchRenderer::init(const float* triangleVertices, const uint16_t* triangleIndices, int triangleIndexCount,
+    const float* squareVertices, const uint16_t* squareIndices, int squareIndexCount, size_t vertexCapacity) {
+    // Unroll the index lists once; every shape is then written as a plain triangle list
+    const float* vertices[2] = { triangleVertices, squareVertices };
+    const uint16_t* indices[2] = { triangleIndices, squareIndices };
+    const int indexCounts[2] = { triangleIndexCount, squareIndexCount };
+    for (int mesh = 0; mesh < 2; mesh++) {
+        meshes[mesh].positions.clear();
+        for (int i = 0; i < indexCounts[mesh]; i++) {
+            meshes[mesh].positions.push_back(vertices[mesh][indices[mesh][i] * 3]);
+            meshes[mesh].positions.push_back(vertices[mesh][indices[mesh][i] * 3 + 1]);
+        }
+    }
+
+    addMaterial(batchFragmentShaderSource);
+
+    persistent = GLEW_ARB_buffer_storage != 0;
+    glGenVertexArrays(1, &vao);
+    allocate(std::max<size_t>(vertexCapacity, 1));
+}
+
+uint32_t BatchRenderer::addMaterial(const char* fragmentSource) {
+    Material material;
+    material.shader = ShaderProgram(createShaderProgram(batchVertexShaderSource, fragmentSource));
+    material.transformUniform = material.shader.getUniform("transform");
+    materials.push_back(material);
+    return static_cast<uint32_t>(materials.size() - 1);
+}
+
+void BatchRenderer::setViewTransform(const float* matrix) {
+    std::copy(matrix, matrix + 16, viewTransform);
+}
+
+void BatchRenderer::waitForSection(int index) {
+    if (!fences[index]) {
+        return;
+    }
+    // The section was submitted two frames ago, so the fence has almost always passed already
+    GLenum result = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (result == GL_TIMEOUT_EXPIRED) {
+        result = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    }
+    glDeleteSync(fences[index]);
+    fences[index] = nullptr;
+}
+
+void BatchRenderer::allocate(size_t vertexCapacity) {
+    // Immutable storage can't be resized: retire the old buffer once the GPU is done with it
+    if (vertexBuffer) {
+        for (int s = 0; s < sectionCount; s++) {
+            waitForSection(s);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        if (mapped) {
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            mapped = nullptr;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDeleteBuffers(1, &vertexBuffer);
+    }
+
+    capacity = vertexCapacity;
+    const GLsizeiptr bytes = static_cast<GLsizeiptr>(sectionCount * capacity * sizeof(BatchVertex));
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    if (persistent) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, bytes, nullptr, flags);
+        mapped = static_cast<BatchVertex*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags));
+    }
+    else {
+        glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    }
+
+    glBindVertexArray(vao);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)offsetof(BatchVertex, x));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(BatchVertex), (void*)offsetof(BatchVertex, color));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void BatchRenderer::reserve(size_t count) {
+    if (count > capacity) {
+        allocate(std::max(count, capacity * 2));
+    }
+}
+
+void BatchRenderer::begin() {
+    waitForSection(section);
+    vertexCount = 0;
+    runs.clear();
+
+    const size_t sectionStart = section * capacity;
+    if (persistent) {
+        writeBase = mapped ? mapped + sectionStart : nullptr;
+    }
+    else {
+        // The fence already guarantees the GPU is done with this range, so skip the driver's own sync
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        writeBase = static_cast<BatchVertex*>(glMapBufferRange(GL_ARRAY_BUFFER,
+            static_cast<GLintptr>(sectionStart * sizeof(BatchVertex)), static_cast<GLsizeiptr>(capacity * sizeof(BatchVertex)),
+            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
+
+void BatchRenderer::addTriangle(const InstanceData& instance, uint32_t material) {
+    addMesh(meshes[0], instance, material);
+}
+
+void BatchRenderer::addSquare(const InstanceData& instance, uint32_t material) {
+    addMesh(meshes[1], instance, material);
+}
+
+void BatchRenderer::addMesh(const Mesh& mesh, const InstanceData& instance, uint32_t material) {
+    const size_t count = mesh.positions.size() / 2;
+    if (!writeBase || vertexCount + count > capacity) {
+        droppedVertices += count;
+        return;
+    }
+
+    BatchVertex vertex;
+    for (int c = 0; c < 4; c++) {
+        const float channel = std::min(std::max(instance.color[c], 0.0f), 1.0f);
+        vertex.color[c] = static_cast<uint8_t>(channel * 255.0f + 0.5f);
+    }
+    // Whole vertices, front to back: the mapping may be write-combined memory
+    BatchVertex* out = writeBase + vertexCount;
+    for (size_t i = 0; i < count; i++) {
+        vertex.x = mesh.positions[i * 2] * instance.scaleX + instance.offsetX;
+        vertex.y = mesh.positions[i * 2 + 1] * instance.scaleY + instance.offsetY;
+        out[i] = vertex;
+    }
+
+    if (!runs.empty() && runs.back().material == material) {
+        runs.back().count += static_cast<GLsizei>(count);
+    }
+    else {
+        Run run = { material, static_cast<GLint>(vertexCount), static_cast<GLsizei>(count) };
+        runs.push_back(run);
+    }
+    vertexCount += count;
+}
+
+void BatchRenderer::draw(GpuTimer* timer) {
+    if (!persistent && writeBase) {
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    writeBase = nullptr;
+
+    if (timer) {
+        timer->beginPass("batch");
+    }
+    glBindVertexArray(vao);
+    const GLint sectionStart = static_cast<GLint>(section * capacity);
+    uint32_t boundMaterial = 0xFFFFFFFFu;
+    for (size_t r = 0; r < runs.size(); r++) {
+        const Run& run = runs[r];
+        if (run.material != boundMaterial) {
+            const Material& material = materials[run.material];
+            material.shader.use();
+            material.shader.setMat4(material.transformUniform, viewTransform, true);
+            boundMaterial = run.material;
+        }
+        glDrawArrays(GL_TRIANGLES, sectionStart + run.first, run.count);
+    }
+    glBindVertexArray(0);
+    if (timer) {
+        timer->endPass();
+    }
+
+    // The section may be written again once the GPU has passed this point
+    fences[section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    section = (section + 1) % sectionCount;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "GpuTimer.h"
+#include "InstancedRenderer.h"
+#include "ShaderProgram.h"
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+// Vertex written by the batch renderer: already moved into place, colour packed to RGBA8
+struct BatchVertex {
+    float x;
+    float y;
+    uint8_t color[4];
+};
+
+// Flat-colour material every batch renderer starts with
+const uint32_t defaultBatchMaterial = 0;
+
+// Draws every shape from one stream of pre-transformed vertices. The stream lives in a single
+// buffer split into three sections, one per frame in flight, so the CPU fills one section while the
+// GPU still reads the other two; a fence per section makes the CPU wait only if it laps the GPU.
+// With ARB_buffer_storage the buffer is mapped once, persistently, and written straight into;
+// without it each section is mapped unsynchronized for the frame instead. Neither path copies
+// through glBufferSubData. Consecutive shapes with the same material share a draw call, so
+// submitting shapes grouped by material costs one draw per material.
+class BatchRenderer {
+public:
+    BatchRenderer();
+
+    // Keeps the meshes (x, y, z per vertex, triangle-list indices) for addTriangle/addSquare,
+    // builds the default material and allocates room for `vertexCapacity` vertices per frame
+    void init(const float* triangleVertices, const uint16_t* triangleIndices, int triangleIndexCount,
+        const float* squareVertices, const uint16_t* squareIndices, int squareIndexCount, size_t vertexCapacity);
+
+    // Builds a material from a fragment shader that reads `in vec4 color`; returns its id
+    uint32_t addMaterial(const char* fragmentSource);
+
+    // Row-major view matrix applied to every vertex; identity until set. Shapes are placed by
+    // their own offsets, so the app leaves it at identity; a camera pan or zoom would go here.
+    void setViewTransform(const float* matrix);
+
+    // Grows the per-frame capacity to at least `vertexCount` vertices. Only call between frames;
+    // growing waits for the GPU to finish with the old buffer.
+    void reserve(size_t vertexCount);
+
+    // Claims the next section, waiting on its fence if the GPU is still reading it
+    void begin();
+    // Writes the shape's vertices into the current section. Shapes past the capacity are dropped.
+    void addTriangle(const InstanceData& instance, uint32_t material = defaultBatchMaterial);
+    void addSquare(const InstanceData& instance, uint32_t material = defaultBatchMaterial);
+    // Issues the draws for the section and fences it
+    void draw(GpuTimer* timer = nullptr);
+
+    bool isPersistent() const { return persistent; }
+    // Vertices dropped because a frame ran out of room
+    uint64_t getDroppedVertices() const { return droppedVertices; }
+
+private:
+    static const int sectionCount = 3;
+
+    struct Mesh {
+        std::vector<float> positions;  // x, y per index, unrolled from the index list
+    };
+
+    struct Material {
+        ShaderProgram shader;
+        UniformHandle transformUniform;
+    };
+
+    // Vertices [first, first + count) of the current section drawn with one material
+    struct Run {
+        uint32_t material;
+        GLint first;
+        GLsizei count;
+    };
+
+    BatchRenderer(const BatchRenderer&);
+    BatchRenderer& operator=(const BatchRenderer&);
+
+    void allocate(size_t vertexCount);
+    void waitForSection(int section);
+    void addMesh(const Mesh& mesh, const InstanceData& instance, uint32_t material);
+
+    std::vector<Material> materials;
+    Mesh meshes[2];  // triangle, square
+    float viewTransform[16];
+
+    GLuint vertexBuffer;
+    GLuint vao;
+    bool persistent;
+    BatchVertex* mapped;        // persistent: whole buffer; fallback: current section while mapped
+    size_t capacity;            // vertices per section
+    GLsync fences[sectionCount];
+    int section;
+
+    BatchVertex* writeBase;  // start of the current section
+    size_t vertexCount;      // written this frame
+    std::vector<Run> runs;
+    uint64_t droppedVertices;
+};
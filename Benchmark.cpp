@@ -0,0 +1,339 @@
+#include "Benchmark.h"
+
+#include "Collision.h"
+#include "XorShift.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+namespace {
+
+const size_t benchmarkPairCount = 1 << 16;
+const int benchmarkSamples = 7;
+const double minSampleSeconds = 0.02;
+
+// Outcome each generated pair was built for; grouping by it gives the branch-predictable order
+enum PairClass {
+    Hit,
+    MissLeft,
+    MissRight,
+    MissBelow,
+    MissAbove,
+    PairClassCount
+};
+
+struct PairDataset {
+    std::vector<Aabb> first;
+    std::vector<Aabb> second;
+    std::vector<uint8_t> pairClass;
+};
+
+// Builds `count` pairs of which `hitRatio` overlap; misses are spread evenly over the four sides
+PairDataset generatePairs(size_t count, float hitRatio, bool shuffled, uint64_t seed) {
+    XorShift rng(seed);
+    PairDataset data;
+    data.first.resize(count);
+    data.second.resize(count);
+    data.pairClass.resize(count);
+
+    for (size_t i = 0; i < count; i++) {
+        Aabb a = { rng.range(-10.0f, 10.0f), rng.range(-10.0f, 10.0f), rng.range(0.1f, 1.0f), rng.range(0.1f, 1.0f) };
+        Aabb b = { 0.0f, 0.0f, rng.range(0.1f, 1.0f), rng.range(0.1f, 1.0f) };
+        const float gap = rng.range(0.01f, 1.0f);
+
+        PairClass type = Hit;
+        if (rng.range(0.0f, 1.0f) >= hitRatio) {
+            type = static_cast<PairClass>(MissLeft + rng.next() % 4);
+        }
+
+        // Start from a guaranteed overlap, then push b clear of a on the chosen side
+        b.x = a.x + rng.range(-0.9f * b.width, 0.9f * a.width);
+        b.y = a.y + rng.range(-0.9f * b.height, 0.9f * a.height);
+        switch (type) {
+        case MissLeft: b.x = a.x - b.width - gap; break;
+        case MissRight: b.x = a.x + a.width + gap; break;
+        case MissBelow: b.y = a.y - b.height - gap; break;
+        case MissAbove: b.y = a.y + a.height + gap; break;
+        default: break;
+        }
+
+        data.first[i] = a;
+        data.second[i] = b;
+        data.pairClass[i] = static_cast<uint8_t>(type);
+    }
+
+    // Either group pairs by outcome so every branch sees long runs, or shuffle them
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    if (shuffled) {
+        for (size_t i = count; i > 1; i--) {
+            std::swap(order[i - 1], order[rng.next() % i]);
+        }
+    }
+    else {
+        std::stable_sort(order.begin(), order.end(), [&data](size_t l, size_t r) {
+            return data.pairClass[l] < data.pairClass[r];
+        });
+    }
+
+    PairDataset sorted;
+    sorted.first.resize(count);
+    sorted.second.resize(count);
+    sorted.pairClass.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        sorted.first[i] = data.first[order[i]];
+        sorted.second[i] = data.second[order[i]];
+        sorted.pairClass[i] = data.pairClass[order[i]];
+    }
+    return sorted;
+}
+
+// Hardware branch-miss counter for the calling thread. Only Linux exposes one without extra
+// tooling; everywhere else, or when perf_event is locked down, isAvailable() is false.
+class BranchMissCounter {
+public:
+    BranchMissCounter() : fd(-1) {
+#if defined(__linux__)
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+
+    ~BranchMissCounter() {
+#if defined(__linux__)
+        if (fd >= 0) {
+            close(fd);
+        }
+#endif
+    }
+
+    bool isAvailable() const { return fd >= 0; }
+
+    void start() {
+#if defined(__linux__)
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    // Misses since start(), or -1 if the counter is unavailable
+    int64_t stop() {
+#if defined(__linux__)
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            long long count = 0;
+            if (read(fd, &count, sizeof(count)) == static_cast<ssize_t>(sizeof(count))) {
+                return count;
+            }
+        }
+#endif
+        return -1;
+    }
+
+private:
+    BranchMissCounter(const BranchMissCounter&);
+    BranchMissCounter& operator=(const BranchMissCounter&);
+
+    int fd;
+};
+
+// One pass of each kernel over the dataset. The results are summed so the calls can't be dropped.
+uint64_t passCheckCollision(const PairDataset& data) {
+    uint64_t hits = 0;
+    const size_t count = data.first.size();
+    for (size_t i = 0; i < count; i++) {
+        const Aabb& a = data.first[i];
+        const Aabb& b = data.second[i];
+        hits += checkCollision(a.x, a.y, a.width, a.height, b.x, b.y, b.width, b.height) ? 1 : 0;
+    }
+    return hits;
+}
+
+uint64_t passCheckCollisionDirection(const PairDataset& data) {
+    uint64_t directions = 0;
+    const size_t count = data.first.size();
+    for (size_t i = 0; i < count; i++) {
+        const Aabb& a = data.first[i];
+        const Aabb& b = data.second[i];
+        directions += static_cast<uint64_t>(checkCollisionDirection(a.x, a.y, a.width, a.height, b.x, b.y, b.width, b.height));
+    }
+    return directions;
+}
+
+typedef uint64_t (*PassFunction)(const PairDataset& data);
+
+struct BenchmarkResult {
+    std::string kernel;
+    std::string dataset;
+    std::string order;
+    float hitRatio;
+    double nsPerPair;
+    double pairsPerSecond;
+    double branchMissesPerPair;  // negative when no counter is available
+};
+
+volatile uint64_t benchmarkSink;
+
+// Times one kernel on one dataset: calibrates a pass count that fills minSampleSeconds, then
+// takes the median of several samples. Branch misses come from the median sample's passes.
+BenchmarkResult measure(const char* kernel, PassFunction pass, const PairDataset& data,
+    BranchMissCounter& counter) {
+    typedef std::chrono::steady_clock Clock;
+
+    uint64_t sink = pass(data);  // Warm caches and predictors
+    int passes = 1;
+    for (;;) {
+        const Clock::time_point start = Clock::now();
+        for (int p = 0; p < passes; p++) {
+            sink += pass(data);
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (seconds >= minSampleSeconds || passes >= (1 << 20)) {
+            break;
+        }
+        passes *= 2;
+    }
+
+    std::vector<std::pair<double, int64_t> > samples;
+    for (int s = 0; s < benchmarkSamples; s++) {
+        counter.start();
+        const Clock::time_point start = Clock::now();
+        for (int p = 0; p < passes; p++) {
+            sink += pass(data);
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        const int64_t misses = counter.stop();
+        samples.push_back(std::make_pair(seconds, misses));
+    }
+    benchmarkSink = sink;
+
+    std::sort(samples.begin(), samples.end());
+    const std::pair<double, int64_t>& median = samples[samples.size() / 2];
+    const double pairs = static_cast<double>(passes) * static_cast<double>(data.first.size());
+
+    BenchmarkResult result;
+    result.kernel = kernel;
+    result.nsPerPair = median.first * 1e9 / pairs;
+    result.pairsPerSecond = pairs / median.first;
+    result.branchMissesPerPair = median.second >= 0 ? static_cast<double>(median.second) / pairs : -1.0;
+    result.hitRatio = 0.0f;
+    return result;
+}
+
+bool writeJson(const char* path, const std::vector<BenchmarkResult>& results, bool haveCounters) {
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    out << std::setprecision(6);
+    out << "{\n";
+    out << "  \"pairs\": " << benchmarkPairCount << ",\n";
+    out << "  \"samples\": " << benchmarkSamples << ",\n";
+    out << "  \"branch_counters\": " << (haveCounters ? "true" : "false") << ",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& r = results[i];
+        out << "    {\"kernel\": \"" << r.kernel << "\", \"dataset\": \"" << r.dataset
+            << "\", \"order\": \"" << r.order << "\", \"hit_ratio\": " << r.hitRatio
+            << ", \"ns_per_pair\": " << r.nsPerPair << ", \"pairs_per_sec\": " << r.pairsPerSecond
+            << ", \"branch_misses_per_pair\": ";
+        if (r.branchMissesPerPair >= 0.0) {
+            out << r.branchMissesPerPair;
+        }
+        else {
+            out << "null";
+        }
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+    return static_cast<bool>(out);
+}
+
+} // namespace
+
+int runCollisionBenchmark(const char* jsonPath) {
+    struct DatasetSpec {
+        const char* name;
+        float hitRatio;
+    };
+    const DatasetSpec datasets[] = {
+        { "all_hit", 1.0f },
+        { "all_miss", 0.0f },
+        { "random_10", 0.1f },
+        { "random_50", 0.5f },
+        { "random_90", 0.9f },
+    };
+    struct KernelSpec {
+        const char* name;
+        PassFunction pass;
+    };
+    const KernelSpec kernels[] = {
+        { "checkCollision", passCheckCollision },
+        { "checkCollisionDirection", passCheckCollisionDirection },
+    };
+
+    BranchMissCounter counter;
+    if (!counter.isAvailable()) {
+        std::cout << "Branch-miss counters unavailable; reporting timings only" << std::endl;
+    }
+
+    std::vector<BenchmarkResult> results;
+    std::cout << std::left << std::setw(26) << "kernel" << std::setw(12) << "dataset" << std::setw(10) << "order"
+        << std::right << std::setw(10) << "ns/pair" << std::setw(14) << "Mpairs/sec" << std::setw(14) << "misses/pair" << std::endl;
+    for (size_t d = 0; d < sizeof(datasets) / sizeof(datasets[0]); d++) {
+        for (int shuffled = 0; shuffled < 2; shuffled++) {
+            const PairDataset data = generatePairs(benchmarkPairCount, datasets[d].hitRatio, shuffled != 0, 0x9E3779B97F4A7C15ull + d);
+            for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+                BenchmarkResult result = measure(kernels[k].name, kernels[k].pass, data, counter);
+                result.dataset = datasets[d].name;
+                result.order = shuffled ? "shuffled" : "grouped";
+                result.hitRatio = datasets[d].hitRatio;
+                results.push_back(result);
+
+                std::cout << std::left << std::setw(26) << result.kernel << std::setw(12) << result.dataset << std::setw(10) << result.order
+                    << std::right << std::fixed << std::setprecision(3) << std::setw(10) << result.nsPerPair
+                    << std::setw(14) << result.pairsPerSecond / 1e6 << std::setw(14);
+                if (result.branchMissesPerPair >= 0.0) {
+                    std::cout << result.branchMissesPerPair;
+                }
+                else {
+                    std::cout << "-";
+                }
+                std::cout << std::defaultfloat << std::endl;
+            }
+        }
+    }
+
+    if (!writeJson(jsonPath, results, counter.isAvailable())) {
+        std::cerr << "Failed to write benchmark results to " << jsonPath << std::endl;
+        return -1;
+    }
+    std::cout << "Results written to " << jsonPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// Times checkCollision and checkCollisionDirection over generated pair datasets (all-hit, all-miss
+// and mixed hit ratios, each in grouped and shuffled order). Prints a table and writes the results
+// to `jsonPath` so later kernels can be compared against this scalar baseline. Branch misses are
+// reported where hardware perf counters are available (Linux perf_event), and as null elsewhere.
+// Returns 0 on success, -1 if the JSON file could not be written.
+int runCollisionBenchmark(const char* jsonPath);
@@ -0,0 +1,212 @@
+#include "BodyStore.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define INTEGRATE_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define INTEGRATE_SIMD_SSE2 1
+#endif
+
+BodyStore::BodyStore() : minExtent(std::numeric_limits<float>::infinity()) {
+}
+
+BodyHandle BodyStore::create(float bodyX, float bodyY, float bodyWidth, float bodyHeight, uint32_t bodyFlags,
+    uint32_t bodyShape) {
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else {
+        slot = static_cast<uint32_t>(slots.size());
+        Slot fresh = { 0, 0 };
+        slots.push_back(fresh);
+    }
+
+    slots[slot].dense = static_cast<uint32_t>(size());
+    denseSlots.push_back(slot);
+    x.push_back(bodyX);
+    y.push_back(bodyY);
+    width.push_back(bodyWidth);
+    height.push_back(bodyHeight);
+    velocityX.push_back(0.0f);
+    velocityY.push_back(0.0f);
+    accelerationX.push_back(0.0f);
+    accelerationY.push_back(0.0f);
+    previousX.push_back(bodyX);
+    previousY.push_back(bodyY);
+    flags.push_back(bodyFlags);
+    category.push_back(defaultCollisionCategory);
+    mask.push_back(allCollisionLayers);
+    shape.push_back(bodyShape);
+    minExtent = std::min(minExtent, std::min(bodyWidth, bodyHeight));
+
+    BodyHandle handle = { slot, slots[slot].generation };
+    return handle;
+}
+
+void BodyStore::destroy(BodyHandle handle) {
+    assert(isValid(handle));
+    const uint32_t removed = slots[handle.slot].dense;
+    const uint32_t last = static_cast<uint32_t>(size() - 1);
+    const bool wasSmallest = std::min(width[removed], height[removed]) <= minExtent;
+
+    // Fill the hole with the last body so the arrays stay packed
+    x[removed] = x[last];
+    y[removed] = y[last];
+    width[removed] = width[last];
+    height[removed] = height[last];
+    velocityX[removed] = velocityX[last];
+    velocityY[removed] = velocityY[last];
+    accelerationX[removed] = accelerationX[last];
+    accelerationY[removed] = accelerationY[last];
+    previousX[removed] = previousX[last];
+    previousY[removed] = previousY[last];
+    flags[removed] = flags[last];
+    category[removed] = category[last];
+    mask[removed] = mask[last];
+    shape[removed] = shape[last];
+    denseSlots[removed] = denseSlots[last];
+    slots[denseSlots[removed]].dense = removed;
+
+    x.pop_back();
+    y.pop_back();
+    width.pop_back();
+    height.pop_back();
+    velocityX.pop_back();
+    velocityY.pop_back();
+    accelerationX.pop_back();
+    accelerationY.pop_back();
+    previousX.pop_back();
+    previousY.pop_back();
+    flags.pop_back();
+    category.pop_back();
+    mask.pop_back();
+    shape.pop_back();
+    denseSlots.pop_back();
+
+    // Bumping the generation invalidates every outstanding copy of the handle
+    slots[handle.slot].generation++;
+    freeSlots.push_back(handle.slot);
+
+    // Only losing the smallest body can raise the minimum
+    if (wasSmallest) {
+        minExtent = std::numeric_limits<float>::infinity();
+        for (size_t i = 0; i < size(); i++) {
+            minExtent = std::min(minExtent, std::min(width[i], height[i]));
+        }
+    }
+}
+
+void BodyStore::clear() {
+    for (size_t i = 0; i < denseSlots.size(); i++) {
+        slots[denseSlots[i]].generation++;
+        freeSlots.push_back(denseSlots[i]);
+    }
+    denseSlots.clear();
+    x.clear();
+    y.clear();
+    width.clear();
+    height.clear();
+    velocityX.clear();
+    velocityY.clear();
+    accelerationX.clear();
+    accelerationY.clear();
+    previousX.clear();
+    previousY.clear();
+    flags.clear();
+    category.clear();
+    mask.clear();
+    shape.clear();
+    minExtent = std::numeric_limits<float>::infinity();
+}
+
+void BodyStore::reserve(size_t count) {
+    denseSlots.reserve(count);
+    x.reserve(count);
+    y.reserve(count);
+    width.reserve(count);
+    height.reserve(count);
+    velocityX.reserve(count);
+    velocityY.reserve(count);
+    accelerationX.reserve(count);
+    accelerationY.reserve(count);
+    previousX.reserve(count);
+    previousY.reserve(count);
+    flags.reserve(count);
+    category.reserve(count);
+    mask.reserve(count);
+    shape.reserve(count);
+}
+
+bool BodyStore::isValid(BodyHandle handle) const {
+    return handle.slot < slots.size() && slots[handle.slot].generation == handle.generation
+        && slots[handle.slot].dense < denseSlots.size() && denseSlots[slots[handle.slot].dense] == handle.slot;
+}
+
+size_t BodyStore::indexOf(BodyHandle handle) const {
+    assert(isValid(handle));
+    return slots[handle.slot].dense;
+}
+
+BodyHandle BodyStore::handleAt(size_t index) const {
+    const uint32_t slot = denseSlots[index];
+    BodyHandle handle = { slot, slots[slot].generation };
+    return handle;
+}
+
+void BodyStore::savePreviousPositions(size_t begin, size_t end) {
+    std::copy(x.begin() + begin, x.begin() + end, previousX.begin() + begin);
+    std::copy(y.begin() + begin, y.begin() + end, previousY.begin() + begin);
+}
+
+void BodyStore::integrate(float dt, size_t begin, size_t end) {
+    float* px = x.data();
+    float* py = y.data();
+    float* vx = velocityX.data();
+    float* vy = velocityY.data();
+    const float* ax = accelerationX.data();
+    const float* ay = accelerationY.data();
+
+    // The arrays are 32-byte aligned, so whole blocks from a multiple of 8 take aligned loads. The
+    // lanes multiply and add separately, exactly like the scalar tail, so every body gets the same
+    // result wherever it falls.
+    size_t i = begin;
+#if defined(INTEGRATE_SIMD_AVX2)
+    const __m256 step = _mm256_set1_ps(dt);
+    for (; i + 8 <= end; i += 8) {
+        const __m256 newVx = _mm256_add_ps(_mm256_load_ps(vx + i), _mm256_mul_ps(_mm256_load_ps(ax + i), step));
+        const __m256 newVy = _mm256_add_ps(_mm256_load_ps(vy + i), _mm256_mul_ps(_mm256_load_ps(ay + i), step));
+        _mm256_store_ps(vx + i, newVx);
+        _mm256_store_ps(vy + i, newVy);
+        _mm256_store_ps(px + i, _mm256_add_ps(_mm256_load_ps(px + i), _mm256_mul_ps(newVx, step)));
+        _mm256_store_ps(py + i, _mm256_add_ps(_mm256_load_ps(py + i), _mm256_mul_ps(newVy, step)));
+    }
+#elif defined(INTEGRATE_SIMD_SSE2)
+    const __m128 step = _mm_set1_ps(dt);
+    for (; i + 4 <= end; i += 4) {
+        const __m128 newVx = _mm_add_ps(_mm_load_ps(vx + i), _mm_mul_ps(_mm_load_ps(ax + i), step));
+        const __m128 newVy = _mm_add_ps(_mm_load_ps(vy + i), _mm_mul_ps(_mm_load_ps(ay + i), step));
+        _mm_store_ps(vx + i, newVx);
+        _mm_store_ps(vy + i, newVy);
+        _mm_store_ps(px + i, _mm_add_ps(_mm_load_ps(px + i), _mm_mul_ps(newVx, step)));
+        _mm_store_ps(py + i, _mm_add_ps(_mm_load_ps(py + i), _mm_mul_ps(newVy, step)));
+    }
+#endif
+    for (; i < end; i++) {
+        vx[i] += ax[i] * dt;
+        vy[i] += ay[i] * dt;
+        px[i] += vx[i] * dt;
+        py[i] += vy[i] * dt;
+    }
+}
+
+AabbSoAView BodyStore::view() const {
+    AabbSoAView boxes = { x.data(), y.data(), width.data(), height.data(), size() };
+    return boxes;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "AlignedAllocator.h"
+#include "Collision.h"
+
+#include <cstdint>
+#include <vector>
+
+// Stable reference to a body. Stays valid until that body is destroyed; afterwards the generation
+// no longer matches and isValid() rejects it, even once the slot is reused.
+struct BodyHandle {
+    uint32_t slot;
+    uint32_t generation;
+};
+
+const BodyHandle invalidBodyHandle = { 0xFFFFFFFFu, 0 };
+
+// Shape id for bodies whose box is their exact shape
+const uint32_t noBodyShape = 0xFFFFFFFFu;
+
+// Per-body flag bits
+enum BodyFlags : uint32_t {
+    BodyColliding = 1u << 0,  // Overlapped another body in the last collision pass
+    BodySquare = 1u << 1,     // Drawn with the square mesh instead of the triangle
+    BodyDynamic = 1u << 2,    // Stops at the floor and lands on top of non-dynamic bodies
+    BodyGrounded = 1u << 3,   // Dynamic body that ended the last step standing on something
+};
+
+// All bodies in structure-of-arrays form. Each field is its own 32-byte aligned array indexed by a
+// dense body index, so integration, the broadphase and rendering walk memory front to back. Dense
+// indices move when bodies are destroyed (the last body fills the hole); hold a BodyHandle and
+// look the index up with indexOf() when a reference has to survive that.
+class BodyStore {
+public:
+    typedef std::vector<float, AlignedAllocator<float> > FloatArray;
+    typedef std::vector<uint32_t, AlignedAllocator<uint32_t> > FlagArray;
+    typedef std::vector<uint32_t, AlignedAllocator<uint32_t> > IndexArray;
+
+    BodyStore();
+
+    BodyHandle create(float x, float y, float width, float height, uint32_t flags = 0,
+        uint32_t shape = noBodyShape);
+    void destroy(BodyHandle handle);
+    void clear();
+    void reserve(size_t count);
+
+    bool isValid(BodyHandle handle) const;
+    // Dense index of a valid handle
+    size_t indexOf(BodyHandle handle) const;
+    BodyHandle handleAt(size_t index) const;
+
+    size_t size() const { return x.size(); }
+    // Smallest width or height of any body, infinity when there are none. Kept up to date by
+    // create() and destroy(), so bodies must not be resized through the arrays.
+    float getMinExtent() const { return minExtent; }
+
+    // Copies the current positions of bodies [begin, end) into previousX/previousY; call once at
+    // the start of each step
+    void savePreviousPositions(size_t begin, size_t end);
+    // Semi-implicit Euler step of `dt` seconds for bodies [begin, end): the velocity takes the
+    // acceleration first and the position then moves by the new velocity. Branch free and
+    // vectorised; `begin` must be a multiple of 8 for the aligned loads. Ranges that don't overlap
+    // can run on different threads.
+    void integrate(float dt, size_t begin, size_t end);
+
+    // Current boxes, for the broadphase and batch collision kernels
+    AabbSoAView view() const;
+
+    // Dense arrays; index i in each refers to the same body
+    FloatArray x;
+    FloatArray y;
+    FloatArray width;
+    FloatArray height;
+    FloatArray velocityX;
+    FloatArray velocityY;
+    FloatArray accelerationX;  // constant per body, e.g. gravity; zero for bodies that only move when told
+    FloatArray accelerationY;
+    FloatArray previousX;
+    FloatArray previousY;
+    FlagArray flags;
+    FlagArray category;  // collision layers the body is in, see layersCollide
+    FlagArray mask;      // collision layers the body pairs with
+    IndexArray shape;  // index into the owner's shape table, or noBodyShape
+
+private:
+    struct Slot {
+        uint32_t dense;
+        uint32_t generation;
+    };
+
+    std::vector<Slot> slots;           // indexed by handle slot
+    std::vector<uint32_t> denseSlots;  // dense index -> slot
+    std::vector<uint32_t> freeSlots;
+    float minExtent;
+};
@@ -0,0 +1,410 @@
+#include "Collision.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define COLLISION_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COLLISION_SIMD_SSE2 1
+#endif
+
+void AabbSoA::clear() {
+    x.clear();
+    y.clear();
+    width.clear();
+    height.clear();
+}
+
+void AabbSoA::reserve(size_t count) {
+    x.reserve(count);
+    y.reserve(count);
+    width.reserve(count);
+    height.reserve(count);
+}
+
+void AabbSoA::push(float boxX, float boxY, float boxWidth, float boxHeight) {
+    x.push_back(boxX);
+    y.push_back(boxY);
+    width.push_back(boxWidth);
+    height.push_back(boxHeight);
+}
+
+AabbSoAView AabbSoA::view() const {
+    AabbSoAView result = { x.data(), y.data(), width.data(), height.data(), x.size() };
+    return result;
+}
+
+// Collision detection function for two AABBs (Axis-Aligned Bounding Boxes)
+bool checkCollision(float x1, float y1, float width1, float height1,
+    float x2, float y2, float width2, float height2) {
+    return !(x1 + width1 < x2 || x1 > x2 + width2 || y1 + height1 < y2 || y1 > y2 + height2);
+}
+
+bool computeContact(float x1, float y1, float width1, float height1,
+    float x2, float y2, float width2, float height2, Contact& contact) {
+    // Overlap interval on each axis; plain min/max and selects, no data-dependent branches
+    const float minX = std::max(x1, x2);
+    const float maxX = std::min(x1 + width1, x2 + width2);
+    const float minY = std::max(y1, y2);
+    const float maxY = std::min(y1 + height1, y2 + height2);
+    const float overlapX = maxX - minX;
+    const float overlapY = maxY - minY;
+
+    // How far box 1 has to move down each axis, either way, to clear box 2. That's not the overlap
+    // width when one box spans the other on an axis: pushing out the nearer side is what counts.
+    const float pushLeft = x1 + width1 - x2;
+    const float pushRight = x2 + width2 - x1;
+    const float pushDown = y1 + height1 - y2;
+    const float pushUp = y2 + height2 - y1;
+    const float penetrationX = std::min(pushLeft, pushRight);
+    const float penetrationY = std::min(pushDown, pushUp);
+
+    // Push box 1 out through the nearer side, along the axis of least penetration
+    const float signX = pushLeft < pushRight ? -1.0f : 1.0f;
+    const float signY = pushDown < pushUp ? -1.0f : 1.0f;
+    const bool useX = penetrationX < penetrationY;
+
+    contact.depth = useX ? penetrationX : penetrationY;
+    contact.normalX = useX ? signX : 0.0f;
+    contact.normalY = useX ? 0.0f : signY;
+    contact.mtvX = contact.normalX * contact.depth;
+    contact.mtvY = contact.normalY * contact.depth;
+    contact.pointX = 0.5f * (minX + maxX);
+    contact.pointY = 0.5f * (minY + maxY);
+    return overlapX > 0.0f && overlapY > 0.0f;
+}
+
+int checkCollisionDirection(float x1, float y1, float width1, float height1,
+    float x2, float y2, float width2, float height2) {
+    Contact contact;
+    if (!computeContact(x1, y1, width1, height1, x2, y2, width2, height2, contact)) {
+        return 0; // No collision
+    }
+    if (contact.normalX < 0.0f) {
+        return 1; // Collision from the left
+    }
+    if (contact.normalX > 0.0f) {
+        return 2; // Collision from the right
+    }
+    if (contact.normalY < 0.0f) {
+        return 3; // Collision from the top
+    }
+    return 4; // Collision from the bottom
+}
+
+namespace {
+
+// Entry and exit times of one axis of a swept test, for box 1 moving by `move` relative to box 2.
+// Returns false when the axis never overlaps during the step.
+inline bool sweepAxis(float min1, float size1, float min2, float size2, float move,
+    float& entry, float& exit) {
+    if (move > 0.0f) {
+        entry = (min2 - (min1 + size1)) / move;
+        exit = (min2 + size2 - min1) / move;
+    }
+    else if (move < 0.0f) {
+        entry = (min2 + size2 - min1) / move;
+        exit = (min2 - (min1 + size1)) / move;
+    }
+    else {
+        // Not moving on this axis: it overlaps for the whole step or not at all
+        entry = -std::numeric_limits<float>::infinity();
+        exit = std::numeric_limits<float>::infinity();
+        return !(min1 + size1 < min2 || min1 > min2 + size2);
+    }
+    return true;
+}
+
+} // namespace
+
+bool sweepAabb(const Aabb& box1, float moveX1, float moveY1,
+    const Aabb& box2, float moveX2, float moveY2, SweepHit& hit) {
+    Contact contact;
+    if (computeContact(box1, box2, contact)) {
+        hit.time = 0.0f;
+        hit.normalX = contact.normalX;
+        hit.normalY = contact.normalY;
+        return true;
+    }
+
+    // Work in box 2's frame so only box 1 moves
+    const float moveX = moveX1 - moveX2;
+    const float moveY = moveY1 - moveY2;
+    float entryX, exitX, entryY, exitY;
+    if (!sweepAxis(box1.x, box1.width, box2.x, box2.width, moveX, entryX, exitX)
+        || !sweepAxis(box1.y, box1.height, box2.y, box2.height, moveY, entryY, exitY)) {
+        return false;
+    }
+
+    // They touch once both axes overlap, and stop touching as soon as either separates again
+    const float entry = std::max(entryX, entryY);
+    const float exit = std::min(exitX, exitY);
+    if (entry > exit || entry < 0.0f || entry > 1.0f) {
+        return false;
+    }
+
+    // The axis that was last to start overlapping is the face that was hit
+    const bool hitX = entryX > entryY;
+    hit.time = entry;
+    hit.normalX = hitX ? (moveX > 0.0f ? -1.0f : 1.0f) : 0.0f;
+    hit.normalY = hitX ? 0.0f : (moveY > 0.0f ? -1.0f : 1.0f);
+    return true;
+}
+
+namespace {
+
+// min and max with the operand order of the SSE/AVX instructions, so the scalar slab test rounds
+// to the same times as the packet lanes
+inline float laneMin(float a, float b) {
+    return a < b ? a : b;
+}
+
+inline float laneMax(float a, float b) {
+    return a > b ? a : b;
+}
+
+} // namespace
+
+float rayInverse(float direction) {
+    return std::abs(direction) > 1e-20f ? 1.0f / direction : std::numeric_limits<float>::max();
+}
+
+bool rayCastAabb(const Aabb& box, float originX, float originY, float directionX, float directionY,
+    float maxTime, SweepHit& hit) {
+    // Times at which the ray crosses each slab's two edges; it is inside the box between the
+    // latest entry and the earliest exit
+    const float inverseX = rayInverse(directionX);
+    const float inverseY = rayInverse(directionY);
+    const float x1 = (box.x - originX) * inverseX;
+    const float x2 = (box.x + box.width - originX) * inverseX;
+    const float y1 = (box.y - originY) * inverseY;
+    const float y2 = (box.y + box.height - originY) * inverseY;
+    const float entryX = laneMin(x1, x2);
+    const float entryY = laneMin(y1, y2);
+    const float entry = laneMax(laneMax(entryX, entryY), 0.0f);
+    const float exit = laneMin(laneMax(x1, x2), laneMax(y1, y2));
+    if (!(entry <= exit && entry < maxTime)) {
+        return false;
+    }
+
+    // The slab entered last is the face that was hit, unless the ray was inside both from the start
+    const bool inside = laneMax(entryX, entryY) <= 0.0f;
+    const bool hitX = entryX > entryY;
+    hit.time = entry;
+    hit.normalX = inside || !hitX ? 0.0f : (inverseX > 0.0f ? -1.0f : 1.0f);
+    hit.normalY = inside || hitX ? 0.0f : (inverseY > 0.0f ? -1.0f : 1.0f);
+    return true;
+}
+
+namespace {
+
+#if defined(COLLISION_SIMD_AVX2)
+const size_t kLanes = 8;
+#elif defined(COLLISION_SIMD_SSE2)
+const size_t kLanes = 4;
+#else
+const size_t kLanes = 1;
+#endif
+
+// Tests `box` against kLanes consecutive boxes starting at `i` and returns one bit per lane.
+// Every comparison mirrors checkCollision, so the SIMD lanes give the same answer as the scalar code.
+inline uint32_t overlapLanes(const Aabb& box, const AabbSoAView& boxes, size_t i) {
+#if defined(COLLISION_SIMD_AVX2)
+    const __m256 x1 = _mm256_set1_ps(box.x);
+    const __m256 y1 = _mm256_set1_ps(box.y);
+    const __m256 right1 = _mm256_set1_ps(box.x + box.width);
+    const __m256 top1 = _mm256_set1_ps(box.y + box.height);
+    const __m256 x2 = _mm256_loadu_ps(boxes.x + i);
+    const __m256 y2 = _mm256_loadu_ps(boxes.y + i);
+    const __m256 right2 = _mm256_add_ps(x2, _mm256_loadu_ps(boxes.width + i));
+    const __m256 top2 = _mm256_add_ps(y2, _mm256_loadu_ps(boxes.height + i));
+    __m256 miss = _mm256_cmp_ps(right1, x2, _CMP_LT_OQ);
+    miss = _mm256_or_ps(miss, _mm256_cmp_ps(x1, right2, _CMP_GT_OQ));
+    miss = _mm256_or_ps(miss, _mm256_cmp_ps(top1, y2, _CMP_LT_OQ));
+    miss = _mm256_or_ps(miss, _mm256_cmp_ps(y1, top2, _CMP_GT_OQ));
+    return ~static_cast<uint32_t>(_mm256_movemask_ps(miss)) & 0xFFu;
+#elif defined(COLLISION_SIMD_SSE2)
+    const __m128 x1 = _mm_set1_ps(box.x);
+    const __m128 y1 = _mm_set1_ps(box.y);
+    const __m128 right1 = _mm_set1_ps(box.x + box.width);
+    const __m128 top1 = _mm_set1_ps(box.y + box.height);
+    const __m128 x2 = _mm_loadu_ps(boxes.x + i);
+    const __m128 y2 = _mm_loadu_ps(boxes.y + i);
+    const __m128 right2 = _mm_add_ps(x2, _mm_loadu_ps(boxes.width + i));
+    const __m128 top2 = _mm_add_ps(y2, _mm_loadu_ps(boxes.height + i));
+    __m128 miss = _mm_cmplt_ps(right1, x2);
+    miss = _mm_or_ps(miss, _mm_cmpgt_ps(x1, right2));
+    miss = _mm_or_ps(miss, _mm_cmplt_ps(top1, y2));
+    miss = _mm_or_ps(miss, _mm_cmpgt_ps(y1, top2));
+    return ~static_cast<uint32_t>(_mm_movemask_ps(miss)) & 0xFu;
+#else
+    return checkCollision(box.x, box.y, box.width, box.height,
+        boxes.x[i], boxes.y[i], boxes.width[i], boxes.height[i]) ? 1u : 0u;
+#endif
+}
+
+// Scalar reference test used for the tail that doesn't fill a whole SIMD block
+inline uint32_t overlapScalar(const Aabb& box, const AabbSoAView& boxes, size_t i) {
+    return checkCollision(box.x, box.y, box.width, box.height,
+        boxes.x[i], boxes.y[i], boxes.width[i], boxes.height[i]) ? 1u : 0u;
+}
+
+} // namespace
+
+void checkCollisionBatch(const Aabb& box, const AabbSoAView& boxes, uint64_t* hitMask) {
+    // std::fill rather than memset: an empty list may come with a null mask
+    std::fill(hitMask, hitMask + collisionMaskWords(boxes.count), 0ull);
+
+    // kLanes divides 64, so a block never straddles two mask words
+    size_t i = 0;
+    for (; i + kLanes <= boxes.count; i += kLanes) {
+        hitMask[i >> 6] |= static_cast<uint64_t>(overlapLanes(box, boxes, i)) << (i & 63);
+    }
+    for (; i < boxes.count; i++) {
+        hitMask[i >> 6] |= static_cast<uint64_t>(overlapScalar(box, boxes, i)) << (i & 63);
+    }
+}
+
+size_t checkCollisionBatchIndices(const Aabb& box, const AabbSoAView& boxes, uint32_t* outIndices) {
+    size_t hitCount = 0;
+    size_t i = 0;
+    for (; i + kLanes <= boxes.count; i += kLanes) {
+        uint32_t bits = overlapLanes(box, boxes, i);
+        // Branch-free compaction: always write, only advance on a hit
+        for (size_t lane = 0; lane < kLanes; lane++) {
+            outIndices[hitCount] = static_cast<uint32_t>(i + lane);
+            hitCount += (bits >> lane) & 1u;
+        }
+    }
+    for (; i < boxes.count; i++) {
+        outIndices[hitCount] = static_cast<uint32_t>(i);
+        hitCount += overlapScalar(box, boxes, i);
+    }
+    return hitCount;
+}
+
+void filterCollidingPairs(const AabbSoAView& boxes, const std::vector<CollisionPair>& candidates,
+    std::vector<CollisionPair>& outPairs) {
+    for (size_t i = 0; i < candidates.size(); i++) {
+        const CollisionPair& pair = candidates[i];
+        if (checkCollision(boxes.x[pair.a], boxes.y[pair.a], boxes.width[pair.a], boxes.height[pair.a],
+            boxes.x[pair.b], boxes.y[pair.b], boxes.width[pair.b], boxes.height[pair.b])) {
+            outPairs.push_back(pair);
+        }
+    }
+}
+
+void computeContacts(const AabbSoAView& boxes, const std::vector<CollisionPair>& pairs,
+    std::vector<PairContact>& outContacts) {
+    // Write every result into place and only keep the overlapping ones, so the loop body has
+    // no branch on the outcome
+    size_t count = outContacts.size();
+    outContacts.resize(count + pairs.size());
+    for (size_t i = 0; i < pairs.size(); i++) {
+        const CollisionPair& pair = pairs[i];
+        PairContact& out = outContacts[count];
+        out.pair = pair;
+        const bool hit = computeContact(boxes.x[pair.a], boxes.y[pair.a], boxes.width[pair.a], boxes.height[pair.a],
+            boxes.x[pair.b], boxes.y[pair.b], boxes.width[pair.b], boxes.height[pair.b], out.contact);
+        count += hit ? 1 : 0;
+    }
+    outContacts.resize(count);
+}
+
+void checkCollisionBatchPairs(const AabbSoAView& a, const AabbSoAView& b, std::vector<CollisionPair>& outPairs) {
+    for (size_t j = 0; j < a.count; j++) {
+        const Aabb box = { a.x[j], a.y[j], a.width[j], a.height[j] };
+        const uint32_t boxIndex = static_cast<uint32_t>(j);
+
+        size_t i = 0;
+        for (; i + kLanes <= b.count; i += kLanes) {
+            uint32_t bits = overlapLanes(box, b, i);
+            for (size_t lane = 0; bits != 0; lane++, bits >>= 1) {
+                if (bits & 1u) {
+                    CollisionPair pair = { boxIndex, static_cast<uint32_t>(i + lane) };
+                    outPairs.push_back(pair);
+                }
+            }
+        }
+        for (; i < b.count; i++) {
+            if (overlapScalar(box, b, i)) {
+                CollisionPair pair = { boxIndex, static_cast<uint32_t>(i) };
+                outPairs.push_back(pair);
+            }
+        }
+    }
+}
+
+void rayCastAabbPacket(const Aabb& box, uint32_t boxIndex, RayPacket& packet) {
+    const float right = box.x + box.width;
+    const float top = box.y + box.height;
+
+    // rayPacketSize is a multiple of kLanes, so there is no scalar tail
+#if defined(COLLISION_SIMD_AVX2)
+    const __m256 boxX = _mm256_set1_ps(box.x);
+    const __m256 boxY = _mm256_set1_ps(box.y);
+    const __m256 boxRight = _mm256_set1_ps(right);
+    const __m256 boxTop = _mm256_set1_ps(top);
+    const __m256i index = _mm256_set1_epi32(static_cast<int>(boxIndex));
+    for (size_t i = 0; i < rayPacketSize; i += kLanes) {
+        const __m256 originX = _mm256_loadu_ps(packet.originX + i);
+        const __m256 originY = _mm256_loadu_ps(packet.originY + i);
+        const __m256 inverseX = _mm256_loadu_ps(packet.inverseX + i);
+        const __m256 inverseY = _mm256_loadu_ps(packet.inverseY + i);
+        const __m256 x1 = _mm256_mul_ps(_mm256_sub_ps(boxX, originX), inverseX);
+        const __m256 x2 = _mm256_mul_ps(_mm256_sub_ps(boxRight, originX), inverseX);
+        const __m256 y1 = _mm256_mul_ps(_mm256_sub_ps(boxY, originY), inverseY);
+        const __m256 y2 = _mm256_mul_ps(_mm256_sub_ps(boxTop, originY), inverseY);
+        const __m256 entry = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(x1, x2), _mm256_min_ps(y1, y2)), _mm256_setzero_ps());
+        const __m256 exit = _mm256_min_ps(_mm256_max_ps(x1, x2), _mm256_max_ps(y1, y2));
+        const __m256 time = _mm256_loadu_ps(packet.time + i);
+        const __m256 nearer = _mm256_and_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ), _mm256_cmp_ps(entry, time, _CMP_LT_OQ));
+        _mm256_storeu_ps(packet.time + i, _mm256_blendv_ps(time, entry, nearer));
+        __m256i* hit = reinterpret_cast<__m256i*>(packet.hit + i);
+        const __m256 hits = _mm256_castsi256_ps(_mm256_loadu_si256(hit));
+        _mm256_storeu_si256(hit, _mm256_castps_si256(_mm256_blendv_ps(hits, _mm256_castsi256_ps(index), nearer)));
+    }
+#elif defined(COLLISION_SIMD_SSE2)
+    const __m128 boxX = _mm_set1_ps(box.x);
+    const __m128 boxY = _mm_set1_ps(box.y);
+    const __m128 boxRight = _mm_set1_ps(right);
+    const __m128 boxTop = _mm_set1_ps(top);
+    const __m128i index = _mm_set1_epi32(static_cast<int>(boxIndex));
+    for (size_t i = 0; i < rayPacketSize; i += kLanes) {
+        const __m128 originX = _mm_loadu_ps(packet.originX + i);
+        const __m128 originY = _mm_loadu_ps(packet.originY + i);
+        const __m128 inverseX = _mm_loadu_ps(packet.inverseX + i);
+        const __m128 inverseY = _mm_loadu_ps(packet.inverseY + i);
+        const __m128 x1 = _mm_mul_ps(_mm_sub_ps(boxX, originX), inverseX);
+        const __m128 x2 = _mm_mul_ps(_mm_sub_ps(boxRight, originX), inverseX);
+        const __m128 y1 = _mm_mul_ps(_mm_sub_ps(boxY, originY), inverseY);
+        const __m128 y2 = _mm_mul_ps(_mm_sub_ps(boxTop, originY), inverseY);
+        const __m128 entry = _mm_max_ps(_mm_max_ps(_mm_min_ps(x1, x2), _mm_min_ps(y1, y2)), _mm_setzero_ps());
+        const __m128 exit = _mm_min_ps(_mm_max_ps(x1, x2), _mm_max_ps(y1, y2));
+        const __m128 time = _mm_loadu_ps(packet.time + i);
+        const __m128i nearer = _mm_castps_si128(_mm_and_ps(_mm_cmple_ps(entry, exit), _mm_cmplt_ps(entry, time)));
+        // No blend instruction before SSE4.1: keep the old lanes where the mask is clear
+        _mm_storeu_ps(packet.time + i, _mm_or_ps(_mm_and_ps(_mm_castsi128_ps(nearer), entry),
+            _mm_andnot_ps(_mm_castsi128_ps(nearer), time)));
+        __m128i* hit = reinterpret_cast<__m128i*>(packet.hit + i);
+        _mm_storeu_si128(hit, _mm_or_si128(_mm_and_si128(nearer, index), _mm_andnot_si128(nearer, _mm_loadu_si128(hit))));
+    }
+#else
+    for (size_t i = 0; i < rayPacketSize; i++) {
+        const float x1 = (box.x - packet.originX[i]) * packet.inverseX[i];
+        const float x2 = (right - packet.originX[i]) * packet.inverseX[i];
+        const float y1 = (box.y - packet.originY[i]) * packet.inverseY[i];
+        const float y2 = (top - packet.originY[i]) * packet.inverseY[i];
+        const float entry = laneMax(laneMax(laneMin(x1, x2), laneMin(y1, y2)), 0.0f);
+        const float exit = laneMin(laneMax(x1, x2), laneMax(y1, y2));
+        if (entry <= exit && entry < packet.time[i]) {
+            packet.time[i] = entry;
+            packet.hit[i] = boxIndex;
+        }
+    }
+#endif
+}
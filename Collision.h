@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Axis-aligned bounding box using the same x/y/width/height convention as checkCollision
+struct Aabb {
+    float x;
+    float y;
+    float width;
+    float height;
+};
+
+// Pair of body indices produced by the batch kernels and the broadphase
+struct CollisionPair {
+    uint32_t a;
+    uint32_t b;
+};
+
+// Collision layers. A body's category bits say which of the layers it belongs to and its mask which
+// layers it pairs with; a pair only reaches the narrowphase when each side's mask accepts the other
+// side's category. New bodies sit in the default layer and pair with everything.
+const int collisionLayerCount = 32;
+const uint32_t defaultCollisionCategory = 1u << 0;
+const uint32_t allCollisionLayers = 0xFFFFFFFFu;
+
+inline bool layersCollide(uint32_t categoryA, uint32_t maskA, uint32_t categoryB, uint32_t maskB) {
+    return (categoryA & maskB) != 0 && (categoryB & maskA) != 0;
+}
+
+// Layer a category is counted under in per-layer statistics: its lowest set bit
+inline int collisionLayerOf(uint32_t category) {
+    // De Bruijn multiply on the isolated lowest bit; no compiler intrinsics needed
+    static const int bitPositions[32] = {
+        0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+        31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9 };
+    return bitPositions[((category & (0u - category)) * 0x077CB531u) >> 27];
+}
+
+// Slot of the unordered layer pair (a, b) in a table of collisionLayerCount * collisionLayerCount
+inline int layerPairIndex(int a, int b) {
+    return a < b ? a * collisionLayerCount + b : b * collisionLayerCount + a;
+}
+
+// Contact between two overlapping boxes. The normal is a unit axis pointing from box 2 towards
+// box 1; moving box 1 by the minimum-translation vector (mtvX, mtvY) = normal * depth separates them.
+// The contact point is the centre of the overlap region.
+struct Contact {
+    float mtvX;
+    float mtvY;
+    float depth;
+    float normalX;
+    float normalY;
+    float pointX;
+    float pointY;
+};
+
+// First touch between two moving boxes, as found by sweepAabb. `time` is the fraction of the step
+// in [0, 1] at which they meet; the normal follows the Contact convention (box 2 towards box 1).
+struct SweepHit {
+    float time;
+    float normalX;
+    float normalY;
+};
+
+// Contact for one broadphase pair, as written by computeContacts
+struct PairContact {
+    CollisionPair pair;
+    Contact contact;
+};
+
+// Read-only structure-of-arrays view over a set of boxes
+struct AabbSoAView {
+    const float* x;
+    const float* y;
+    const float* width;
+    const float* height;
+    size_t count;
+};
+
+// Owning structure-of-arrays box storage
+struct AabbSoA {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> width;
+    std::vector<float> height;
+
+    size_t size() const { return x.size(); }
+    void clear();
+    void reserve(size_t count);
+    void push(float boxX, float boxY, float boxWidth, float boxHeight);
+    AabbSoAView view() const;
+};
+
+// Collision detection function for two AABBs (Axis-Aligned Bounding Boxes)
+bool checkCollision(float x1, float y1, float width1, float height1,
+    float x2, float y2, float width2, float height2);
+
+inline bool checkCollision(const Aabb& a, const Aabb& b) {
+    return checkCollision(a.x, a.y, a.width, a.height, b.x, b.y, b.width, b.height);
+}
+
+// Fills `contact` for boxes 1 and 2 and returns true when they overlap with positive depth on
+// both axes. The separating axis is the one with the smaller penetration.
+bool computeContact(float x1, float y1, float width1, float height1,
+    float x2, float y2, float width2, float height2, Contact& contact);
+
+inline bool computeContact(const Aabb& a, const Aabb& b, Contact& contact) {
+    return computeContact(a.x, a.y, a.width, a.height, b.x, b.y, b.width, b.height, contact);
+}
+
+// Side of box 2 that box 1 hits: 1 left, 2 right, 3 top, 4 bottom, 0 no collision.
+// Derived from computeContact, so the side is the one with the least penetration.
+int checkCollisionDirection(float x1, float y1, float width1, float height1,
+    float x2, float y2, float width2, float height2);
+
+// Swept test for box 1 moving by (moveX1, moveY1) and box 2 by (moveX2, moveY2) over one step.
+// Returns true and fills `hit` if they touch at some point of the step. Boxes that already overlap
+// at the start report time 0 with the computeContact normal. Pass zero motion for a static box.
+bool sweepAabb(const Aabb& box1, float moveX1, float moveY1,
+    const Aabb& box2, float moveX2, float moveY2, SweepHit& hit);
+
+// Reciprocal of a ray direction component for the slab tests. Zero and near-zero components get
+// the largest float instead of infinity, so an origin exactly on a slab edge never makes 0 * inf.
+float rayInverse(float direction);
+
+// Slab test of the ray origin + direction * t against the closed box, for t in [0, maxTime). Fills
+// `hit` with the time the ray enters the box and the normal of the face it enters through (against
+// the ray, as in SweepHit). A ray that starts inside the box or on its edge hits it at time 0 with
+// a zero normal. Casting a box is the same test from the cast box's min corner against the target
+// grown by the cast box's size on its low sides.
+bool rayCastAabb(const Aabb& box, float originX, float originY, float directionX, float directionY,
+    float maxTime, SweepHit& hit);
+
+// Rays in structure-of-arrays form
+struct RaySoAView {
+    const float* originX;
+    const float* originY;
+    const float* directionX;
+    const float* directionY;
+    size_t count;
+};
+
+// Rays that rayCastAabbPacket tests against one box together, one SIMD lane each. Lanes past
+// `count` keep a time below zero, which no box can beat.
+const size_t rayPacketSize = 16;
+const uint32_t noRayHit = 0xFFFFFFFFu;
+
+struct RayPacket {
+    float originX[rayPacketSize];
+    float originY[rayPacketSize];
+    float directionX[rayPacketSize];
+    float directionY[rayPacketSize];
+    float inverseX[rayPacketSize];  // rayInverse of each direction
+    float inverseY[rayPacketSize];
+    float time[rayPacketSize];      // nearest hit so far; starts at the cast's max time
+    uint32_t hit[rayPacketSize];    // box index of that hit, noRayHit until there is one
+    size_t count;
+};
+
+// Tests `box` against every ray of the packet and, for the rays it stops sooner than their
+// nearest hit so far, records the entry time and `boxIndex`. Vectorised across the rays; every
+// time matches rayCastAabb's for the same ray and box exactly.
+void rayCastAabbPacket(const Aabb& box, uint32_t boxIndex, RayPacket& packet);
+
+// Number of 64-bit words needed to hold one hit bit per box
+inline size_t collisionMaskWords(size_t count) {
+    return (count + 63) / 64;
+}
+
+// Tests one box against every box in `boxes` and writes one bit per box into `hitMask`
+// (collisionMaskWords(boxes.count) words). Results match checkCollision exactly.
+void checkCollisionBatch(const Aabb& box, const AabbSoAView& boxes, uint64_t* hitMask);
+
+// Same test as checkCollisionBatch, but writes the indices of hit boxes into `outIndices`
+// (which must hold boxes.count entries) and returns how many were written
+size_t checkCollisionBatchIndices(const Aabb& box, const AabbSoAView& boxes, uint32_t* outIndices);
+
+// Runs checkCollision on each broadphase candidate pair and appends the ones that overlap
+void filterCollidingPairs(const AabbSoAView& boxes, const std::vector<CollisionPair>& candidates,
+    std::vector<CollisionPair>& outPairs);
+
+// Runs computeContact on each pair and appends a PairContact for every one that overlaps
+void computeContacts(const AabbSoAView& boxes, const std::vector<CollisionPair>& pairs,
+    std::vector<PairContact>& outContacts);
+
+// Tests every box in `a` against every box in `b` and appends the overlapping (a, b) index pairs
+void checkCollisionBatchPairs(const AabbSoAView& a, const AabbSoAView& b, std::vector<CollisionPair>& outPairs);
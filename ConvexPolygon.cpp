@@ -0,0 +1,112 @@
+#include "ConvexPolygon.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+ConvexPolygon makeConvexPolygon(const float* vertices, int count, int stride) {
+    assert(count >= 3 && count <= maxPolygonVertices);
+    ConvexPolygon polygon = {};
+
+    float minX = vertices[0];
+    float minY = vertices[1];
+    float maxX = vertices[0];
+    float maxY = vertices[1];
+    for (int i = 1; i < count; i++) {
+        minX = std::min(minX, vertices[i * stride]);
+        minY = std::min(minY, vertices[i * stride + 1]);
+        maxX = std::max(maxX, vertices[i * stride]);
+        maxY = std::max(maxY, vertices[i * stride + 1]);
+    }
+    polygon.width = maxX - minX;
+    polygon.height = maxY - minY;
+    polygon.meshOffsetX = -minX;
+    polygon.meshOffsetY = -minY;
+
+    // Shoelace sign tells the winding; store counter-clockwise so edge normals point outwards
+    float twiceArea = 0.0f;
+    for (int i = 0; i < count; i++) {
+        const int j = (i + 1) % count;
+        twiceArea += vertices[i * stride] * vertices[j * stride + 1] - vertices[j * stride] * vertices[i * stride + 1];
+    }
+    polygon.vertexCount = count;
+    for (int i = 0; i < count; i++) {
+        const int source = twiceArea >= 0.0f ? i : count - 1 - i;
+        polygon.vertexX[i] = vertices[source * stride] - minX;
+        polygon.vertexY[i] = vertices[source * stride + 1] - minY;
+    }
+
+    polygon.axisCount = 0;
+    for (int i = 0; i < count; i++) {
+        const int j = (i + 1) % count;
+        const float edgeX = polygon.vertexX[j] - polygon.vertexX[i];
+        const float edgeY = polygon.vertexY[j] - polygon.vertexY[i];
+        const float length = std::sqrt(edgeX * edgeX + edgeY * edgeY);
+        if (length <= 0.0f) {
+            continue;
+        }
+        const float normalX = edgeY / length;
+        const float normalY = -edgeX / length;
+
+        // Opposite edges of a quad share an axis; testing it twice gains nothing
+        bool duplicate = false;
+        for (int a = 0; a < polygon.axisCount; a++) {
+            if (std::fabs(polygon.axisX[a] * normalY - polygon.axisY[a] * normalX) < 1e-6f) {
+                duplicate = true;
+                break;
+            }
+        }
+        if (duplicate) {
+            continue;
+        }
+
+        float low = polygon.vertexX[0] * normalX + polygon.vertexY[0] * normalY;
+        float high = low;
+        for (int v = 1; v < count; v++) {
+            const float projection = polygon.vertexX[v] * normalX + polygon.vertexY[v] * normalY;
+            low = std::min(low, projection);
+            high = std::max(high, projection);
+        }
+        polygon.axisX[polygon.axisCount] = normalX;
+        polygon.axisY[polygon.axisCount] = normalY;
+        polygon.axisMin[polygon.axisCount] = low;
+        polygon.axisMax[polygon.axisCount] = high;
+        polygon.axisCount++;
+    }
+    return polygon;
+}
+
+namespace {
+
+// True if some axis of `owner` separates it from `other`. The owner's interval comes from its
+// cache shifted by its offset along the axis; only the other polygon's vertices are projected.
+bool hasSeparatingAxis(const ConvexPolygon& owner, float ownerX, float ownerY,
+    const ConvexPolygon& other, float otherX, float otherY) {
+    const float relativeX = otherX - ownerX;
+    const float relativeY = otherY - ownerY;
+    for (int a = 0; a < owner.axisCount; a++) {
+        const float axisX = owner.axisX[a];
+        const float axisY = owner.axisY[a];
+        const float shift = relativeX * axisX + relativeY * axisY;
+
+        float low = other.vertexX[0] * axisX + other.vertexY[0] * axisY;
+        float high = low;
+        for (int v = 1; v < other.vertexCount; v++) {
+            const float projection = other.vertexX[v] * axisX + other.vertexY[v] * axisY;
+            low = std::min(low, projection);
+            high = std::max(high, projection);
+        }
+        if (high + shift < owner.axisMin[a] || low + shift > owner.axisMax[a]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+bool checkPolygonCollision(const ConvexPolygon& polygon1, float x1, float y1,
+    const ConvexPolygon& polygon2, float x2, float y2) {
+    return !hasSeparatingAxis(polygon1, x1, y1, polygon2, x2, y2)
+        && !hasSeparatingAxis(polygon2, x2, y2, polygon1, x1, y1);
+}
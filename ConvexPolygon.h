@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+const int maxPolygonVertices = 8;
+
+// Convex polygon for the exact narrowphase, in coordinates relative to its body's box min corner
+// (so the box is 0..width by 0..height). Built once per shape: the separating axes and the
+// polygon's own extent along each of them are cached, so a test only has to project the other
+// polygon's vertices and shift the cached interval by the body position.
+struct ConvexPolygon {
+    int vertexCount;
+    float vertexX[maxPolygonVertices];  // counter-clockwise
+    float vertexY[maxPolygonVertices];
+
+    int axisCount;  // edge normals with parallel duplicates removed
+    float axisX[maxPolygonVertices];
+    float axisY[maxPolygonVertices];
+    float axisMin[maxPolygonVertices];
+    float axisMax[maxPolygonVertices];
+
+    float width;
+    float height;
+    // Where the source mesh's origin sits relative to the box min corner, for drawing
+    float meshOffsetX;
+    float meshOffsetY;
+};
+
+// Builds a polygon from mesh vertices (`count` vertices of `stride` floats, x and y first).
+// The vertices must form a convex outline in either winding; `count` is at most maxPolygonVertices.
+ConvexPolygon makeConvexPolygon(const float* vertices, int count, int stride);
+
+// Separating-axis test for two polygons whose box min corners are at (x1, y1) and (x2, y2).
+// Touching counts as a collision, as in checkCollision. Meant to run after the AABB test passes.
+bool checkPolygonCollision(const ConvexPolygon& polygon1, float x1, float y1,
+    const ConvexPolygon& polygon2, float x2, float y2);
@@ -0,0 +1,389 @@
+#include "DynamicTree.h"
+
+#include <algorithm>
+
+namespace {
+
+// Smallest box containing both inputs
+inline Aabb combine(const Aabb& a, const Aabb& b) {
+    const float minX = std::min(a.x, b.x);
+    const float minY = std::min(a.y, b.y);
+    const float maxX = std::max(a.x + a.width, b.x + b.width);
+    const float maxY = std::max(a.y + a.height, b.y + b.height);
+    Aabb result = { minX, minY, maxX - minX, maxY - minY };
+    return result;
+}
+
+// Surface-area heuristic cost of a box; in 2D the perimeter plays the role of the area
+inline float perimeter(const Aabb& box) {
+    return 2.0f * (box.width + box.height);
+}
+
+inline bool contains(const Aabb& outer, const Aabb& inner) {
+    return outer.x <= inner.x && outer.y <= inner.y &&
+        inner.x + inner.width <= outer.x + outer.width &&
+        inner.y + inner.height <= outer.y + outer.height;
+}
+
+} // namespace
+
+DynamicAabbTree::DynamicAabbTree(float fatMargin)
+    : root(nullNode), freeList(nullNode), margin(fatMargin) {
+}
+
+int32_t DynamicAabbTree::allocateNode() {
+    int32_t node;
+    if (freeList != nullNode) {
+        node = freeList;
+        freeList = nodes[node].parent;
+    }
+    else {
+        node = static_cast<int32_t>(nodes.size());
+        nodes.push_back(Node());
+    }
+    Node& fresh = nodes[node];
+    fresh.parent = nullNode;
+    fresh.child1 = nullNode;
+    fresh.child2 = nullNode;
+    fresh.height = 0;
+    fresh.userData = 0;
+    return node;
+}
+
+void DynamicAabbTree::freeNode(int32_t node) {
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+    freeList = node;
+}
+
+int32_t DynamicAabbTree::insert(const Aabb& box, uint32_t userData) {
+    const int32_t proxy = allocateNode();
+    Aabb fat = { box.x - margin, box.y - margin, box.width + 2.0f * margin, box.height + 2.0f * margin };
+    nodes[proxy].box = fat;
+    nodes[proxy].userData = userData;
+    insertLeaf(proxy);
+    return proxy;
+}
+
+void DynamicAabbTree::remove(int32_t proxy) {
+    assert(nodes[proxy].isLeaf());
+    removeLeaf(proxy);
+    freeNode(proxy);
+}
+
+bool DynamicAabbTree::move(int32_t proxy, const Aabb& box) {
+    assert(nodes[proxy].isLeaf());
+    if (contains(nodes[proxy].box, box)) {
+        return false;
+    }
+    removeLeaf(proxy);
+    Aabb fat = { box.x - margin, box.y - margin, box.width + 2.0f * margin, box.height + 2.0f * margin };
+    nodes[proxy].box = fat;
+    insertLeaf(proxy);
+    return true;
+}
+
+void DynamicAabbTree::insertLeaf(int32_t leaf) {
+    if (root == nullNode) {
+        root = leaf;
+        nodes[root].parent = nullNode;
+        return;
+    }
+
+    // Branch and bound over the sibling candidates. Pairing the leaf with node S costs the
+    // perimeter of their union plus what S's ancestors grow by to take the leaf in ("inherited").
+    // No node under S can do better than the leaf's own perimeter plus S's inherited cost plus
+    // S's own growth, so a subtree whose bound doesn't beat the best cost so far is skipped.
+    // Candidates come off a heap cheapest bound first, which finds a good sibling early.
+    const auto costlierCandidate = [](const InsertCandidate& a, const InsertCandidate& b) {
+        return a.inheritedCost > b.inheritedCost;
+    };
+    const Aabb leafBox = nodes[leaf].box;
+    const float leafArea = perimeter(leafBox);
+    int32_t index = root;
+    float bestCost = perimeter(combine(nodes[root].box, leafBox));
+    insertCandidates.clear();
+    const InsertCandidate start = { root, 0.0f };
+    insertCandidates.push_back(start);
+    while (!insertCandidates.empty()) {
+        std::pop_heap(insertCandidates.begin(), insertCandidates.end(), costlierCandidate);
+        const InsertCandidate candidate = insertCandidates.back();
+        insertCandidates.pop_back();
+        if (leafArea + candidate.inheritedCost >= bestCost) {
+            // The heap is ordered by this bound, so nothing left can beat the best
+            break;
+        }
+
+        const Node& node = nodes[candidate.node];
+        const float combinedArea = perimeter(combine(node.box, leafBox));
+        const float cost = combinedArea + candidate.inheritedCost;
+        if (cost < bestCost) {
+            bestCost = cost;
+            index = candidate.node;
+        }
+        if (node.isLeaf()) {
+            continue;
+        }
+        const float childInherited = candidate.inheritedCost + combinedArea - perimeter(node.box);
+        if (leafArea + childInherited < bestCost) {
+            const InsertCandidate children[2] = { { node.child1, childInherited }, { node.child2, childInherited } };
+            for (int c = 0; c < 2; c++) {
+                insertCandidates.push_back(children[c]);
+                std::push_heap(insertCandidates.begin(), insertCandidates.end(), costlierCandidate);
+            }
+        }
+    }
+    const int32_t sibling = index;
+
+    // Splice a new parent in above the sibling
+    const int32_t oldParent = nodes[sibling].parent;
+    const int32_t newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].box = combine(leafBox, nodes[sibling].box);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent != nullNode) {
+        if (nodes[oldParent].child1 == sibling) {
+            nodes[oldParent].child1 = newParent;
+        }
+        else {
+            nodes[oldParent].child2 = newParent;
+        }
+    }
+    else {
+        root = newParent;
+    }
+
+    refitUpwards(nodes[leaf].parent);
+}
+
+void DynamicAabbTree::removeLeaf(int32_t leaf) {
+    if (leaf == root) {
+        root = nullNode;
+        return;
+    }
+
+    const int32_t parent = nodes[leaf].parent;
+    const int32_t grandParent = nodes[parent].parent;
+    const int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+    // The sibling takes the parent's place
+    if (grandParent != nullNode) {
+        if (nodes[grandParent].child1 == parent) {
+            nodes[grandParent].child1 = sibling;
+        }
+        else {
+            nodes[grandParent].child2 = sibling;
+        }
+        nodes[sibling].parent = grandParent;
+        freeNode(parent);
+        refitUpwards(grandParent);
+    }
+    else {
+        root = sibling;
+        nodes[sibling].parent = nullNode;
+        freeNode(parent);
+    }
+}
+
+void DynamicAabbTree::refitUpwards(int32_t node) {
+    int32_t index = node;
+    while (index != nullNode) {
+        index = balance(index);
+        Node& current = nodes[index];
+        const Node& child1 = nodes[current.child1];
+        const Node& child2 = nodes[current.child2];
+        current.height = 1 + std::max(child1.height, child2.height);
+        current.box = combine(child1.box, child2.box);
+        index = current.parent;
+    }
+}
+
+// Performs a left or right rotation if node A is imbalanced and returns the new subtree root.
+// When A's right child C is two levels taller than its left child B, C takes A's place,
+// A becomes C's left child and the shorter of C's children moves under A. The mirrored
+// case lifts B instead.
+int32_t DynamicAabbTree::balance(int32_t iA) {
+    Node& a = nodes[iA];
+    if (a.isLeaf() || a.height < 2) {
+        return iA;
+    }
+
+    const int32_t iB = a.child1;
+    const int32_t iC = a.child2;
+    Node& b = nodes[iB];
+    Node& c = nodes[iC];
+    const int32_t heightDifference = c.height - b.height;
+
+    if (heightDifference > 1) {
+        // Rotate C up
+        const int32_t iF = c.child1;
+        const int32_t iG = c.child2;
+        Node& f = nodes[iF];
+        Node& g = nodes[iG];
+
+        c.child1 = iA;
+        c.parent = a.parent;
+        a.parent = iC;
+        if (c.parent != nullNode) {
+            if (nodes[c.parent].child1 == iA) {
+                nodes[c.parent].child1 = iC;
+            }
+            else {
+                nodes[c.parent].child2 = iC;
+            }
+        }
+        else {
+            root = iC;
+        }
+
+        // Keep the taller grandchild under C, hand the shorter one to A
+        if (f.height > g.height) {
+            c.child2 = iF;
+            a.child2 = iG;
+            g.parent = iA;
+            a.box = combine(b.box, g.box);
+            c.box = combine(a.box, f.box);
+            a.height = 1 + std::max(b.height, g.height);
+            c.height = 1 + std::max(a.height, f.height);
+        }
+        else {
+            c.child2 = iG;
+            a.child2 = iF;
+            f.parent = iA;
+            a.box = combine(b.box, f.box);
+            c.box = combine(a.box, g.box);
+            a.height = 1 + std::max(b.height, f.height);
+            c.height = 1 + std::max(a.height, g.height);
+        }
+        return iC;
+    }
+
+    if (heightDifference < -1) {
+        // Rotate B up
+        const int32_t iD = b.child1;
+        const int32_t iE = b.child2;
+        Node& d = nodes[iD];
+        Node& e = nodes[iE];
+
+        b.child1 = iA;
+        b.parent = a.parent;
+        a.parent = iB;
+        if (b.parent != nullNode) {
+            if (nodes[b.parent].child1 == iA) {
+                nodes[b.parent].child1 = iB;
+            }
+            else {
+                nodes[b.parent].child2 = iB;
+            }
+        }
+        else {
+            root = iB;
+        }
+
+        if (d.height > e.height) {
+            b.child2 = iD;
+            a.child1 = iE;
+            e.parent = iA;
+            a.box = combine(c.box, e.box);
+            b.box = combine(a.box, d.box);
+            a.height = 1 + std::max(c.height, e.height);
+            b.height = 1 + std::max(a.height, d.height);
+        }
+        else {
+            b.child2 = iE;
+            a.child1 = iD;
+            d.parent = iA;
+            a.box = combine(c.box, d.box);
+            b.box = combine(a.box, e.box);
+            a.height = 1 + std::max(c.height, d.height);
+            b.height = 1 + std::max(a.height, e.height);
+        }
+        return iB;
+    }
+
+    return iA;
+}
+
+namespace {
+
+struct NodePair {
+    int32_t first;
+    int32_t second;
+};
+
+// Simultaneous descent of two subtrees. With `sameTree` set, (first, second) and (second, first)
+// are the same pair, so only one order is explored and a node is never paired with itself.
+template <typename Node>
+void descendPairs(const std::vector<Node>& nodesA, const std::vector<Node>& nodesB, NodePair start,
+    bool sameTree, std::vector<NodePair>& stack, std::vector<CollisionPair>& outPairs) {
+    stack.clear();
+    stack.push_back(start);
+    while (!stack.empty()) {
+        const NodePair top = stack.back();
+        stack.pop_back();
+        const Node& a = nodesA[top.first];
+        const Node& b = nodesB[top.second];
+
+        if (sameTree && top.first == top.second) {
+            // A subtree against itself: pairs inside each child, plus pairs across them
+            if (!a.isLeaf()) {
+                NodePair left = { a.child1, a.child1 };
+                NodePair right = { a.child2, a.child2 };
+                NodePair across = { a.child1, a.child2 };
+                stack.push_back(left);
+                stack.push_back(right);
+                stack.push_back(across);
+            }
+            continue;
+        }
+        if (!checkCollision(a.box, b.box)) {
+            continue;
+        }
+
+        if (a.isLeaf() && b.isLeaf()) {
+            CollisionPair pair = { a.userData, b.userData };
+            if (sameTree && pair.a > pair.b) {
+                std::swap(pair.a, pair.b);
+            }
+            outPairs.push_back(pair);
+        }
+        else if (b.isLeaf() || (!a.isLeaf() && a.height >= b.height)) {
+            // Split the taller side
+            NodePair first = { a.child1, top.second };
+            NodePair second = { a.child2, top.second };
+            stack.push_back(first);
+            stack.push_back(second);
+        }
+        else {
+            NodePair first = { top.first, b.child1 };
+            NodePair second = { top.first, b.child2 };
+            stack.push_back(first);
+            stack.push_back(second);
+        }
+    }
+}
+
+} // namespace
+
+void DynamicAabbTree::findSelfPairs(std::vector<CollisionPair>& outPairs) const {
+    if (root == nullNode) {
+        return;
+    }
+    std::vector<NodePair> stack;
+    NodePair start = { root, root };
+    descendPairs(nodes, nodes, start, true, stack, outPairs);
+}
+
+void findTreePairs(const DynamicAabbTree& a, const DynamicAabbTree& b, std::vector<CollisionPair>& outPairs) {
+    if (a.root == DynamicAabbTree::nullNode || b.root == DynamicAabbTree::nullNode) {
+        return;
+    }
+    std::vector<NodePair> stack;
+    NodePair start = { a.root, b.root };
+    descendPairs(a.nodes, b.nodes, start, false, stack, outPairs);
+}
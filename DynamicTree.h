@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Collision.h"
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// Dynamic bounding volume hierarchy over fattened AABBs. Nodes live in one contiguous pool and
+// link to each other by index, so the tree can grow without invalidating anything callers hold.
+// Leaves store a box enlarged by `margin`; moves that stay inside it don't touch the tree.
+// Inserts place a leaf next to the node that grows the tree's total perimeter the least, found
+// by branch and bound.
+// Rotations after every insert/remove keep sibling heights within one of each other, so
+// queries walk O(log n) nodes. Static level geometry and moving actors can share one tree,
+// or live in two trees paired up with findTreePairs.
+class DynamicAabbTree {
+public:
+    static const int32_t nullNode = -1;
+
+    explicit DynamicAabbTree(float fatMargin = 0.1f);
+
+    // Inserts a leaf for `box` and returns its proxy id. `userData` is handed back by queries
+    // and pair searches, usually the body index in the caller's AabbSoA.
+    int32_t insert(const Aabb& box, uint32_t userData);
+    void remove(int32_t proxy);
+
+    // Updates a leaf's tight box. Returns true when the box left the fattened bounds and the
+    // leaf had to be reinserted, false when the move was absorbed by the margin.
+    bool move(int32_t proxy, const Aabb& box);
+
+    const Aabb& getFatAabb(int32_t proxy) const { return nodes[proxy].box; }
+    uint32_t getUserData(int32_t proxy) const { return nodes[proxy].userData; }
+    int32_t getHeight() const { return root == nullNode ? 0 : nodes[root].height; }
+    float getMargin() const { return margin; }
+
+    // Calls callback(proxy) for every leaf whose fat box overlaps `box`. Return false from the
+    // callback to stop early.
+    template <typename Callback>
+    void query(const Aabb& box, Callback callback) const;
+
+    // Appends the user data of every pair of leaves in this tree whose fat boxes overlap (a < b)
+    void findSelfPairs(std::vector<CollisionPair>& outPairs) const;
+
+private:
+    struct Node {
+        Aabb box;
+        int32_t parent;  // next free node while on the free list
+        int32_t child1;
+        int32_t child2;
+        int32_t height;  // 0 for leaves, -1 for free nodes
+        uint32_t userData;
+
+        bool isLeaf() const { return child1 == nullNode; }
+    };
+
+    // Sibling candidate in insertLeaf's branch-and-bound search, with the perimeter growth its
+    // ancestors take on if the new leaf goes next to it
+    struct InsertCandidate {
+        int32_t node;
+        float inheritedCost;
+    };
+
+    friend void findTreePairs(const DynamicAabbTree& a, const DynamicAabbTree& b, std::vector<CollisionPair>& outPairs);
+
+    int32_t allocateNode();
+    void freeNode(int32_t node);
+    void insertLeaf(int32_t leaf);
+    void removeLeaf(int32_t leaf);
+    void refitUpwards(int32_t node);
+    int32_t balance(int32_t node);
+
+    std::vector<Node> nodes;
+    std::vector<InsertCandidate> insertCandidates;  // insertLeaf's heap, kept to avoid reallocating
+    int32_t root;
+    int32_t freeList;
+    float margin;
+};
+
+// Appends (a, b) user data for every leaf of `a` whose fat box overlaps a leaf of `b`,
+// e.g. moving actors against a separate tree of static level geometry
+void findTreePairs(const DynamicAabbTree& a, const DynamicAabbTree& b, std::vector<CollisionPair>& outPairs);
+
+template <typename Callback>
+void DynamicAabbTree::query(const Aabb& box, Callback callback) const {
+    // Depth-first walk; a balanced tree never needs more than height + 1 stack slots
+    int32_t stack[256];
+    int32_t count = 0;
+    if (root != nullNode) {
+        stack[count++] = root;
+    }
+    while (count > 0) {
+        const Node& node = nodes[stack[--count]];
+        if (!checkCollision(node.box, box)) {
+            continue;
+        }
+        if (node.isLeaf()) {
+            if (!callback(static_cast<int32_t>(&node - nodes.data()))) {
+                return;
+            }
+        }
+        else {
+            assert(count + 2 <= 256);
+            stack[count++] = node.child1;
+            stack[count++] = node.child2;
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cassert>
+
+FrameArena::FrameArena(size_t initialCapacity)
+    : rawBlock(nullptr), block(nullptr), capacity(0), used(0), overflowBytes(0), overflowCount(0), highWaterMark(0) {
+    allocateBlock(initialCapacity);
+}
+
+FrameArena::~FrameArena() {
+    reset();
+    ::operator delete(rawBlock);
+}
+
+void FrameArena::allocateBlock(size_t bytes) {
+    ::operator delete(rawBlock);
+    rawBlock = ::operator new(bytes + maxAlignment);
+    const uintptr_t address = reinterpret_cast<uintptr_t>(rawBlock);
+    block = static_cast<char*>(rawBlock) + ((maxAlignment - address % maxAlignment) % maxAlignment);
+    capacity = bytes;
+}
+
+void* FrameArena::allocate(size_t bytes, size_t alignment) {
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0 && alignment <= maxAlignment);
+    size_t offset = used.load(std::memory_order_relaxed);
+    for (;;) {
+        const size_t start = (offset + alignment - 1) & ~(alignment - 1);
+        const size_t end = start + bytes;
+        if (end > capacity) {
+            return allocateOverflow(bytes, alignment);
+        }
+        if (used.compare_exchange_weak(offset, end, std::memory_order_relaxed)) {
+            return block + start;
+        }
+    }
+}
+
+void* FrameArena::allocateOverflow(size_t bytes, size_t alignment) {
+    std::lock_guard<std::mutex> lock(overflowMutex);
+    void* raw = ::operator new(bytes + alignment);
+    overflowBlocks.push_back(raw);
+    overflowBytes += bytes + alignment;
+    overflowCount++;
+    const uintptr_t address = reinterpret_cast<uintptr_t>(raw);
+    return static_cast<char*>(raw) + ((alignment - address % alignment) % alignment);
+}
+
+void FrameArena::reset() {
+    const size_t stepBytes = std::min(used.load(std::memory_order_relaxed), capacity) + overflowBytes;
+    highWaterMark = std::max(highWaterMark, stepBytes);
+
+    for (size_t i = 0; i < overflowBlocks.size(); i++) {
+        ::operator delete(overflowBlocks[i]);
+    }
+    overflowBlocks.clear();
+
+    // Leave headroom past the high-water mark so a slightly busier step still fits
+    if (overflowBytes > 0) {
+        allocateBlock(highWaterMark + highWaterMark / 2);
+    }
+    overflowBytes = 0;
+    used.store(0, std::memory_order_relaxed);
+}
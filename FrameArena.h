@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Linear allocator for data that only lives for one simulation step. Allocation bumps an offset
+// (atomically, so job system workers can allocate too) and nothing is freed individually; reset()
+// hands the whole block back at the start of the next step. When a step needs more than the block
+// holds, the excess comes from the heap and the next reset grows the block past the high-water
+// mark, so after a few steps at a given scene size the arena stops touching the heap.
+class FrameArena {
+public:
+    explicit FrameArena(size_t capacity = 1u << 20);
+    ~FrameArena();
+
+    // Thread safe. `alignment` must be a power of two no larger than maxAlignment.
+    void* allocate(size_t bytes, size_t alignment);
+
+    // Releases everything allocated since the last reset; only call while nobody is allocating
+    void reset();
+
+    size_t getCapacity() const { return capacity; }
+    // Most bytes any single step has used, overflow included
+    size_t getHighWaterMark() const { return highWaterMark; }
+    // Allocations that didn't fit in the block and went to the heap, over the arena's lifetime
+    uint64_t getOverflowCount() const { return overflowCount; }
+
+    static const size_t maxAlignment = 64;
+
+private:
+    FrameArena(const FrameArena&);
+    FrameArena& operator=(const FrameArena&);
+
+    void* allocateOverflow(size_t bytes, size_t alignment);
+    void allocateBlock(size_t bytes);
+
+    void* rawBlock;
+    char* block;  // rawBlock rounded up to maxAlignment
+    size_t capacity;
+    std::atomic<size_t> used;
+
+    std::mutex overflowMutex;
+    std::vector<void*> overflowBlocks;
+    size_t overflowBytes;  // this step
+    uint64_t overflowCount;
+    size_t highWaterMark;
+};
+
+// Standard allocator over a FrameArena, for containers that are rebuilt every step. Freeing is a
+// no-op; the memory comes back with the arena's reset. Without an arena it falls back to the heap.
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+    // Move and swap carry the arena along, so a container can be re-pointed at a freshly reset arena
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    ArenaAllocator() : arena(nullptr) {}
+    explicit ArenaAllocator(FrameArena* frameArena) : arena(frameArena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.getArena()) {}
+
+    T* allocate(size_t count) {
+        if (arena) {
+            return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+        }
+        return static_cast<T*>(::operator new(count * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, size_t) {
+        if (!arena) {
+            ::operator delete(pointer);
+        }
+    }
+
+    FrameArena* getArena() const { return arena; }
+
+private:
+    FrameArena* arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.getArena() == b.getArena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.getArena() != b.getArena();
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+
+// Empties `vector` and points it at `arena` without freeing anything. Call it before the arena is
+// reset: destroying the elements may still read memory the reset hands back.
+template <typename T>
+void resetArenaVector(ArenaVector<T>& vector, FrameArena& arena) {
+    ArenaVector<T> fresh{ ArenaAllocator<T>(&arena) };
+    vector.swap(fresh);
+}
@@ -0,0 +1,496 @@
+#include "Gjk.h"
+
+#include <cmath>
+#include <limits>
+
+ConvexShape makeCircleShape(float centerX, float centerY, float radius) {
+    ConvexShape shape = {};
+    shape.vertexCount = 1;
+    shape.vertexX[0] = centerX;
+    shape.vertexY[0] = centerY;
+    shape.radius = radius;
+    return shape;
+}
+
+ConvexShape makeCapsuleShape(float x1, float y1, float x2, float y2, float radius) {
+    ConvexShape shape = {};
+    shape.vertexCount = 2;
+    shape.vertexX[0] = x1;
+    shape.vertexY[0] = y1;
+    shape.vertexX[1] = x2;
+    shape.vertexY[1] = y2;
+    shape.radius = radius;
+    return shape;
+}
+
+ConvexShape makeHullShape(const ConvexPolygon& polygon) {
+    ConvexShape shape = {};
+    shape.vertexCount = polygon.vertexCount;
+    for (int i = 0; i < polygon.vertexCount; i++) {
+        shape.vertexX[i] = polygon.vertexX[i];
+        shape.vertexY[i] = polygon.vertexY[i];
+    }
+    shape.radius = 0.0f;
+    return shape;
+}
+
+int support(const ConvexShape& shape, float dirX, float dirY) {
+    int best = 0;
+    float bestValue = shape.vertexX[0] * dirX + shape.vertexY[0] * dirY;
+    for (int i = 1; i < shape.vertexCount; i++) {
+        const float value = shape.vertexX[i] * dirX + shape.vertexY[i] * dirY;
+        if (value > bestValue) {
+            best = i;
+            bestValue = value;
+        }
+    }
+    return best;
+}
+
+namespace {
+
+const int maxGjkIterations = 20;
+const int maxEpaIterations = 32;
+const int maxEpaVertices = maxEpaIterations + 3;
+const float gjkEpsilon = 1e-6f;
+const float epaTolerance = 1e-4f;
+
+inline float cross(float ax, float ay, float bx, float by) {
+    return ax * by - ay * bx;
+}
+
+// Point of the Minkowski difference B - A, remembering which support vertices produced it
+struct SimplexVertex {
+    float wAX, wAY;  // on A
+    float wBX, wBY;  // on B
+    float wX, wY;    // wB - wA
+    float a;         // barycentric weight of the closest point
+    int indexA;
+    int indexB;
+};
+
+struct Simplex {
+    SimplexVertex v[3];
+    int count;
+};
+
+// Shapes with their world offsets, so support points come back in world space
+struct ShapePair {
+    const ConvexShape* shapeA;
+    float xA, yA;
+    const ConvexShape* shapeB;
+    float xB, yB;
+
+    void setVertex(SimplexVertex& vertex, int indexA, int indexB) const {
+        vertex.indexA = indexA;
+        vertex.indexB = indexB;
+        vertex.wAX = shapeA->vertexX[indexA] + xA;
+        vertex.wAY = shapeA->vertexY[indexA] + yA;
+        vertex.wBX = shapeB->vertexX[indexB] + xB;
+        vertex.wBY = shapeB->vertexY[indexB] + yB;
+        vertex.wX = vertex.wBX - vertex.wAX;
+        vertex.wY = vertex.wBY - vertex.wAY;
+        vertex.a = 1.0f;
+    }
+
+    // Support point of B - A along (dirX, dirY)
+    void supportVertex(SimplexVertex& vertex, float dirX, float dirY) const {
+        setVertex(vertex, support(*shapeA, -dirX, -dirY), support(*shapeB, dirX, dirY));
+    }
+};
+
+// Closest point to the origin on segment w1-w2, as barycentric weights; may drop to one vertex
+void solve2(Simplex& simplex) {
+    SimplexVertex& v1 = simplex.v[0];
+    SimplexVertex& v2 = simplex.v[1];
+    const float e12X = v2.wX - v1.wX;
+    const float e12Y = v2.wY - v1.wY;
+
+    // Origin beyond w1
+    const float d12_2 = -(v1.wX * e12X + v1.wY * e12Y);
+    if (d12_2 <= 0.0f) {
+        v1.a = 1.0f;
+        simplex.count = 1;
+        return;
+    }
+    // Origin beyond w2
+    const float d12_1 = v2.wX * e12X + v2.wY * e12Y;
+    if (d12_1 <= 0.0f) {
+        v2.a = 1.0f;
+        simplex.count = 1;
+        v1 = v2;
+        return;
+    }
+    const float inverse = 1.0f / (d12_1 + d12_2);
+    v1.a = d12_1 * inverse;
+    v2.a = d12_2 * inverse;
+    simplex.count = 2;
+}
+
+// Closest feature of triangle w1-w2-w3 to the origin, by its Voronoi regions
+void solve3(Simplex& simplex) {
+    SimplexVertex& v1 = simplex.v[0];
+    SimplexVertex& v2 = simplex.v[1];
+    SimplexVertex& v3 = simplex.v[2];
+
+    const float e12X = v2.wX - v1.wX, e12Y = v2.wY - v1.wY;
+    const float d12_1 = v2.wX * e12X + v2.wY * e12Y;
+    const float d12_2 = -(v1.wX * e12X + v1.wY * e12Y);
+
+    const float e13X = v3.wX - v1.wX, e13Y = v3.wY - v1.wY;
+    const float d13_1 = v3.wX * e13X + v3.wY * e13Y;
+    const float d13_2 = -(v1.wX * e13X + v1.wY * e13Y);
+
+    const float e23X = v3.wX - v2.wX, e23Y = v3.wY - v2.wY;
+    const float d23_1 = v3.wX * e23X + v3.wY * e23Y;
+    const float d23_2 = -(v2.wX * e23X + v2.wY * e23Y);
+
+    const float n123 = cross(e12X, e12Y, e13X, e13Y);
+    const float d123_1 = n123 * cross(v2.wX, v2.wY, v3.wX, v3.wY);
+    const float d123_2 = n123 * cross(v3.wX, v3.wY, v1.wX, v1.wY);
+    const float d123_3 = n123 * cross(v1.wX, v1.wY, v2.wX, v2.wY);
+
+    // Vertex w1
+    if (d12_2 <= 0.0f && d13_2 <= 0.0f) {
+        v1.a = 1.0f;
+        simplex.count = 1;
+        return;
+    }
+    // Edge w1-w2
+    if (d12_1 > 0.0f && d12_2 > 0.0f && d123_3 <= 0.0f) {
+        const float inverse = 1.0f / (d12_1 + d12_2);
+        v1.a = d12_1 * inverse;
+        v2.a = d12_2 * inverse;
+        simplex.count = 2;
+        return;
+    }
+    // Edge w1-w3
+    if (d13_1 > 0.0f && d13_2 > 0.0f && d123_2 <= 0.0f) {
+        const float inverse = 1.0f / (d13_1 + d13_2);
+        v1.a = d13_1 * inverse;
+        v3.a = d13_2 * inverse;
+        simplex.count = 2;
+        v2 = v3;
+        return;
+    }
+    // Vertex w2
+    if (d12_1 <= 0.0f && d23_2 <= 0.0f) {
+        v2.a = 1.0f;
+        simplex.count = 1;
+        v1 = v2;
+        return;
+    }
+    // Vertex w3
+    if (d13_1 <= 0.0f && d23_1 <= 0.0f) {
+        v3.a = 1.0f;
+        simplex.count = 1;
+        v1 = v3;
+        return;
+    }
+    // Edge w2-w3
+    if (d23_1 > 0.0f && d23_2 > 0.0f && d123_1 <= 0.0f) {
+        const float inverse = 1.0f / (d23_1 + d23_2);
+        v2.a = d23_1 * inverse;
+        v3.a = d23_2 * inverse;
+        simplex.count = 2;
+        v1 = v3;
+        return;
+    }
+    // Origin inside the triangle
+    const float inverse = 1.0f / (d123_1 + d123_2 + d123_3);
+    v1.a = d123_1 * inverse;
+    v2.a = d123_2 * inverse;
+    v3.a = d123_3 * inverse;
+    simplex.count = 3;
+}
+
+// Direction from the simplex towards the origin
+void searchDirection(const Simplex& simplex, float& dirX, float& dirY) {
+    if (simplex.count == 1) {
+        dirX = -simplex.v[0].wX;
+        dirY = -simplex.v[0].wY;
+        return;
+    }
+    const float e12X = simplex.v[1].wX - simplex.v[0].wX;
+    const float e12Y = simplex.v[1].wY - simplex.v[0].wY;
+    if (cross(e12X, e12Y, -simplex.v[0].wX, -simplex.v[0].wY) > 0.0f) {
+        dirX = -e12Y;  // Origin left of the edge
+        dirY = e12X;
+    }
+    else {
+        dirX = e12Y;
+        dirY = -e12X;
+    }
+}
+
+void witnessPoints(const Simplex& simplex, GjkOutput& output) {
+    output.pointAX = output.pointAY = output.pointBX = output.pointBY = 0.0f;
+    for (int i = 0; i < simplex.count; i++) {
+        output.pointAX += simplex.v[i].a * simplex.v[i].wAX;
+        output.pointAY += simplex.v[i].a * simplex.v[i].wAY;
+        output.pointBX += simplex.v[i].a * simplex.v[i].wBX;
+        output.pointBY += simplex.v[i].a * simplex.v[i].wBY;
+    }
+    if (simplex.count == 3) {
+        output.pointBX = output.pointAX;
+        output.pointBY = output.pointAY;
+    }
+}
+
+// Core of gjkDistance; also hands back the final simplex so EPA can grow it
+void runGjk(const ShapePair& pair, SimplexCache& cache, Simplex& simplex, GjkOutput& output) {
+    // Warm start from the cached simplex, dropping indices that no longer fit the shapes
+    simplex.count = 0;
+    for (int i = 0; i < cache.count && i < 3; i++) {
+        if (cache.indexA[i] < pair.shapeA->vertexCount && cache.indexB[i] < pair.shapeB->vertexCount) {
+            pair.setVertex(simplex.v[simplex.count++], cache.indexA[i], cache.indexB[i]);
+        }
+    }
+    if (simplex.count == 3 && std::fabs(cross(simplex.v[1].wX - simplex.v[0].wX, simplex.v[1].wY - simplex.v[0].wY,
+        simplex.v[2].wX - simplex.v[0].wX, simplex.v[2].wY - simplex.v[0].wY)) < gjkEpsilon) {
+        simplex.count = 1;  // The shapes moved enough to flatten the cached triangle
+    }
+    if (simplex.count == 2 && simplex.v[0].indexA == simplex.v[1].indexA && simplex.v[0].indexB == simplex.v[1].indexB) {
+        simplex.count = 1;
+    }
+    if (simplex.count == 0) {
+        pair.setVertex(simplex.v[0], 0, 0);
+        simplex.count = 1;
+    }
+
+    int iteration = 0;
+    while (iteration < maxGjkIterations) {
+        int savedA[3];
+        int savedB[3];
+        const int savedCount = simplex.count;
+        for (int i = 0; i < savedCount; i++) {
+            savedA[i] = simplex.v[i].indexA;
+            savedB[i] = simplex.v[i].indexB;
+        }
+
+        if (simplex.count == 2) {
+            solve2(simplex);
+        }
+        else if (simplex.count == 3) {
+            solve3(simplex);
+        }
+        if (simplex.count == 3) {
+            break;  // The origin is inside: the cores overlap
+        }
+
+        float dirX, dirY;
+        searchDirection(simplex, dirX, dirY);
+        if (dirX * dirX + dirY * dirY < gjkEpsilon * gjkEpsilon) {
+            break;  // The origin lies on the simplex: touching or overlapping
+        }
+
+        SimplexVertex& vertex = simplex.v[simplex.count];
+        pair.supportVertex(vertex, dirX, dirY);
+        iteration++;
+
+        // A support point we already had means no further progress is possible
+        bool duplicate = false;
+        for (int i = 0; i < savedCount; i++) {
+            if (vertex.indexA == savedA[i] && vertex.indexB == savedB[i]) {
+                duplicate = true;
+                break;
+            }
+        }
+        if (duplicate) {
+            break;
+        }
+        simplex.count++;
+    }
+
+    witnessPoints(simplex, output);
+    const float dx = output.pointBX - output.pointAX;
+    const float dy = output.pointBY - output.pointAY;
+    output.distance = std::sqrt(dx * dx + dy * dy);
+    output.iterations = iteration;
+
+    cache.count = static_cast<uint8_t>(simplex.count);
+    for (int i = 0; i < simplex.count; i++) {
+        cache.indexA[i] = static_cast<uint8_t>(simplex.v[i].indexA);
+        cache.indexB[i] = static_cast<uint8_t>(simplex.v[i].indexB);
+    }
+}
+
+// Expanding polytope algorithm on the cores. Starts from the GJK simplex (grown to a triangle if
+// GJK stopped early) and pushes out the polytope edge nearest the origin until it reaches the
+// boundary of B - A. Returns false if the polytope is degenerate (the cores only touch).
+bool runEpa(const ShapePair& pair, const Simplex& simplex, float& normalX, float& normalY, float& depth,
+    float& pointAX, float& pointAY) {
+    SimplexVertex polytope[maxEpaVertices] = {};
+    int count = simplex.count;
+    for (int i = 0; i < count; i++) {
+        polytope[i] = simplex.v[i];
+    }
+
+    // Grow a point or a segment into a triangle
+    if (count == 1) {
+        pair.supportVertex(polytope[1], 1.0f, 0.0f);
+        if (polytope[1].indexA == polytope[0].indexA && polytope[1].indexB == polytope[0].indexB) {
+            pair.supportVertex(polytope[1], -1.0f, 0.0f);
+        }
+        count = 2;
+    }
+    if (count == 2) {
+        const float eX = polytope[1].wX - polytope[0].wX;
+        const float eY = polytope[1].wY - polytope[0].wY;
+        pair.supportVertex(polytope[2], -eY, eX);
+        if (std::fabs(cross(eX, eY, polytope[2].wX - polytope[0].wX, polytope[2].wY - polytope[0].wY)) < gjkEpsilon) {
+            pair.supportVertex(polytope[2], eY, -eX);
+        }
+        count = 3;
+    }
+    const float area = cross(polytope[1].wX - polytope[0].wX, polytope[1].wY - polytope[0].wY,
+        polytope[2].wX - polytope[0].wX, polytope[2].wY - polytope[0].wY);
+    if (std::fabs(area) < gjkEpsilon) {
+        return false;
+    }
+    if (area < 0.0f) {
+        const SimplexVertex swap = polytope[1];
+        polytope[1] = polytope[2];
+        polytope[2] = swap;
+    }
+
+    for (int iteration = 0; ; iteration++) {
+        // Edge closest to the origin; counter-clockwise winding puts outward normals on the right
+        int closest = 0;
+        float closestDistance = std::numeric_limits<float>::infinity();
+        float edgeNormalX = 0.0f;
+        float edgeNormalY = 0.0f;
+        for (int i = 0; i < count; i++) {
+            const SimplexVertex& p = polytope[i];
+            const SimplexVertex& q = polytope[(i + 1) % count];
+            const float eX = q.wX - p.wX;
+            const float eY = q.wY - p.wY;
+            const float length = std::sqrt(eX * eX + eY * eY);
+            if (length < gjkEpsilon) {
+                continue;
+            }
+            const float nX = eY / length;
+            const float nY = -eX / length;
+            const float distance = nX * p.wX + nY * p.wY;
+            if (distance < closestDistance) {
+                closest = i;
+                closestDistance = distance;
+                edgeNormalX = nX;
+                edgeNormalY = nY;
+            }
+        }
+
+        SimplexVertex candidate;
+        pair.supportVertex(candidate, edgeNormalX, edgeNormalY);
+        const float reach = candidate.wX * edgeNormalX + candidate.wY * edgeNormalY;
+        if (reach - closestDistance < epaTolerance || iteration >= maxEpaIterations || count >= maxEpaVertices) {
+            normalX = edgeNormalX;
+            normalY = edgeNormalY;
+            depth = closestDistance;
+
+            // Witness on A: where the origin's projection falls along the closest edge
+            const SimplexVertex& p = polytope[closest];
+            const SimplexVertex& q = polytope[(closest + 1) % count];
+            const float eX = q.wX - p.wX;
+            const float eY = q.wY - p.wY;
+            const float lengthSquared = eX * eX + eY * eY;
+            float t = lengthSquared > 0.0f ? -(p.wX * eX + p.wY * eY) / lengthSquared : 0.0f;
+            t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+            pointAX = p.wAX + (q.wAX - p.wAX) * t;
+            pointAY = p.wAY + (q.wAY - p.wAY) * t;
+            return true;
+        }
+
+        // Insert the new support point after the closest edge's start
+        int inserted = closest + 1;
+        for (int i = count; i > inserted; i--) {
+            polytope[i] = polytope[i - 1];
+        }
+        polytope[inserted] = candidate;
+        count++;
+
+        // The new point can hide neighbours that were on the old outline; drop any vertex that no
+        // longer turns left so the polytope stays convex
+        for (int i = 0; i < count && count > 3; ) {
+            const SimplexVertex& previous = polytope[(i + count - 1) % count];
+            const SimplexVertex& next = polytope[(i + 1) % count];
+            const bool reflex = cross(polytope[i].wX - previous.wX, polytope[i].wY - previous.wY,
+                next.wX - polytope[i].wX, next.wY - polytope[i].wY) <= 0.0f;
+            if (!reflex || i == inserted) {
+                i++;
+                continue;
+            }
+            for (int j = i; j + 1 < count; j++) {
+                polytope[j] = polytope[j + 1];
+            }
+            count--;
+            if (i < inserted) {
+                inserted--;
+            }
+            i = i > 0 ? i - 1 : 0;
+        }
+    }
+}
+
+} // namespace
+
+void gjkDistance(const ConvexShape& shapeA, float xA, float yA, const ConvexShape& shapeB, float xB, float yB,
+    SimplexCache& cache, GjkOutput& output) {
+    const ShapePair pair = { &shapeA, xA, yA, &shapeB, xB, yB };
+    Simplex simplex;
+    runGjk(pair, cache, simplex, output);
+}
+
+bool collideConvex(const ConvexShape& shapeA, float xA, float yA, const ConvexShape& shapeB, float xB, float yB,
+    SimplexCache& cache, Contact& contact, int* iterations) {
+    const ShapePair pair = { &shapeA, xA, yA, &shapeB, xB, yB };
+    Simplex simplex;
+    GjkOutput output;
+    runGjk(pair, cache, simplex, output);
+    if (iterations) {
+        *iterations = output.iterations;
+    }
+
+    const float radii = shapeA.radius + shapeB.radius;
+    if (output.distance > radii) {
+        return false;
+    }
+
+    if (output.distance > gjkEpsilon) {
+        // Cores apart but within the radii: the normal runs between the closest core points
+        const float normalX = (output.pointAX - output.pointBX) / output.distance;
+        const float normalY = (output.pointAY - output.pointBY) / output.distance;
+        contact.depth = radii - output.distance;
+        contact.normalX = normalX;
+        contact.normalY = normalY;
+        const float surfaceAX = output.pointAX - normalX * shapeA.radius;
+        const float surfaceAY = output.pointAY - normalY * shapeA.radius;
+        const float surfaceBX = output.pointBX + normalX * shapeB.radius;
+        const float surfaceBY = output.pointBY + normalY * shapeB.radius;
+        contact.pointX = 0.5f * (surfaceAX + surfaceBX);
+        contact.pointY = 0.5f * (surfaceAY + surfaceBY);
+    }
+    else {
+        // Cores overlap: EPA gives the core penetration, and the radii add to it
+        float normalX, normalY, depth, pointAX, pointAY;
+        if (!runEpa(pair, simplex, normalX, normalY, depth, pointAX, pointAY)) {
+            // Cores touch along a line: nothing to push apart beyond the radii
+            float dirX = xA - xB;
+            float dirY = yA - yB;
+            const float length = std::sqrt(dirX * dirX + dirY * dirY);
+            normalX = length > gjkEpsilon ? dirX / length : 0.0f;
+            normalY = length > gjkEpsilon ? dirY / length : 1.0f;
+            depth = 0.0f;
+            pointAX = output.pointAX;
+            pointAY = output.pointAY;
+        }
+        contact.depth = depth + radii;
+        contact.normalX = normalX;
+        contact.normalY = normalY;
+        contact.pointX = pointAX + normalX * 0.5f * depth;
+        contact.pointY = pointAY + normalY * 0.5f * depth;
+    }
+    contact.mtvX = contact.normalX * contact.depth;
+    contact.mtvY = contact.normalY * contact.depth;
+    return true;
+}
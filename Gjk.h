@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Collision.h"
+#include "ConvexPolygon.h"
+
+#include <cstdint>
+
+// Any convex shape as a point set plus a rounding radius: one point is a circle, two a capsule,
+// three or more a (rounded) hull. GJK and EPA only ever call its support function, so every
+// shape goes through the same code. Points are relative to the body's box min corner.
+struct ConvexShape {
+    int vertexCount;
+    float vertexX[maxPolygonVertices];
+    float vertexY[maxPolygonVertices];
+    float radius;
+};
+
+ConvexShape makeCircleShape(float centerX, float centerY, float radius);
+ConvexShape makeCapsuleShape(float x1, float y1, float x2, float y2, float radius);
+ConvexShape makeHullShape(const ConvexPolygon& polygon);
+
+// Index of the shape's core vertex furthest along (dirX, dirY)
+int support(const ConvexShape& shape, float dirX, float dirY);
+
+// GJK simplex from the last query of a pair, as support vertex indices into both shapes.
+// Feeding it back into the next query of the same pair starts GJK next to the answer, so
+// persistent pairs usually finish in one or two iterations.
+struct SimplexCache {
+    uint8_t count;  // 0 = cold start
+    uint8_t indexA[3];
+    uint8_t indexB[3];
+};
+
+struct GjkOutput {
+    float distance;  // between the shape cores; 0 when they overlap
+    float pointAX;   // closest core points
+    float pointAY;
+    float pointBX;
+    float pointBY;
+    int iterations;
+};
+
+// GJK distance between the cores (radius ignored) of shape A at (xA, yA) and shape B at (xB, yB).
+// Reads and updates `cache`.
+void gjkDistance(const ConvexShape& shapeA, float xA, float yA, const ConvexShape& shapeB, float xB, float yB,
+    SimplexCache& cache, GjkOutput& output);
+
+// Full narrowphase for two convex shapes: GJK on the cores, the radii on top of the distance, and
+// EPA for the penetration depth when the cores themselves overlap. Fills `contact` using the
+// computeContact convention (normal from B towards A) and returns true if the shapes touch.
+bool collideConvex(const ConvexShape& shapeA, float xA, float yA, const ConvexShape& shapeB, float xB, float yB,
+    SimplexCache& cache, Contact& contact, int* iterations = nullptr);
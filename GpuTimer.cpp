@@ -0,0 +1,82 @@
+#include "GpuTimer.h"
+
+#include "Profiler.h"
+
+GpuTimer::GpuTimer()
+    : current(0), passOpen(false), initialized(false), droppedFrames(0) {
+    for (int f = 0; f < frameLatency; f++) {
+        frames[f].passCount = 0;
+        frames[f].pending = false;
+        for (int p = 0; p < maxPasses; p++) {
+            frames[f].queries[p] = 0;
+        }
+    }
+}
+
+void GpuTimer::init() {
+    for (int f = 0; f < frameLatency; f++) {
+        glGenQueries(maxPasses, frames[f].queries);
+    }
+    initialized = true;
+}
+
+void GpuTimer::beginPass(const char* name) {
+    Frame& frame = frames[current];
+    if (!initialized || passOpen || frame.passCount == maxPasses || !isProfilerEnabled()) {
+        return;
+    }
+    frame.passes[frame.passCount].name = name;
+    frame.passes[frame.passCount].cpuStart = profileTimestamp();
+    glBeginQuery(GL_TIME_ELAPSED, frame.queries[frame.passCount]);
+    passOpen = true;
+}
+
+void GpuTimer::endPass() {
+    if (!passOpen) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    frames[current].passCount++;
+    passOpen = false;
+}
+
+bool GpuTimer::collect(Frame& frame) {
+    // Queries finish in order, so once the last one is available the whole frame is
+    GLint available = 0;
+    glGetQueryObjectiv(frame.queries[frame.passCount - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        return false;
+    }
+    for (int p = 0; p < frame.passCount; p++) {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(frame.queries[p], GL_QUERY_RESULT, &elapsed);
+        recordGpuZone(frame.passes[p].name, frame.passes[p].cpuStart, static_cast<uint64_t>(elapsed));
+    }
+    return true;
+}
+
+void GpuTimer::endFrame() {
+    if (!initialized) {
+        return;
+    }
+    endPass();
+    frames[current].pending = frames[current].passCount > 0;
+    current = (current + 1) % frameLatency;
+
+    // Read back whatever has finished, oldest first; the slot about to be reused is the oldest
+    for (int age = 0; age < frameLatency; age++) {
+        Frame& frame = frames[(current + age) % frameLatency];
+        if (frame.pending && collect(frame)) {
+            frame.pending = false;
+        }
+    }
+
+    // The GPU is still three frames behind; give up on that frame's results
+    // rather than wait, and reuse the slot
+    Frame& next = frames[current];
+    if (next.pending) {
+        droppedFrames++;
+        next.pending = false;
+    }
+    next.passCount = 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+
+// GL_TIME_ELAPSED queries around named render passes. Each frame's queries go into one slot of a
+// ring and are only read once the GPU reports them available, several frames later, so asking for
+// a result never stalls the pipeline. Finished passes are handed to the frame profiler as zones on
+// a "gpu" track, next to the CPU zones. Nothing is queried while the profiler isn't recording.
+class GpuTimer {
+public:
+    GpuTimer();
+
+    // Creates the query objects; needs a current GL context, which owns them from then on
+    void init();
+
+    // Passes can't nest: GL allows one GL_TIME_ELAPSED query at a time. `name` must be a literal.
+    void beginPass(const char* name);
+    void endPass();
+
+    // Closes the frame's slot and collects every older frame whose results have arrived
+    void endFrame();
+
+    // Frames whose results were still outstanding when their slot came round again
+    uint64_t getDroppedFrames() const { return droppedFrames; }
+
+private:
+    // Ring slots: a frame's results get three more frames to arrive before its slot is reused
+    static const int frameLatency = 4;
+    static const int maxPasses = 8;
+
+    struct Pass {
+        const char* name;
+        uint64_t cpuStart;  // profiler clock when the pass was issued; places it on the trace
+    };
+
+    struct Frame {
+        GLuint queries[maxPasses];
+        Pass passes[maxPasses];
+        int passCount;
+        bool pending;
+    };
+
+    GpuTimer(const GpuTimer&);
+    GpuTimer& operator=(const GpuTimer&);
+
+    bool collect(Frame& frame);
+
+    Frame frames[frameLatency];
+    int current;  // slot being recorded
+    bool passOpen;
+    bool initialized;
+    uint64_t droppedFrames;
+};
@@ -0,0 +1,118 @@
+#include "InputLog.h"
+
+#include <cstring>
+#include <iterator>
+
+// "TRIN", then the format version
+const char inputLogMagic[4] = { 'T', 'R', 'I', 'N' };
+// Version 2 added the scene flags; version 1 logs are read with none set
+const uint32_t inputLogVersion = 2;
+const size_t inputLogHeaderSize = 24;
+const size_t inputLogVersion1HeaderSize = 20;
+const size_t inputLogRecordSize = 5;
+
+namespace {
+
+// Function to write `value` as `bytes` little-endian bytes, whatever the host byte order
+void putLittleEndian(uint64_t value, int bytes, char* out) {
+    for (int i = 0; i < bytes; i++) {
+        out[i] = static_cast<char>((value >> (i * 8)) & 0xFF);
+    }
+}
+
+// Function to read `bytes` little-endian bytes
+uint64_t getLittleEndian(const char* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(in[i])) << (i * 8);
+    }
+    return value;
+}
+
+} // namespace
+
+uint8_t packInputKeys(const InputState& input, bool escape) {
+    uint8_t keys = 0;
+    keys |= input.left ? InputLeft : 0;
+    keys |= input.right ? InputRight : 0;
+    keys |= input.jump ? InputJump : 0;
+    keys |= escape ? InputEscape : 0;
+    return keys;
+}
+
+InputState unpackInputKeys(uint8_t keys) {
+    InputState input;
+    input.left = (keys & InputLeft) != 0;
+    input.right = (keys & InputRight) != 0;
+    input.jump = (keys & InputJump) != 0;
+    return input;
+}
+
+InputLogWriter::InputLogWriter() : tickCount(0) {}
+
+bool InputLogWriter::open(const char* path, uint64_t extraBodies, uint32_t sceneFlags) {
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+    uint32_t stepBits;
+    std::memcpy(&stepBits, &simulationStep, sizeof(stepBits));
+
+    char header[inputLogHeaderSize];
+    std::memcpy(header, inputLogMagic, sizeof(inputLogMagic));
+    putLittleEndian(inputLogVersion, 4, header + 4);
+    putLittleEndian(stepBits, 4, header + 8);
+    putLittleEndian(extraBodies, 8, header + 12);
+    putLittleEndian(sceneFlags, 4, header + 20);
+    out.write(header, sizeof(header));
+    tickCount = 0;
+    return static_cast<bool>(out);
+}
+
+void InputLogWriter::record(uint8_t keys, uint32_t checksum) {
+    char record[inputLogRecordSize];
+    record[0] = static_cast<char>(keys);
+    putLittleEndian(checksum, 4, record + 1);
+    out.write(record, sizeof(record));
+    tickCount++;
+}
+
+bool InputLogWriter::close() {
+    out.flush();
+    const bool written = static_cast<bool>(out);
+    out.close();
+    return written;
+}
+
+InputLog::InputLog() : step(0.0f), extraBodies(0), sceneFlags(0) {}
+
+bool InputLog::load(const char* path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    const std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < inputLogVersion1HeaderSize || std::memcmp(data.data(), inputLogMagic, sizeof(inputLogMagic)) != 0) {
+        return false;
+    }
+    const uint64_t version = getLittleEndian(data.data() + 4, 4);
+    const size_t headerSize = version == 1 ? inputLogVersion1HeaderSize : inputLogHeaderSize;
+    if (version > inputLogVersion || data.size() < headerSize) {
+        return false;
+    }
+
+    const uint32_t stepBits = static_cast<uint32_t>(getLittleEndian(data.data() + 8, 4));
+    std::memcpy(&step, &stepBits, sizeof(step));
+    extraBodies = getLittleEndian(data.data() + 12, 8);
+    sceneFlags = version == 1 ? 0 : static_cast<uint32_t>(getLittleEndian(data.data() + 20, 4));
+
+    // A recording cut off mid-record (the app was killed) keeps every whole step before it
+    const size_t count = (data.size() - headerSize) / inputLogRecordSize;
+    records.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const char* record = data.data() + headerSize + i * inputLogRecordSize;
+        records[i].keys = static_cast<uint8_t>(record[0]);
+        records[i].checksum = static_cast<uint32_t>(getLittleEndian(record + 1, 4));
+    }
+    return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Simulation.h"
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// Key bits of one simulation step in an input log
+enum InputKeys : uint8_t {
+    InputLeft = 1u << 0,
+    InputRight = 1u << 1,
+    InputJump = 1u << 2,
+    InputEscape = 1u << 3,  // Recorded for completeness; the simulation never reads it
+};
+
+uint8_t packInputKeys(const InputState& input, bool escape);
+InputState unpackInputKeys(uint8_t keys);
+
+// One simulation step of a log: the keys it ran with and the world checksum right after it
+struct InputRecord {
+    uint8_t keys;
+    uint32_t checksum;
+};
+
+// Input logs are a small header (format version, the step length, the scene's extra body count and
+// scene option bits) followed by five little-endian bytes per step: the key bits, then the checksum
+
+// Writes an input log one step at a time, straight into the file stream's buffer, so recording
+// doesn't allocate once the file is open
+class InputLogWriter {
+public:
+    InputLogWriter();
+
+    // Starts a log for a scene of the default bodies plus `extraBodies` scattered squares, set up
+    // with `sceneFlags`; the bits mean whatever the code building the scene says they do
+    bool open(const char* path, uint64_t extraBodies, uint32_t sceneFlags);
+    bool isOpen() const { return out.is_open(); }
+
+    void record(uint8_t keys, uint32_t checksum);
+
+    // Flushes the log; false if anything failed to write
+    bool close();
+
+    uint64_t getTickCount() const { return tickCount; }
+
+private:
+    std::ofstream out;
+    uint64_t tickCount;
+};
+
+// A whole input log read into memory, so replaying it never waits on the disk
+class InputLog {
+public:
+    InputLog();
+
+    // False if the file is missing, isn't an input log, or is a newer version
+    bool load(const char* path);
+
+    // Step length of the build that recorded it; checksums only match when it equals simulationStep
+    float getStep() const { return step; }
+    uint64_t getExtraBodies() const { return extraBodies; }
+    uint32_t getSceneFlags() const { return sceneFlags; }
+    uint64_t getTickCount() const { return records.size(); }
+    const InputRecord& getRecord(uint64_t tick) const { return records[tick]; }
+
+private:
+    float step;
+    uint64_t extraBodies;
+    uint32_t sceneFlags;
+    std::vector<InputRecord> records;
+};
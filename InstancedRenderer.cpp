@@ -0,0 +1,169 @@
+#include "InstancedRenderer.h"
+
+#include <algorithm>
+#include <cstddef>
+
+// Vertex shader source code: each instance scales and offsets the shared mesh
+const char* instancedVertexShaderSource = R"(
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec2 instanceOffset;
+layout(location = 2) in vec2 instanceScale;
+layout(location = 3) in vec4 instanceColor;
+uniform mat4 transform;
+out vec4 color;
+void main()
+{
+    color = instanceColor;
+    gl_Position = transform * vec4(aPos.xy * instanceScale + instanceOffset, aPos.z, 1.0);
+}
+)";
+
+// Fragment shader source code
+const char* instancedFragmentShaderSource = R"(
+#version 330 core
+in vec4 color;
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = color;
+}
+)";
+
+InstancedRenderer::InstancedRenderer()
+    : meshBuffer(0), indexBuffer(0), instanceBuffer(0), capacity(0) {
+    transformUniform.location = -1;
+    transformUniform.type = GL_NONE;
+    vaos[0] = vaos[1] = 0;
+    for (int mesh = 0; mesh < 2; mesh++) {
+        meshes[mesh].indexCount = 0;
+        meshes[mesh].indexOffset = 0;
+        meshes[mesh].baseVertex = 0;
+    }
+    for (int i = 0; i < 16; i++) {
+        viewTransform[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+    }
+}
+
+void InstancedRenderer::init(const float* triangleVertices, int triangleVertexCount, const uint16_t* triangleIndices, int triangleIndexCount,
+    const float* squareVertices, int squareVertexCount, const uint16_t* squareIndices, int squareIndexCount) {
+    shader = ShaderProgram(createShaderProgram(instancedVertexShaderSource, instancedFragmentShaderSource));
+    transformUniform = shader.getUniform("transform");
+
+    // Both meshes share one vertex buffer and one index buffer: triangle first, square after it.
+    // Indices stay local to their mesh; the square's draw adds its base vertex.
+    const GLsizeiptr triangleBytes = triangleVertexCount * 3 * sizeof(float);
+    const GLsizeiptr squareBytes = squareVertexCount * 3 * sizeof(float);
+    const GLsizeiptr triangleIndexBytes = triangleIndexCount * sizeof(uint16_t);
+    const GLsizeiptr squareIndexBytes = squareIndexCount * sizeof(uint16_t);
+    meshes[0].indexCount = triangleIndexCount;
+    meshes[0].indexOffset = 0;
+    meshes[0].baseVertex = 0;
+    meshes[1].indexCount = squareIndexCount;
+    meshes[1].indexOffset = static_cast<size_t>(triangleIndexBytes);
+    meshes[1].baseVertex = triangleVertexCount;
+
+    glGenBuffers(1, &meshBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, meshBuffer);
+    glBufferData(GL_ARRAY_BUFFER, triangleBytes + squareBytes, nullptr, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, triangleBytes, triangleVertices);
+    glBufferSubData(GL_ARRAY_BUFFER, triangleBytes, squareBytes, squareVertices);
+
+    glGenBuffers(1, &instanceBuffer);
+    glGenBuffers(1, &indexBuffer);
+    glGenVertexArrays(2, vaos);
+    for (int mesh = 0; mesh < 2; mesh++) {
+        glBindVertexArray(vaos[mesh]);
+        glBindBuffer(GL_ARRAY_BUFFER, meshBuffer);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        // The element buffer binding is part of the VAO
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        for (GLuint attribute = 1; attribute <= 3; attribute++) {
+            glEnableVertexAttribArray(attribute);
+            glVertexAttribDivisor(attribute, 1);
+        }
+    }
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangleIndexBytes + squareIndexBytes, nullptr, GL_STATIC_DRAW);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, triangleIndexBytes, triangleIndices);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, triangleIndexBytes, squareIndexBytes, squareIndices);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    reserveInstances(1024);
+}
+
+void InstancedRenderer::setViewTransform(const float* matrix) {
+    std::copy(matrix, matrix + 16, viewTransform);
+}
+
+void InstancedRenderer::begin() {
+    triangles.clear();
+    squares.clear();
+}
+
+void InstancedRenderer::bindInstanceAttributes(GLuint vao, size_t firstInstance) {
+    const GLsizei stride = sizeof(InstanceData);
+    const size_t base = firstInstance * sizeof(InstanceData);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(base + offsetof(InstanceData, offsetX)));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(base + offsetof(InstanceData, scaleX)));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void*)(base + offsetof(InstanceData, color)));
+}
+
+void InstancedRenderer::drawMesh(int mesh, size_t instanceCount) {
+    glBindVertexArray(vaos[mesh]);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, meshes[mesh].indexCount, GL_UNSIGNED_SHORT,
+        (void*)meshes[mesh].indexOffset, static_cast<GLsizei>(instanceCount), meshes[mesh].baseVertex);
+}
+
+void InstancedRenderer::reserveInstances(size_t count) {
+    if (count <= capacity) {
+        return;
+    }
+    while (capacity < count) {
+        capacity = capacity == 0 ? count : capacity * 2;
+    }
+
+    // Only reallocated on growth; the attribute pointers for the square half move with it
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, 2 * capacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+    bindInstanceAttributes(vaos[0], 0);
+    bindInstanceAttributes(vaos[1], capacity);
+    glBindVertexArray(0);
+}
+
+void InstancedRenderer::draw(GpuTimer* timer) {
+    reserveInstances(std::max(triangles.size(), squares.size()));
+
+    if (timer) {
+        timer->beginPass("instance upload");
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, triangles.size() * sizeof(InstanceData), triangles.data());
+    glBufferSubData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), squares.size() * sizeof(InstanceData), squares.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    shader.use();
+    shader.setMat4(transformUniform, viewTransform, true);
+
+    // Draw every triangle
+    if (timer) {
+        timer->endPass();
+        timer->beginPass("triangles");
+    }
+    drawMesh(0, triangles.size());
+
+    // Draw every square
+    if (timer) {
+        timer->endPass();
+        timer->beginPass("squares");
+    }
+    drawMesh(1, squares.size());
+    glBindVertexArray(0);
+    if (timer) {
+        timer->endPass();
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "GpuTimer.h"
+#include "ShaderProgram.h"
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+// Per-instance attributes streamed to the GPU every frame
+struct InstanceData {
+    float offsetX;
+    float offsetY;
+    float scaleX;
+    float scaleY;
+    float color[4];
+};
+
+// Draws every triangle with one instanced call and every square with another. Both meshes are
+// indexed triangle lists sharing one vertex buffer and one index buffer, so nothing relies on
+// primitives a core profile lacks. All instance data for a frame goes into a single buffer:
+// triangles fill the first half, squares the second.
+class InstancedRenderer {
+public:
+    InstancedRenderer();
+
+    // Uploads the shared meshes (x, y, z per vertex, indices local to each mesh) and builds the
+    // instancing shader
+    void init(const float* triangleVertices, int triangleVertexCount, const uint16_t* triangleIndices, int triangleIndexCount,
+        const float* squareVertices, int squareVertexCount, const uint16_t* squareIndices, int squareIndexCount);
+
+    // Row-major view matrix applied to every instance; identity until set. Shapes are placed by
+    // their own offsets, so the app leaves it at identity; a camera pan or zoom would go here.
+    void setViewTransform(const float* matrix);
+
+    // Starts a new frame's instance lists
+    void begin();
+    void addTriangle(const InstanceData& instance) { triangles.push_back(instance); }
+    void addSquare(const InstanceData& instance) { squares.push_back(instance); }
+
+    // Uploads this frame's instances and issues the two draw calls. With a timer, the upload and
+    // each draw call are timed as separate GPU passes.
+    void draw(GpuTimer* timer = nullptr);
+
+private:
+    void reserveInstances(size_t count);
+    void bindInstanceAttributes(GLuint vao, size_t firstInstance);
+    void drawMesh(int mesh, size_t instanceCount);
+
+    ShaderProgram shader;
+    UniformHandle transformUniform;
+    float viewTransform[16];
+
+    // Where one mesh sits in the shared vertex and index buffers
+    struct MeshRange {
+        GLsizei indexCount;
+        size_t indexOffset;  // bytes into the index buffer
+        GLint baseVertex;
+    };
+
+    GLuint meshBuffer;
+    GLuint indexBuffer;
+    GLuint instanceBuffer;
+    GLuint vaos[2];  // triangle, square
+    MeshRange meshes[2];
+    size_t capacity;  // instances per half of the instance buffer
+
+    std::vector<InstanceData> triangles;
+    std::vector<InstanceData> squares;
+};
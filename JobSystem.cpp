@@ -0,0 +1,136 @@
+#include "JobSystem.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem(unsigned threadCount) : queuedJobs(0), stopping(false) {
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+
+    for (unsigned i = 0; i < threadCount; i++) {
+        queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+    }
+    for (unsigned i = 1; i < threadCount; i++) {
+        workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+bool JobSystem::popLocal(unsigned thread, Job& job) {
+    WorkerQueue& queue = *queues[thread];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.count == 0) {
+        return false;
+    }
+    queue.count--;
+    job = queue.jobs[(queue.head + queue.count) & (queue.jobs.size() - 1)];
+    queuedJobs--;
+    return true;
+}
+
+bool JobSystem::steal(unsigned thief, Job& job) {
+    // Start with the next thread along so thieves spread over different victims
+    const unsigned count = getThreadCount();
+    for (unsigned offset = 1; offset < count; offset++) {
+        WorkerQueue& queue = *queues[(thief + offset) % count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.count != 0) {
+            job = queue.jobs[queue.head];
+            queue.head = (queue.head + 1) & (queue.jobs.size() - 1);
+            queue.count--;
+            queuedJobs--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::run(const Job& job, unsigned thread) {
+    {
+        // Closed before the count drops, so the zone is recorded by the time parallelFor returns
+        PROFILE_ZONE("job");
+        (*job.function)(job.chunk, job.begin, job.end, thread);
+    }
+    job.remaining->fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void JobSystem::workerLoop(unsigned thread) {
+    for (;;) {
+        Job job;
+        if (popLocal(thread, job) || steal(thread, job)) {
+            run(job, thread);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || queuedJobs.load() > 0; });
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, const RangeFunction& function) {
+    const size_t chunks = chunkCount(count, grain);
+    if (chunks == 0) {
+        return;
+    }
+    // Nothing to share: skip the queues entirely
+    if (chunks == 1 || getThreadCount() == 1) {
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+            function(chunk, chunk * grain, std::min(count, (chunk + 1) * grain), 0);
+        }
+        return;
+    }
+
+    std::atomic<size_t> remaining(chunks);
+    const unsigned threads = getThreadCount();
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        Job job = { &function, chunk, chunk * grain, std::min(count, (chunk + 1) * grain), &remaining };
+        WorkerQueue& queue = *queues[chunk % threads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.count == queue.jobs.size()) {
+            // Unroll the ring into a buffer twice the size
+            std::vector<Job> grown(queue.jobs.size() * 2);
+            for (size_t i = 0; i < queue.count; i++) {
+                grown[i] = queue.jobs[(queue.head + i) & (queue.jobs.size() - 1)];
+            }
+            queue.jobs.swap(grown);
+            queue.head = 0;
+        }
+        queue.jobs[(queue.head + queue.count) & (queue.jobs.size() - 1)] = job;
+        queue.count++;
+        queuedJobs++;
+    }
+    {
+        // Taking the lock orders the wake-up after any worker's check of queuedJobs
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+
+    // The caller works through its own share, then helps with everyone else's
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        Job job;
+        if (popLocal(0, job) || steal(0, job)) {
+            run(job, 0);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Every thread (the caller of parallelFor counts as thread 0) owns a
+// deque: it takes its own work from the back, newest first, while idle threads steal from the
+// front of someone else's. Chunks are dealt round-robin, so stealing only has to even out the
+// imbalance between them.
+class JobSystem {
+public:
+    // Runs one chunk: its index, the [begin, end) range it covers and the thread running it
+    typedef std::function<void(size_t chunk, size_t begin, size_t end, unsigned thread)> RangeFunction;
+
+    // `threadCount` includes the calling thread; 0 uses every hardware thread
+    explicit JobSystem(unsigned threadCount = 0);
+    ~JobSystem();
+
+    unsigned getThreadCount() const { return static_cast<unsigned>(queues.size()); }
+
+    // Number of chunks parallelFor splits `count` items into
+    static size_t chunkCount(size_t count, size_t grain) { return grain ? (count + grain - 1) / grain : 0; }
+
+    // Splits [0, count) into chunks of `grain` items and runs `function` on each across all threads,
+    // the caller included. Returns once every chunk has finished. Chunk indices are stable, so
+    // writing results per chunk and joining them in chunk order gives the same output however the
+    // chunks were scheduled. Must only be called from the thread that created the pool.
+    void parallelFor(size_t count, size_t grain, const RangeFunction& function);
+
+private:
+    struct Job {
+        const RangeFunction* function;
+        size_t chunk;
+        size_t begin;
+        size_t end;
+        std::atomic<size_t>* remaining;
+    };
+
+    // Ring of jobs. Unlike a deque it keeps its storage between calls, so once it has grown to the
+    // largest batch a parallelFor never allocates.
+    struct WorkerQueue {
+        WorkerQueue() : jobs(64), head(0), count(0) {}
+
+        std::mutex mutex;
+        std::vector<Job> jobs;  // power-of-two capacity
+        size_t head;
+        size_t count;
+    };
+
+    JobSystem(const JobSystem&);
+    JobSystem& operator=(const JobSystem&);
+
+    bool popLocal(unsigned thread, Job& job);
+    bool steal(unsigned thief, Job& job);
+    void run(const Job& job, unsigned thread);
+    void workerLoop(unsigned thread);
+
+    std::vector<std::unique_ptr<WorkerQueue> > queues;  // index 0 belongs to the calling thread
+    std::vector<std::thread> workers;
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> queuedJobs;
+    bool stopping;
+};
@@ -0,0 +1,167 @@
+#include "PairCache.h"
+
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define PAIR_CACHE_PREFETCH_SSE 1
+#endif
+
+// Never a real key: the lower slot of a pair is always below the higher one
+const uint64_t emptyPairKey = ~0ull;
+
+// Tables start this big and stay at most half full
+const size_t initialPairCacheCapacity = 64;
+
+namespace {
+
+// Function to make an empty entry
+PairCacheEntry emptyPairCacheEntry() {
+    PairCacheEntry entry = {};
+    entry.key = emptyPairKey;
+    return entry;
+}
+
+} // namespace
+
+PairCacheShard::PairCacheShard()
+    : used(0), mask(initialPairCacheCapacity - 1), step(1), collidingCount(0), previousCollidingCount(0), stayCount(0) {
+    entries.assign(initialPairCacheCapacity, emptyPairCacheEntry());
+}
+
+uint64_t PairCacheShard::slotOf(uint64_t key, uint64_t mask) {
+    // Fibonacci hashing, folded so the low bits the mask keeps depend on both slots
+    uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 32;
+    return hash & mask;
+}
+
+void PairCacheShard::beginStep() {
+    step++;
+    previousCollidingCount = collidingCount;
+    collidingCount = 0;
+    stayCount = 0;
+}
+
+// Copies the pairs seen this step or last into the spare array, in table order, and swaps it in.
+// Older pairs can't carry a simplex or a touch forward any more, so they're dropped.
+void PairCacheShard::rebuild() {
+    size_t live = 0;
+    for (size_t e = 0; e < entries.size(); e++) {
+        live += entries[e].key != emptyPairKey && entries[e].lastSeen + 1 >= step;
+    }
+    size_t capacity = entries.size();
+    while ((live + 1) * 4 > capacity) {
+        capacity *= 2;
+    }
+
+    spare.assign(capacity, emptyPairCacheEntry());
+    const uint64_t spareMask = capacity - 1;
+    for (size_t e = 0; e < entries.size(); e++) {
+        const PairCacheEntry& entry = entries[e];
+        if (entry.key == emptyPairKey || entry.lastSeen + 1 < step) {
+            continue;
+        }
+        uint64_t i = slotOf(entry.key, spareMask);
+        while (spare[i].key != emptyPairKey) {
+            i = (i + 1) & spareMask;
+        }
+        spare[i] = entry;
+    }
+    std::swap(entries, spare);
+    used = live;
+    mask = spareMask;
+}
+
+void PairCacheShard::prefetch(BodyHandle a, BodyHandle b) const {
+#if defined(PAIR_CACHE_PREFETCH_SSE)
+    const uint32_t low = std::min(a.slot, b.slot);
+    const uint32_t high = std::max(a.slot, b.slot);
+    const uint64_t key = (static_cast<uint64_t>(low) << 32) | high;
+    _mm_prefetch(reinterpret_cast<const char*>(&entries[slotOf(key, mask)]), _MM_HINT_T0);
+#else
+    (void)a;
+    (void)b;
+#endif
+}
+
+PairCacheEntry& PairCacheShard::touch(BodyHandle a, BodyHandle b) {
+    if (a.slot > b.slot) {
+        std::swap(a, b);
+    }
+    const uint64_t key = (static_cast<uint64_t>(a.slot) << 32) | b.slot;
+
+    for (uint64_t i = slotOf(key, mask); ; i = (i + 1) & mask) {
+        PairCacheEntry& entry = entries[i];
+        if (entry.key == key && entry.generationA == a.generation && entry.generationB == b.generation) {
+            if (entry.lastSeen + 1 < step) {
+                entry.simplex = SimplexCache();
+            }
+            entry.lastSeen = step;
+            return entry;
+        }
+        if (entry.key != emptyPairKey) {
+            // Includes the same slots under older generations: those bodies are gone, so that is a
+            // different pair, left for appendEnded to report and rebuild() to drop
+            continue;
+        }
+
+        if ((used + 1) * 2 > entries.size()) {
+            rebuild();
+            return touch(a, b);
+        }
+        entry = PairCacheEntry();
+        entry.key = key;
+        entry.generationA = a.generation;
+        entry.generationB = b.generation;
+        entry.lastSeen = step;
+        used++;
+        return entry;
+    }
+}
+
+bool PairCacheShard::touchColliding(BodyHandle a, BodyHandle b) {
+    PairCacheEntry& entry = touch(a, b);
+    const bool wasColliding = entry.lastColliding + 1 == step;
+    if (entry.lastColliding != step) {
+        entry.lastColliding = step;
+        collidingCount++;
+        stayCount += wasColliding;
+    }
+    return wasColliding;
+}
+
+void PairCacheShard::appendEnded(ArenaVector<ContactEvent>& events) const {
+    // Each stay carries over a different one of last step's touching pairs
+    if (stayCount == previousCollidingCount) {
+        return;
+    }
+    for (size_t e = 0; e < entries.size(); e++) {
+        const PairCacheEntry& entry = entries[e];
+        if (entry.key != emptyPairKey && entry.lastColliding + 1 == step) {
+            const ContactEvent event = { { static_cast<uint32_t>(entry.key >> 32), entry.generationA },
+                { static_cast<uint32_t>(entry.key & 0xFFFFFFFFu), entry.generationB } };
+            events.push_back(event);
+        }
+    }
+}
+
+size_t PairCache::shardOf(BodyHandle a, BodyHandle b) {
+    const uint64_t key = (static_cast<uint64_t>(std::min(a.slot, b.slot)) << 32) | std::max(a.slot, b.slot);
+    // The top bits of the product; the shards' own slots come from the folded low bits
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 60) & (pairCacheShardCount - 1);
+}
+
+void PairCache::beginStep() {
+    for (size_t s = 0; s < pairCacheShardCount; s++) {
+        shards[s].beginStep();
+    }
+}
+
+size_t PairCache::size() const {
+    size_t total = 0;
+    for (size_t s = 0; s < pairCacheShardCount; s++) {
+        total += shards[s].size();
+    }
+    return total;
+}
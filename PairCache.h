@@ -0,0 +1,102 @@
+#pragma once
+
+#include "BodyStore.h"
+#include "FrameArena.h"
+#include "Gjk.h"
+
+#include <cstdint>
+#include <vector>
+
+// Two bodies whose contact started, continued or ended this step. The handles are ordered by slot,
+// so the same pair always reads the same way round, and stay meaningful after dense indices move.
+struct ContactEvent {
+    BodyHandle a;
+    BodyHandle b;
+};
+
+// Contact events are grouped by type in one buffer, in this order
+enum ContactEventType {
+    ContactBegin = 0,  // touching now, not last step
+    ContactStay = 1,   // touching now and last step
+    ContactEnd = 2,    // touching last step, not now (or one of the bodies is gone)
+    contactEventTypeCount = 3,
+};
+
+// What the narrowphase remembers about a pair from one step to the next
+struct PairCacheEntry {
+    uint64_t key;  // lower handle slot in the high half, higher slot in the low half
+    uint32_t generationA;
+    uint32_t generationB;
+    SimplexCache simplex;    // last GJK simplex, in slot order; empty for pairs GJK hasn't seen
+    uint32_t lastSeen;       // last step the narrowphase looked at the pair
+    uint32_t lastColliding;  // last step the pair was touching; 0 if it never was
+};
+
+// One shard of the PairCache: an open-addressing hash table of the pairs the narrowphase looked
+// at, kept from step to step and stamped with the steps each pair was last seen and last touching.
+// Linear probing over a power-of-two array of entries. Pairs nobody looks at any more are only
+// dropped when the table fills up: it's rebuilt with the pairs from this step and the last into a
+// spare array, which doubles only while those pairs alone would fill a quarter of it, so the
+// tables stop allocating once they've seen the busiest step.
+class PairCacheShard {
+public:
+    PairCacheShard();
+
+    // Starts the next step; pairs not touched in it count as no longer touching
+    void beginStep();
+
+    // This step's entry for the pair, added on first use. A pair the narrowphase skipped last step
+    // comes back with an empty simplex. Invalidated by the next touch().
+    PairCacheEntry& touch(BodyHandle a, BodyHandle b);
+
+    // Starts loading the pair's part of the table, for a touch a few pairs later; the table can be
+    // far bigger than the cache, and the probes would otherwise be one miss after another
+    void prefetch(BodyHandle a, BodyHandle b) const;
+
+    // Marks the pair as touching this step; true if it was touching last step as well
+    bool touchColliding(BodyHandle a, BodyHandle b);
+
+    // Appends an event for every pair that was touching last step and isn't now. Free when every
+    // pair touching last step was marked touching again; otherwise a pass over the whole table.
+    void appendEnded(ArenaVector<ContactEvent>& events) const;
+
+    // Entries in the table, including pairs it hasn't dropped yet
+    size_t size() const { return used; }
+
+private:
+    static uint64_t slotOf(uint64_t key, uint64_t mask);
+    void rebuild();
+
+    std::vector<PairCacheEntry> entries;
+    std::vector<PairCacheEntry> spare;  // rebuilt into, then swapped with entries
+    size_t used;
+    uint64_t mask;
+    uint32_t step;                   // the first step is 2, so an entry stamped 0 never matches last step
+    size_t collidingCount;           // pairs marked touching this step
+    size_t previousCollidingCount;   // and last step
+    size_t stayCount;                // pairs touching this step and last
+};
+
+// Shards a pair lands in, by its hash; fixed, so the end events come out in the same order however
+// many threads the narrowphase runs on
+const size_t pairCacheShardCount = 16;
+
+// The narrowphase's pair memory, split by pair hash into shards that don't share anything, so each
+// shard can be worked through on a thread of its own: every pair's touches and GJK simplex live in
+// exactly one of them.
+class PairCache {
+public:
+    // The shard holding the pair, either way round
+    static size_t shardOf(BodyHandle a, BodyHandle b);
+
+    PairCacheShard& getShard(size_t shard) { return shards[shard]; }
+
+    // Starts the next step in every shard
+    void beginStep();
+
+    // Entries over all the shards, including pairs they haven't dropped yet
+    size_t size() const;
+
+private:
+    PairCacheShard shards[pairCacheShardCount];
+};
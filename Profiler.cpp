@@ -0,0 +1,200 @@
+#include "Profiler.h"
+
+#if FRAME_PROFILER
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct ZoneRecord {
+    const char* name;
+    uint64_t start;  // steady_clock nanoseconds
+    uint64_t end;
+};
+
+// Written only by its own thread. `written` counts every zone ever recorded; the release store
+// after each record lets the trace writer read everything below it.
+struct ThreadRing {
+    uint32_t threadIndex;
+    bool gpu;
+    std::atomic<uint64_t> written;
+    ZoneRecord records[profileRingCapacity];
+};
+
+struct ZoneStats {
+    std::vector<uint64_t> durations;
+};
+
+std::atomic<bool> profilerEnabled(false);
+
+// Rings are never freed, so zones from threads that have exited can still be written out
+std::mutex ringsMutex;
+std::vector<std::unique_ptr<ThreadRing> > rings;
+thread_local ThreadRing* localRing = nullptr;
+ThreadRing* gpuRing = nullptr;
+
+uint64_t nowNanoseconds() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+ThreadRing* registerRing(bool gpu) {
+    std::unique_ptr<ThreadRing> ring(new ThreadRing());
+    ring->gpu = gpu;
+    ring->written.store(0, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    ring->threadIndex = static_cast<uint32_t>(rings.size());
+    rings.push_back(std::move(ring));
+    return rings.back().get();
+}
+
+// First zone on a thread registers its ring; every later one only touches the thread's own ring
+ThreadRing& ringForThisThread() {
+    if (!localRing) {
+        localRing = registerRing(false);
+    }
+    return *localRing;
+}
+
+void pushZone(ThreadRing& ring, const char* name, uint64_t start, uint64_t end) {
+    const uint64_t index = ring.written.load(std::memory_order_relaxed);
+    ZoneRecord& record = ring.records[index & (profileRingCapacity - 1)];
+    record.name = name;
+    record.start = start;
+    record.end = end;
+    ring.written.store(index + 1, std::memory_order_release);
+}
+
+double toMicroseconds(uint64_t nanoseconds) {
+    return static_cast<double>(nanoseconds) / 1000.0;
+}
+
+} // namespace
+
+void setProfilerEnabled(bool enabled) {
+    profilerEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool isProfilerEnabled() {
+    return profilerEnabled.load(std::memory_order_relaxed);
+}
+
+ProfileZone::ProfileZone(const char* zoneName)
+    : name(profilerEnabled.load(std::memory_order_relaxed) ? zoneName : nullptr), start(0) {
+    if (name) {
+        start = nowNanoseconds();
+    }
+}
+
+ProfileZone::~ProfileZone() {
+    if (!name) {
+        return;
+    }
+    const uint64_t end = nowNanoseconds();
+    pushZone(ringForThisThread(), name, start, end);
+}
+
+uint64_t profileTimestamp() {
+    return nowNanoseconds();
+}
+
+void recordGpuZone(const char* name, uint64_t cpuStart, uint64_t gpuNanoseconds) {
+    if (!gpuRing) {
+        gpuRing = registerRing(true);
+    }
+    pushZone(*gpuRing, name, cpuStart, cpuStart + gpuNanoseconds);
+}
+
+bool writeProfileTrace(const char* path) {
+    // Snapshot what each ring still holds, oldest first
+    std::vector<std::pair<uint32_t, ZoneRecord> > zones;
+    std::vector<bool> gpuTracks;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (size_t r = 0; r < rings.size(); r++) {
+            const ThreadRing& ring = *rings[r];
+            gpuTracks.push_back(ring.gpu);
+            const uint64_t written = ring.written.load(std::memory_order_acquire);
+            const uint64_t first = written > profileRingCapacity ? written - profileRingCapacity : 0;
+            for (uint64_t i = first; i < written; i++) {
+                zones.push_back(std::make_pair(ring.threadIndex, ring.records[i & (profileRingCapacity - 1)]));
+            }
+        }
+    }
+
+    uint64_t epoch = zones.empty() ? 0 : zones[0].second.start;
+    std::map<std::string, ZoneStats> stats;
+    for (size_t i = 0; i < zones.size(); i++) {
+        epoch = std::min(epoch, zones[i].second.start);
+        // GPU passes get their own rows in the summary even when named like a CPU zone
+        const std::string name = gpuTracks[zones[i].first] ? std::string("gpu ") + zones[i].second.name : zones[i].second.name;
+        stats[name].durations.push_back(zones[i].second.end - zones[i].second.start);
+    }
+
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    out << std::fixed << std::setprecision(3);
+    out << "{\n";
+    out << "  \"displayTimeUnit\": \"ns\",\n";
+    out << "  \"traceEvents\": [\n";
+    for (uint32_t t = 0; t < gpuTracks.size(); t++) {
+        out << "    {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << t
+            << ", \"args\": {\"name\": \"";
+        if (gpuTracks[t]) {
+            out << "gpu";
+        }
+        else {
+            out << "thread " << t;
+        }
+        out << "\"}}" << (t + 1 < gpuTracks.size() || !zones.empty() ? "," : "") << "\n";
+    }
+    for (size_t i = 0; i < zones.size(); i++) {
+        const ZoneRecord& zone = zones[i].second;
+        out << "    {\"name\": \"" << zone.name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << zones[i].first
+            << ", \"ts\": " << toMicroseconds(zone.start - epoch) << ", \"dur\": " << toMicroseconds(zone.end - zone.start)
+            << "}" << (i + 1 < zones.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n";
+
+    // Chrome ignores keys it doesn't know, so the summary can ride along in the same file
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "zone" << std::setw(28) << "count" << std::setw(12) << "min us" << std::setw(12) << "avg us"
+        << std::setw(12) << "p99 us" << "\n";
+    out << "  \"zoneStats\": [\n";
+    size_t written = 0;
+    for (std::map<std::string, ZoneStats>::iterator it = stats.begin(); it != stats.end(); ++it, written++) {
+        std::vector<uint64_t>& durations = it->second.durations;
+        std::sort(durations.begin(), durations.end());
+        uint64_t total = 0;
+        for (size_t i = 0; i < durations.size(); i++) {
+            total += durations[i];
+        }
+        const double minimum = toMicroseconds(durations.front());
+        const double average = toMicroseconds(total) / static_cast<double>(durations.size());
+        const double p99 = toMicroseconds(durations[(durations.size() * 99 + 99) / 100 - 1]);
+
+        out << "    {\"name\": \"" << it->first << "\", \"count\": " << durations.size() << ", \"min_us\": " << minimum
+            << ", \"avg_us\": " << average << ", \"p99_us\": " << p99 << "}" << (written + 1 < stats.size() ? "," : "") << "\n";
+        std::cout << std::left << std::setw(24) << it->first << std::right << std::setw(8) << durations.size()
+            << std::setw(12) << minimum << std::setw(12) << average << std::setw(12) << p99 << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6) << std::flush;
+    return static_cast<bool>(out);
+}
+
+#endif
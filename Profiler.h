@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+// Scoped timing zones for finding where a frame goes. Every thread records into its own ring
+// buffer, so recording takes no locks; the rings keep the most recent zones and are read back when
+// a trace is written. Builds that define FRAME_PROFILER=0 compile every zone away.
+#ifndef FRAME_PROFILER
+#define FRAME_PROFILER 1
+#endif
+
+// Zones each thread keeps before the oldest are overwritten
+const uint32_t profileRingCapacity = 1u << 16;
+
+#if FRAME_PROFILER
+
+// Recording is off until enabled, so a zone on a hot path costs one load while nobody is looking
+void setProfilerEnabled(bool enabled);
+bool isProfilerEnabled();
+
+// Writes every recorded zone as a Chrome trace (chrome://tracing, Perfetto) with min/avg/p99 per
+// zone name alongside, and prints the same summary to stdout. Meant to run while the other
+// threads are idle (between frames); zones recorded during the write may be missing or torn.
+bool writeProfileTrace(const char* path);
+
+// Clock the zones are stamped with, in nanoseconds
+uint64_t profileTimestamp();
+
+// Adds a zone measured on the GPU to the "gpu" track. GPU and CPU clocks aren't correlated, so it
+// is placed at `cpuStart`, when the work was issued; only its duration is the GPU's. Call it from
+// the render thread only.
+void recordGpuZone(const char* name, uint64_t cpuStart, uint64_t gpuNanoseconds);
+
+// Times its own lifetime. `name` must outlive the profiler (use a string literal).
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name);
+    ~ProfileZone();
+
+private:
+    ProfileZone(const ProfileZone&);
+    ProfileZone& operator=(const ProfileZone&);
+
+    const char* name;  // null when recording was off at the start of the zone
+    uint64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+
+#else
+
+inline void setProfilerEnabled(bool) {}
+inline bool isProfilerEnabled() { return false; }
+inline bool writeProfileTrace(const char*) { return false; }
+inline uint64_t profileTimestamp() { return 0; }
+inline void recordGpuZone(const char*, uint64_t, uint64_t) {}
+
+#define PROFILE_ZONE(name) ((void)0)
+
+#endif
@@ -0,0 +1,1136 @@
+#include "SelfTest.h"
+
+#include "Collision.h"
+#include "ConvexPolygon.h"
+#include "DynamicTree.h"
+#include "Gjk.h"
+#include "JobSystem.h"
+#include "Simulation.h"
+#include "SpatialHash.h"
+#include "SweepAndPrune.h"
+#include "XorShift.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Prints a check's outcome; true when it found no mismatches
+bool report(const char* name, size_t checked, size_t mismatches) {
+    std::cout << name << ": " << checked << " checked, ";
+    if (mismatches == 0) {
+        std::cout << "ok" << std::endl;
+        return true;
+    }
+    std::cout << mismatches << " mismatches" << std::endl;
+    return false;
+}
+
+// Boxes on a quarter-unit grid, so many of them share edges exactly and the touching case
+// (which checkCollision counts as a hit) comes up often. A few get NaN, infinite, zero or
+// negative fields.
+Aabb randomTestBox(XorShift& rng) {
+    Aabb box = { static_cast<float>(rng.next() % 32) * 0.25f, static_cast<float>(rng.next() % 32) * 0.25f,
+        static_cast<float>(rng.next() % 8) * 0.25f, static_cast<float>(rng.next() % 8) * 0.25f };
+    float* fields[4] = { &box.x, &box.y, &box.width, &box.height };
+    switch (rng.next() % 16) {
+    case 0: *fields[rng.next() % 4] = std::numeric_limits<float>::quiet_NaN(); break;
+    case 1: *fields[rng.next() % 4] = std::numeric_limits<float>::infinity(); break;
+    case 2: *fields[rng.next() % 4] = -std::numeric_limits<float>::infinity(); break;
+    case 3: *fields[rng.next() % 4] = -0.5f; break;
+    case 4: box.x = rng.range(-1.0f, 9.0f); box.y = rng.range(-1.0f, 9.0f); break;
+    default: break;
+    }
+    return box;
+}
+
+// Which kernel this build's batch functions use; the others are checked by building without
+// (or with) AVX2, or for a target without SSE2
+const char* batchKernelName() {
+#if defined(__AVX2__)
+    return "batch kernels vs checkCollision (AVX2)";
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    return "batch kernels vs checkCollision (SSE2)";
+#else
+    return "batch kernels vs checkCollision (scalar)";
+#endif
+}
+
+// checkCollisionBatch, checkCollisionBatchIndices and checkCollisionBatchPairs against
+// checkCollision for every box of every list, with list lengths that leave every possible
+// tail after the SIMD blocks
+bool checkBatchKernels() {
+    XorShift rng(0x2545F4914F6CDD1Dull);
+    size_t checked = 0;
+    size_t mismatches = 0;
+    for (size_t count = 0; count <= 200; count += count < 70 ? 1 : 65) {
+        AabbSoA boxes;
+        for (size_t i = 0; i < count; i++) {
+            const Aabb box = randomTestBox(rng);
+            boxes.push(box.x, box.y, box.width, box.height);
+        }
+        const AabbSoAView view = boxes.view();
+
+        std::vector<uint64_t> hitMask(collisionMaskWords(count));
+        std::vector<uint32_t> indices(count);
+        for (int q = 0; q < 40; q++) {
+            const Aabb box = randomTestBox(rng);
+            checkCollisionBatch(box, view, hitMask.data());
+            const size_t hitCount = checkCollisionBatchIndices(box, view, indices.data());
+
+            size_t expectedCount = 0;
+            for (size_t i = 0; i < count; i++) {
+                const bool expected = checkCollision(box, Aabb{ view.x[i], view.y[i], view.width[i], view.height[i] });
+                const bool masked = ((hitMask[i >> 6] >> (i & 63)) & 1u) != 0;
+                const bool listed = expectedCount < hitCount && indices[expectedCount] == i;
+                mismatches += masked != expected || listed != expected;
+                expectedCount += expected;
+                checked++;
+            }
+            mismatches += hitCount != expectedCount;
+        }
+
+        // Every box of the list against the whole list
+        std::vector<CollisionPair> pairs;
+        checkCollisionBatchPairs(view, view, pairs);
+        size_t next = 0;
+        for (size_t a = 0; a < count; a++) {
+            for (size_t b = 0; b < count; b++) {
+                const bool expected = checkCollision(Aabb{ view.x[a], view.y[a], view.width[a], view.height[a] },
+                    Aabb{ view.x[b], view.y[b], view.width[b], view.height[b] });
+                const bool listed = next < pairs.size() && pairs[next].a == a && pairs[next].b == b;
+                mismatches += listed != expected;
+                next += listed;
+                checked++;
+            }
+        }
+        mismatches += next != pairs.size();
+    }
+    return report(batchKernelName(), checked, mismatches);
+}
+
+// Every pair of live boxes that checkCollision says overlap, as (lower id, higher id)
+std::set<std::pair<uint32_t, uint32_t>> bruteForcePairs(const std::vector<Aabb>& boxes, const std::vector<bool>& live) {
+    std::set<std::pair<uint32_t, uint32_t>> pairs;
+    for (uint32_t a = 0; a < boxes.size(); a++) {
+        for (uint32_t b = a + 1; b < boxes.size(); b++) {
+            if (live[a] && live[b] && checkCollision(boxes[a], boxes[b])) {
+                pairs.insert(std::make_pair(a, b));
+            }
+        }
+    }
+    return pairs;
+}
+
+// SweepAndPrune's pair set, and the set its events add up to, against brute force after every
+// update of random adds, moves and removes. Every add must name a pair that overlaps once the
+// update is done, and removing a box may only report its own pairs as removed; it used to sweep
+// the box out past boxes it never touched and report each as added and removed again.
+bool checkSweepAndPrune() {
+    size_t checked = 0;
+    size_t mismatches = 0;
+    {
+        SweepAndPrune apart;
+        const uint32_t a = apart.addBox(Aabb{ 0.0f, 0.0f, 1.0f, 1.0f });
+        apart.addBox(Aabb{ 5.0f, 0.0f, 1.0f, 1.0f });
+        apart.update();
+        apart.clearEvents();
+        apart.removeBox(a);
+        mismatches += !apart.getEvents().empty();
+        checked++;
+    }
+
+    XorShift rng(0x5DEECE66Dull);
+    SweepAndPrune sweep;
+    std::vector<Aabb> boxes;
+    std::vector<bool> live;
+    std::set<std::pair<uint32_t, uint32_t>> replayed;
+    for (int frame = 0; frame < 200; frame++) {
+        for (int change = 0; change < 12; change++) {
+            const uint32_t id = static_cast<uint32_t>(rng.next() % (boxes.size() + 1));
+            Aabb box = randomTestBox(rng);
+            // Keep the box finite and the right way round; the sweep doesn't take NaN bounds
+            if (!(box.x == box.x && box.y == box.y && box.width >= 0.0f && box.height >= 0.0f
+                && box.x + box.width < 100.0f && box.y + box.height < 100.0f && box.x > -100.0f && box.y > -100.0f)) {
+                box = Aabb{ 1.0f, 1.0f, 0.5f, 0.5f };
+            }
+            if (id < boxes.size() && live[id]) {
+                if (rng.next() % 4 == 0) {
+                    // Removing a box only ends its own pairs
+                    const size_t firstEvent = sweep.getEvents().size();
+                    sweep.removeBox(id);
+                    for (size_t e = firstEvent; e < sweep.getEvents().size(); e++) {
+                        const PairEvent& event = sweep.getEvents()[e];
+                        mismatches += event.type != PairEvent::Removed || (event.a != id && event.b != id);
+                        checked++;
+                    }
+                    live[id] = false;
+                }
+                else {
+                    sweep.moveBox(id, box);
+                    boxes[id] = box;
+                }
+            }
+            else {
+                const uint32_t added = sweep.addBox(box);
+                if (added >= boxes.size()) {
+                    boxes.resize(added + 1);
+                    live.resize(added + 1, false);
+                }
+                boxes[added] = box;
+                live[added] = true;
+            }
+        }
+        sweep.update();
+
+        const std::set<std::pair<uint32_t, uint32_t>> expected = bruteForcePairs(boxes, live);
+        for (size_t e = 0; e < sweep.getEvents().size(); e++) {
+            const PairEvent& event = sweep.getEvents()[e];
+            if (event.type == PairEvent::Added) {
+                mismatches += !replayed.insert(std::make_pair(event.a, event.b)).second;
+                // Adds come from the update, so the pair must overlap as it left the boxes
+                mismatches += expected.count(std::make_pair(event.a, event.b)) == 0;
+                checked++;
+            }
+            else {
+                mismatches += replayed.erase(std::make_pair(event.a, event.b)) != 1;
+            }
+        }
+        sweep.clearEvents();
+
+        std::vector<CollisionPair> pairs;
+        sweep.getPairs(pairs);
+        std::set<std::pair<uint32_t, uint32_t>> found;
+        for (size_t i = 0; i < pairs.size(); i++) {
+            found.insert(std::make_pair(std::min(pairs[i].a, pairs[i].b), std::max(pairs[i].a, pairs[i].b)));
+        }
+        mismatches += found != expected || replayed != expected || found.size() != pairs.size();
+        checked += expected.size();
+    }
+    return report("sweep and prune pairs vs brute force", checked, mismatches);
+}
+
+// Adds (lower, higher) of each pair to `out`; false if a pair comes up twice
+bool collectPairs(const std::vector<CollisionPair>& pairs, std::set<std::pair<uint32_t, uint32_t>>& out) {
+    bool unique = true;
+    for (size_t i = 0; i < pairs.size(); i++) {
+        unique = out.insert(std::make_pair(std::min(pairs[i].a, pairs[i].b), std::max(pairs[i].a, pairs[i].b))).second && unique;
+    }
+    return unique;
+}
+
+// True when both lists hold the same pairs in the same order
+bool samePairs(const ArenaVector<CollisionPair>& first, const ArenaVector<CollisionPair>& second) {
+    return first.size() == second.size() && std::equal(first.begin(), first.end(), second.begin(),
+        [](const CollisionPair& x, const CollisionPair& y) { return x.a == y.a && x.b == y.b; });
+}
+
+// SpatialHashGrid's candidate pairs against brute force on random boxes, many larger than a cell,
+// packed tightly enough for a bucket per cell or spread far enough to hash, and in some rounds at
+// NaN or infinite coordinates. Every pair must come once with a < b and pass the layers, and the
+// threaded build and search must give the same list as the single-threaded ones. Candidates are a
+// superset, so only the ones checkCollision keeps must match. Last, a few piles too big for brute
+// force, so the threaded build and search split them into many chunks, against the single-threaded
+// list alone.
+bool checkSpatialHash() {
+    XorShift rng(0x9E3779B97F4A7C15ull);
+    JobSystem jobs(4);
+    size_t checked = 0;
+    size_t mismatches = 0;
+    for (int round = 0; round < 60; round++) {
+        const size_t count = 1 + rng.next() % 600;
+        const float spread = round % 3 == 2 ? 5000.0f : 1.0f;
+        const bool layered = round % 2 == 1;
+        std::vector<Aabb> boxes(count);
+        AabbSoA soa;
+        std::vector<uint32_t> categories(count);
+        std::vector<uint32_t> masks(count);
+        for (size_t i = 0; i < count; i++) {
+            boxes[i] = randomTestBox(rng);
+            boxes[i].x *= spread;
+            boxes[i].y *= spread;
+            // One NaN or infinite cell stretches the grid past a bucket per cell
+            if (round % 2 == 0 && !(std::fabs(boxes[i].x) < 1e6f && std::fabs(boxes[i].y) < 1e6f)) {
+                boxes[i].x = rng.range(-1.0f, 9.0f);
+                boxes[i].y = rng.range(-1.0f, 9.0f);
+            }
+            soa.push(boxes[i].x, boxes[i].y, boxes[i].width, boxes[i].height);
+            categories[i] = layered ? 1u << (rng.next() % 3) : 1u;
+            masks[i] = layered ? static_cast<uint32_t>(rng.next() % 8) : 0xFFFFFFFFu;
+        }
+
+        // checkCollision reads a NaN box as touching everything, but it has no cell to bin it in;
+        // the grid only has to get through those without finding their pairs
+        std::vector<bool> finite(count);
+        for (size_t i = 0; i < count; i++) {
+            const Aabb& box = boxes[i];
+            finite[i] = box.x == box.x && box.y == box.y && box.width == box.width && box.height == box.height;
+        }
+        std::set<std::pair<uint32_t, uint32_t>> expected;
+        for (uint32_t a = 0; a < count; a++) {
+            for (uint32_t b = a + 1; b < count; b++) {
+                if (finite[a] && finite[b] && checkCollision(boxes[a], boxes[b]) && layersCollide(categories[a], masks[a], categories[b], masks[b])) {
+                    expected.insert(std::make_pair(a, b));
+                }
+            }
+        }
+
+        FrameArena arena;
+        SpatialHashGrid grid(round % 4 == 3 ? 0.3f : 0.5f);
+        SpatialHashGrid threadedGrid(grid.getCellSize());
+        grid.build(soa.view(), categories.data(), masks.data(), arena);
+        threadedGrid.build(jobs, soa.view(), categories.data(), masks.data(), arena);
+        ArenaVector<CollisionPair> single{ ArenaAllocator<CollisionPair>(&arena) };
+        ArenaVector<CollisionPair> threaded{ ArenaAllocator<CollisionPair>(&arena) };
+        ArenaVector<CollisionPair> threadedBuild{ ArenaAllocator<CollisionPair>(&arena) };
+        grid.findCandidatePairs(single);
+        grid.findCandidatePairs(jobs, threaded);
+        threadedGrid.findCandidatePairs(threadedBuild);
+
+        std::set<std::pair<uint32_t, uint32_t>> candidates;
+        std::set<std::pair<uint32_t, uint32_t>> found;
+        for (size_t i = 0; i < single.size(); i++) {
+            const uint32_t a = single[i].a;
+            const uint32_t b = single[i].b;
+            mismatches += a >= b || !layersCollide(categories[a], masks[a], categories[b], masks[b]);
+            mismatches += !candidates.insert(std::make_pair(a, b)).second;
+            if (finite[a] && finite[b] && checkCollision(boxes[a], boxes[b])) {
+                found.insert(std::make_pair(a, b));
+            }
+        }
+        mismatches += found != expected;
+        mismatches += !samePairs(single, threaded) + !samePairs(single, threadedBuild);
+        checked += expected.size() + 2;
+        grid.releaseScratch();
+        threadedGrid.releaseScratch();
+    }
+
+    for (int round = 0; round < 4; round++) {
+        const size_t count = 30000 + rng.next() % 30000;
+        const float side = round % 2 == 0 ? 60.0f : 3000.0f;
+        AabbSoA soa;
+        std::vector<uint32_t> categories(count, 1u);
+        std::vector<uint32_t> masks(count, allCollisionLayers);
+        for (size_t i = 0; i < count; i++) {
+            // One box in fifty larger than a cell
+            const float size = i % 50 == 0 ? rng.range(0.5f, 3.0f) : rng.range(0.05f, 0.5f);
+            soa.push(rng.range(0.0f, side), rng.range(0.0f, side), size, rng.range(0.05f, 0.5f));
+            masks[i] = round >= 2 && i % 7 == 0 ? 0u : allCollisionLayers;
+        }
+        FrameArena arena;
+        SpatialHashGrid grid;
+        SpatialHashGrid threadedGrid;
+        grid.build(soa.view(), categories.data(), masks.data(), arena);
+        threadedGrid.build(jobs, soa.view(), categories.data(), masks.data(), arena);
+        ArenaVector<CollisionPair> single{ ArenaAllocator<CollisionPair>(&arena) };
+        ArenaVector<CollisionPair> threaded{ ArenaAllocator<CollisionPair>(&arena) };
+        grid.findCandidatePairs(single);
+        threadedGrid.findCandidatePairs(jobs, threaded);
+        mismatches += !samePairs(single, threaded);
+        checked += single.size() + 1;
+        grid.releaseScratch();
+        threadedGrid.releaseScratch();
+    }
+    return report("spatial hash pairs vs brute force", checked, mismatches);
+}
+
+// DynamicAabbTree through random inserts, moves and removes: every fat box holds its tight box,
+// move() reinserts exactly when the box leaves it, the tree stays balanced, and query,
+// findSelfPairs and findTreePairs find the same leaves as testing every fat box
+bool checkDynamicTree() {
+    XorShift rng(0x853C49E6748FEA9Bull);
+    DynamicAabbTree tree(0.1f);
+    DynamicAabbTree level(0.0f);
+    std::vector<Aabb> levelBoxes;
+    for (uint32_t i = 0; i < 64; i++) {
+        const Aabb box = { rng.range(0.0f, 20.0f), rng.range(0.0f, 20.0f), rng.range(0.1f, 2.0f), rng.range(0.1f, 2.0f) };
+        level.insert(box, i);
+        levelBoxes.push_back(box);
+    }
+
+    // Indexed by user data: the leaf's proxy, or nullNode once removed
+    std::vector<int32_t> proxies;
+    std::vector<Aabb> tight;
+    size_t checked = 0;
+    size_t mismatches = 0;
+    for (int frame = 0; frame < 200; frame++) {
+        for (int change = 0; change < 16; change++) {
+            const uint32_t id = static_cast<uint32_t>(rng.next() % (proxies.size() + 1));
+            if (id == proxies.size() || proxies[id] == DynamicAabbTree::nullNode) {
+                const Aabb box = { rng.range(0.0f, 20.0f), rng.range(0.0f, 20.0f), rng.range(0.1f, 2.0f), rng.range(0.1f, 2.0f) };
+                const uint32_t userData = static_cast<uint32_t>(proxies.size());
+                proxies.push_back(tree.insert(box, userData));
+                tight.push_back(box);
+            }
+            else if (rng.next() % 4 == 0) {
+                tree.remove(proxies[id]);
+                proxies[id] = DynamicAabbTree::nullNode;
+            }
+            else {
+                // Mostly small steps the margin absorbs, now and then a jump
+                Aabb box = tight[id];
+                const float step = rng.next() % 8 == 0 ? 4.0f : 0.08f;
+                box.x += rng.range(-step, step);
+                box.y += rng.range(-step, step);
+                const Aabb fat = tree.getFatAabb(proxies[id]);
+                const bool inside = fat.x <= box.x && fat.y <= box.y && box.x + box.width <= fat.x + fat.width
+                    && box.y + box.height <= fat.y + fat.height;
+                mismatches += tree.move(proxies[id], box) == inside;
+                tight[id] = box;
+                checked++;
+            }
+        }
+
+        size_t leafCount = 0;
+        for (uint32_t id = 0; id < proxies.size(); id++) {
+            if (proxies[id] == DynamicAabbTree::nullNode) {
+                continue;
+            }
+            const Aabb fat = tree.getFatAabb(proxies[id]);
+            mismatches += tree.getUserData(proxies[id]) != id;
+            mismatches += !(fat.x <= tight[id].x && fat.y <= tight[id].y && tight[id].x + tight[id].width <= fat.x + fat.width
+                && tight[id].y + tight[id].height <= fat.y + fat.height);
+            leafCount++;
+        }
+        // An AVL-balanced tree of n leaves is at most about 1.44 log2(n) high
+        mismatches += tree.getHeight() > 2 * static_cast<int32_t>(std::ceil(std::log2(static_cast<float>(leafCount) + 1.0f))) + 1;
+
+        for (int q = 0; q < 8; q++) {
+            const Aabb box = { rng.range(-1.0f, 20.0f), rng.range(-1.0f, 20.0f), rng.range(0.0f, 4.0f), rng.range(0.0f, 4.0f) };
+            std::set<uint32_t> found;
+            bool unique = true;
+            tree.query(box, [&](int32_t proxy) {
+                unique = found.insert(tree.getUserData(proxy)).second && unique;
+                return true;
+            });
+            std::set<uint32_t> expected;
+            for (uint32_t id = 0; id < proxies.size(); id++) {
+                if (proxies[id] != DynamicAabbTree::nullNode && checkCollision(tree.getFatAabb(proxies[id]), box)) {
+                    expected.insert(id);
+                }
+            }
+            mismatches += !unique || found != expected;
+            checked += expected.size();
+        }
+
+        std::vector<CollisionPair> pairs;
+        tree.findSelfPairs(pairs);
+        std::set<std::pair<uint32_t, uint32_t>> found;
+        mismatches += !collectPairs(pairs, found);
+        std::set<std::pair<uint32_t, uint32_t>> expected;
+        for (uint32_t a = 0; a < proxies.size(); a++) {
+            for (uint32_t b = a + 1; b < proxies.size(); b++) {
+                if (proxies[a] != DynamicAabbTree::nullNode && proxies[b] != DynamicAabbTree::nullNode
+                    && checkCollision(tree.getFatAabb(proxies[a]), tree.getFatAabb(proxies[b]))) {
+                    expected.insert(std::make_pair(a, b));
+                }
+            }
+        }
+        for (size_t i = 0; i < pairs.size(); i++) {
+            mismatches += pairs[i].a >= pairs[i].b;
+        }
+        mismatches += found != expected;
+        checked += expected.size();
+
+        // Moving leaves against the level tree; these pairs are (tree, level), so not reordered
+        pairs.clear();
+        findTreePairs(tree, level, pairs);
+        std::set<std::pair<uint32_t, uint32_t>> foundAcross;
+        std::set<std::pair<uint32_t, uint32_t>> expectedAcross;
+        for (size_t i = 0; i < pairs.size(); i++) {
+            mismatches += !foundAcross.insert(std::make_pair(pairs[i].a, pairs[i].b)).second;
+        }
+        for (uint32_t a = 0; a < proxies.size(); a++) {
+            for (uint32_t b = 0; b < levelBoxes.size(); b++) {
+                if (proxies[a] != DynamicAabbTree::nullNode && checkCollision(tree.getFatAabb(proxies[a]), levelBoxes[b])) {
+                    expectedAcross.insert(std::make_pair(a, b));
+                }
+            }
+        }
+        mismatches += foundAcross != expectedAcross;
+        checked += expectedAcross.size();
+    }
+    return report("dynamic AABB tree vs brute force", checked, mismatches);
+}
+
+// The scene's triangle and square through the SAT test, alone and in the simulation. A square
+// tucked into a top corner of the triangle's box overlaps the box but not the triangle; one sitting
+// on the triangle's base, or with a corner exactly on a slanted edge's midpoint, touches it, and
+// nudging that corner a little either way across the edge flips the answer.
+bool checkPolygons() {
+    const Simulation simulation;
+    const std::vector<ConvexPolygon>& shapes = simulation.getShapes();
+    const ConvexPolygon& triangle = shapes[0];
+    const ConvexPolygon& square = shapes[1];
+    // Well clear of the player and the scene's own square, at coordinates that add up exactly
+    const float triangleX = 20.0f;
+    const float triangleY = 0.0f;
+    struct Placement {
+        float x;
+        float y;
+        bool touching;
+    };
+    const float nudge = 1e-3f;
+    const Placement placements[] = {
+        { triangleX - 0.2f, triangleY + 0.3f, false },                       // top-left corner of the box
+        { triangleX + triangle.width - 0.05f, triangleY + 0.3f, false },     // top-right corner
+        { triangleX + 0.1f, triangleY - square.height, true },               // on the base
+        { triangleX - 0.125f, triangleY + 0.25f, true },                     // corner on the left edge
+        { triangleX - 0.125f - nudge, triangleY + 0.25f + nudge, false },    // just off it
+        { triangleX - 0.125f + nudge, triangleY + 0.25f - nudge, true },     // just into it
+        { triangleX + 0.375f + nudge, triangleY + 0.25f + nudge, false },    // just off the right edge
+    };
+    const int placementCount = sizeof(placements) / sizeof(placements[0]);
+
+    size_t checked = 0;
+    size_t mismatches = 0;
+    for (int i = 0; i < placementCount; i++) {
+        const Placement& p = placements[i];
+        const Aabb triangleBox = { triangleX, triangleY, triangle.width, triangle.height };
+        const Aabb squareBox = { p.x, p.y, square.width, square.height };
+        mismatches += !checkCollision(triangleBox, squareBox);
+        mismatches += checkPolygonCollision(triangle, triangleX, triangleY, square, p.x, p.y) != p.touching;
+        mismatches += checkPolygonCollision(square, p.x, p.y, triangle, triangleX, triangleY) != p.touching;
+        checked += 3;
+    }
+
+    // One placement at a time, so each square only meets the triangle
+    for (int i = 0; i < placementCount; i++) {
+        Simulation scene;
+        const BodyHandle sceneTriangle = scene.addBody(0, triangleX, triangleY);
+        const BodyHandle sceneSquare = scene.addBody(1, placements[i].x, placements[i].y, BodySquare);
+        InputState input = {};
+        scene.step(input);
+        const BodyStore& bodies = scene.getBodies();
+        const uint32_t a = static_cast<uint32_t>(bodies.indexOf(sceneTriangle));
+        const uint32_t b = static_cast<uint32_t>(bodies.indexOf(sceneSquare));
+        bool reported = false;
+        const ArenaVector<CollisionPair>& pairs = scene.getCollidingPairs();
+        for (size_t j = 0; j < pairs.size(); j++) {
+            reported = reported || (pairs[j].a == a && pairs[j].b == b) || (pairs[j].a == b && pairs[j].b == a);
+        }
+        mismatches += reported != placements[i].touching;
+        checked++;
+    }
+    return report("SAT triangle vs square corners and edges", checked, mismatches);
+}
+
+// Hull of a box with its min corner at the shape's origin, as the simulation builds for bodies
+ConvexShape boxShape(float width, float height) {
+    const float corners[8] = { 0.0f, 0.0f, 0.0f, height, width, height, width, 0.0f };
+    return makeHullShape(makeConvexPolygon(corners, 4, 2));
+}
+
+// computeContact on random pairs, many with one box spanning the other on an axis: it reports
+// exactly the overlapping pairs, its depth is the least of the four push-out distances and agrees
+// with EPA on the same boxes, and moving box 1 by the MTV leaves the boxes at most touching
+bool checkContacts() {
+    XorShift rng(0xDA942042E4DD58B5ull);
+    size_t checked = 0;
+    size_t mismatches = 0;
+    for (int i = 0; i < 20000; i++) {
+        const Aabb a = { rng.range(-2.0f, 2.0f), rng.range(-2.0f, 2.0f), rng.range(0.1f, 3.0f), rng.range(0.1f, 3.0f) };
+        const Aabb b = { rng.range(-2.0f, 2.0f), rng.range(-2.0f, 2.0f), rng.range(0.1f, 3.0f), rng.range(0.1f, 3.0f) };
+        Contact contact;
+        const bool hit = computeContact(a, b, contact);
+        const bool overlapping = a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+        mismatches += hit != overlapping;
+        if (!hit) {
+            continue;
+        }
+        checked++;
+
+        const float least = std::min(std::min(a.x + a.width - b.x, b.x + b.width - a.x),
+            std::min(a.y + a.height - b.y, b.y + b.height - a.y));
+        mismatches += contact.depth != least;
+        mismatches += std::abs(contact.normalX) + std::abs(contact.normalY) != 1.0f;
+
+        const float tolerance = 1e-4f;
+        const Aabb moved = { a.x + contact.mtvX, a.y + contact.mtvY, a.width, a.height };
+        Contact after;
+        mismatches += computeContact(moved, b, after) && after.depth > tolerance;
+
+        SimplexCache cache = {};
+        Contact expected;
+        collideConvex(boxShape(a.width, a.height), a.x, a.y, boxShape(b.width, b.height), b.x, b.y, cache, expected);
+        mismatches += std::abs(expected.depth - contact.depth) > 1e-3f;
+    }
+    return report("computeContact depth vs push-out and EPA", checked, mismatches);
+}
+
+// Distance from a point to the segment from (x1, y1) to (x2, y2)
+float pointSegmentDistance(float px, float py, float x1, float y1, float x2, float y2) {
+    const float dx = x2 - x1;
+    const float dy = y2 - y1;
+    const float lengthSquared = dx * dx + dy * dy;
+    const float t = lengthSquared > 0.0f ? std::min(std::max(((px - x1) * dx + (py - y1) * dy) / lengthSquared, 0.0f), 1.0f) : 0.0f;
+    return std::hypot(px - (x1 + dx * t), py - (y1 + dy * t));
+}
+
+// Distance from the segment to the box; zero when the segment reaches into it
+float segmentBoxDistance(float x1, float y1, float x2, float y2, const Aabb& box) {
+    // Clip the segment against the box's slabs
+    float enter = 0.0f;
+    float leave = 1.0f;
+    const float start[2] = { x1, y1 };
+    const float move[2] = { x2 - x1, y2 - y1 };
+    const float low[2] = { box.x, box.y };
+    const float high[2] = { box.x + box.width, box.y + box.height };
+    for (int axis = 0; axis < 2; axis++) {
+        if (move[axis] == 0.0f) {
+            if (start[axis] < low[axis] || start[axis] > high[axis]) {
+                leave = -1.0f;
+            }
+            continue;
+        }
+        const float t1 = (low[axis] - start[axis]) / move[axis];
+        const float t2 = (high[axis] - start[axis]) / move[axis];
+        enter = std::max(enter, std::min(t1, t2));
+        leave = std::min(leave, std::max(t1, t2));
+    }
+    if (enter <= leave) {
+        return 0.0f;
+    }
+    // Apart, so the nearest points are an end of the segment or a corner of the box
+    float nearest = std::numeric_limits<float>::infinity();
+    const float ends[2][2] = { { x1, y1 }, { x2, y2 } };
+    for (int e = 0; e < 2; e++) {
+        const float dx = std::max(std::max(box.x - ends[e][0], ends[e][0] - high[0]), 0.0f);
+        const float dy = std::max(std::max(box.y - ends[e][1], ends[e][1] - high[1]), 0.0f);
+        nearest = std::min(nearest, std::hypot(dx, dy));
+    }
+    const float corners[4][2] = { { low[0], low[1] }, { high[0], low[1] }, { low[0], high[1] }, { high[0], high[1] } };
+    for (int c = 0; c < 4; c++) {
+        nearest = std::min(nearest, pointSegmentDistance(corners[c][0], corners[c][1], x1, y1, x2, y2));
+    }
+    return nearest;
+}
+
+// GJK and collideConvex against the closed forms for circle-circle and capsule-box: the core
+// distance, whether the shapes touch, the depth and (for circles) the normal. Capsules dipping
+// into a wide box check the EPA depth. Then pairs drifting over several steps are queried with
+// their cached simplex and cold: the answers must agree, and the warm queries take fewer GJK
+// iterations in total and never more for any one query.
+bool checkGjk() {
+    XorShift rng(0x6A09E667F3BCC909ull);
+    const float tolerance = 1e-4f;
+    size_t checked = 0;
+    size_t mismatches = 0;
+
+    for (int i = 0; i < 5000; i++) {
+        const float centerAX = rng.range(-2.0f, 2.0f);
+        const float centerAY = rng.range(-2.0f, 2.0f);
+        const float centerBX = rng.range(-2.0f, 2.0f);
+        const float centerBY = rng.range(-2.0f, 2.0f);
+        const ConvexShape circleA = makeCircleShape(0.0f, 0.0f, rng.range(0.1f, 1.0f));
+        const ConvexShape circleB = makeCircleShape(0.0f, 0.0f, rng.range(0.1f, 1.0f));
+        const float distance = std::hypot(centerAX - centerBX, centerAY - centerBY);
+        const float radii = circleA.radius + circleB.radius;
+
+        SimplexCache cache = {};
+        GjkOutput output;
+        gjkDistance(circleA, centerAX, centerAY, circleB, centerBX, centerBY, cache, output);
+        mismatches += std::abs(output.distance - distance) > tolerance;
+
+        cache = SimplexCache();
+        Contact contact;
+        const bool hit = collideConvex(circleA, centerAX, centerAY, circleB, centerBX, centerBY, cache, contact);
+        if (std::abs(distance - radii) > tolerance) {
+            mismatches += hit != (distance < radii);
+        }
+        if (hit && distance < radii && distance > tolerance) {
+            mismatches += std::abs(contact.depth - (radii - distance)) > tolerance;
+            mismatches += std::abs(contact.normalX - (centerAX - centerBX) / distance) > tolerance;
+            mismatches += std::abs(contact.normalY - (centerAY - centerBY) / distance) > tolerance;
+        }
+        checked++;
+    }
+
+    for (int i = 0; i < 5000; i++) {
+        const Aabb box = { rng.range(-1.0f, 1.0f), rng.range(-1.0f, 1.0f), rng.range(0.1f, 2.0f), rng.range(0.1f, 2.0f) };
+        const float x1 = rng.range(-3.0f, 3.0f);
+        const float y1 = rng.range(-3.0f, 3.0f);
+        const float x2 = i % 4 == 0 ? x1 : rng.range(-3.0f, 3.0f);
+        const float y2 = rng.range(-3.0f, 3.0f);
+        const ConvexShape capsule = makeCapsuleShape(x1, y1, x2, y2, rng.range(0.05f, 0.5f));
+        const ConvexShape boxHull = boxShape(box.width, box.height);
+        const float distance = segmentBoxDistance(x1, y1, x2, y2, box);
+
+        SimplexCache cache = {};
+        GjkOutput output;
+        gjkDistance(capsule, 0.0f, 0.0f, boxHull, box.x, box.y, cache, output);
+        mismatches += std::abs(output.distance - distance) > tolerance;
+
+        cache = SimplexCache();
+        Contact contact;
+        const bool hit = collideConvex(capsule, 0.0f, 0.0f, boxHull, box.x, box.y, cache, contact);
+        if (std::abs(distance - capsule.radius) > tolerance) {
+            mismatches += hit != (distance < capsule.radius);
+        }
+        if (hit && distance > tolerance) {
+            mismatches += std::abs(contact.depth - (capsule.radius - distance)) > tolerance;
+        }
+        checked++;
+    }
+
+    // Level capsules sunk just below the top of a wide box: pushing them up is the shortest way out
+    for (int i = 0; i < 1000; i++) {
+        const float y = rng.range(1.7f, 1.95f);
+        const float radius = rng.range(0.05f, 0.2f);
+        const ConvexShape capsule = makeCapsuleShape(rng.range(0.5f, 1.5f), y, rng.range(2.5f, 3.5f), y, radius);
+        SimplexCache cache = {};
+        Contact contact;
+        const bool hit = collideConvex(capsule, 0.0f, 0.0f, boxShape(4.0f, 2.0f), 0.0f, 0.0f, cache, contact);
+        mismatches += !hit || std::abs(contact.depth - (2.0f - y + radius)) > tolerance
+            || std::abs(contact.normalX) > tolerance || std::abs(contact.normalY - 1.0f) > tolerance;
+        checked++;
+    }
+
+    // The same pairs drifting a little each step, as persistent contacts do
+    int warmIterations = 0;
+    int coldIterations = 0;
+    for (int i = 0; i < 500; i++) {
+        const ConvexShape shapeA = i % 2 == 0 ? boxShape(rng.range(0.2f, 1.0f), rng.range(0.2f, 1.0f))
+            : makeCapsuleShape(0.0f, 0.0f, rng.range(0.2f, 1.0f), rng.range(0.2f, 1.0f), 0.1f);
+        const ConvexShape shapeB = boxShape(rng.range(0.2f, 1.0f), rng.range(0.2f, 1.0f));
+        float x = rng.range(-1.5f, 1.5f);
+        float y = rng.range(-1.5f, 1.5f);
+        SimplexCache warm = {};
+        for (int step = 0; step < 10; step++) {
+            x += rng.range(-0.01f, 0.01f);
+            y += rng.range(-0.01f, 0.01f);
+            SimplexCache cold = {};
+            GjkOutput warmOutput;
+            GjkOutput coldOutput;
+            gjkDistance(shapeA, x, y, shapeB, 0.0f, 0.0f, warm, warmOutput);
+            gjkDistance(shapeA, x, y, shapeB, 0.0f, 0.0f, cold, coldOutput);
+            mismatches += std::abs(warmOutput.distance - coldOutput.distance) > tolerance;
+            if (step > 0) {
+                mismatches += warmOutput.iterations > coldOutput.iterations;
+                warmIterations += warmOutput.iterations;
+                coldIterations += coldOutput.iterations;
+            }
+            checked++;
+        }
+    }
+    mismatches += warmIterations >= coldIterations;
+    return report("GJK vs circle and capsule-box closed forms, warm vs cold", checked, mismatches);
+}
+
+// A plank 0.02 thick falling onto the 0.25 square from 0.01 above it, through the square within
+// one step: at 0.1 units per step while the square rises 0.2, and at 0.3 units per step onto the
+// square at rest. The discrete test sees no overlap at either end of the step; the resolver has to
+// stop the plank on the square's top face where they meet.
+bool checkFastBodies() {
+    const float speeds[][2] = { { -0.1f, 0.2f }, { -0.3f, 0.0f } };
+    size_t checked = 0;
+    size_t mismatches = 0;
+    for (int c = 0; c < 2; c++) {
+        Simulation simulation;
+        const uint32_t plankShape = simulation.addShape(boxShape(0.25f, 0.02f));
+        // Well clear of the player and the scene's own square
+        const float top = 2.0f;
+        const BodyHandle square = simulation.addBody(1, 10.0f, top - 0.25f, BodySquare);
+        const BodyHandle plank = simulation.addBody(plankShape, 10.0f, top + 0.01f);
+        simulation.setVelocity(plank, 0.0f, speeds[c][0] / simulationStep);
+        simulation.setVelocity(square, 0.0f, speeds[c][1] / simulationStep);
+
+        const BodyStore& bodies = simulation.getBodies();
+        const size_t p = bodies.indexOf(plank);
+        const size_t s = bodies.indexOf(square);
+        const Aabb plankStart = { bodies.x[p], bodies.y[p], bodies.width[p], bodies.height[p] };
+        const Aabb squareStart = { bodies.x[s], bodies.y[s], bodies.width[s], bodies.height[s] };
+        const Aabb plankEnd = { plankStart.x, plankStart.y + speeds[c][0], plankStart.width, plankStart.height };
+        const Aabb squareEnd = { squareStart.x, squareStart.y + speeds[c][1], squareStart.width, squareStart.height };
+        mismatches += checkCollision(plankStart, squareStart) || checkCollision(plankEnd, squareEnd);
+
+        InputState input = {};
+        simulation.step(input);
+        const float meetTime = 0.01f / (speeds[c][1] - speeds[c][0]);
+        const float meetHeight = top + speeds[c][1] * meetTime;
+        const size_t plankIndex = bodies.indexOf(plank);
+        const size_t squareIndex = bodies.indexOf(square);
+        const float squareTop = bodies.y[squareIndex] + bodies.height[squareIndex];
+        mismatches += std::fabs(bodies.y[plankIndex] - meetHeight) > 1e-4f;
+        mismatches += std::fabs(bodies.y[plankIndex] - squareTop) > 1e-5f;
+        mismatches += bodies.velocityY[plankIndex] != 0.0f;
+        checked += 4;
+    }
+    return report("fast bodies stop on contact", checked, mismatches);
+}
+
+// The same random pile of squares stepped twice, once with random layer masks and once with
+// every mask open, threaded and not. Per layer pair, the filtered run's dropped and candidate pairs
+// add up to the open run's candidates; a pair of layers that can't collide hands the narrowphase
+// no candidates at all and one that can drops none. The filtered run's colliding pairs are exactly
+// the open run's that pass the masks.
+bool checkCollisionFilters() {
+    const int layers = 5;
+    JobSystem jobs(4);
+    XorShift rng(0xBF58476D1CE4E5B9ull);
+    size_t checked = 0;
+    size_t mismatches = 0;
+    for (int round = 0; round < 4; round++) {
+        // Layer 0 is the default the player and the scene's square sit in; the pile uses 1 and up
+        uint32_t masks[layers] = { allCollisionLayers };
+        for (int layer = 1; layer < layers; layer++) {
+            masks[layer] = static_cast<uint32_t>(rng.next());
+        }
+        Simulation filteredRun;
+        Simulation openRun;
+        if (round & 1) {
+            filteredRun.setJobSystem(&jobs);
+            openRun.setJobSystem(&jobs);
+        }
+        for (int i = 0; i < 3000; i++) {
+            const float x = rng.range(20.0f, 40.0f);
+            const float y = rng.range(20.0f, 40.0f);
+            const int layer = 1 + static_cast<int>(rng.next() % (layers - 1));
+            filteredRun.setCollisionFilter(filteredRun.addBody(1, x, y, BodySquare), 1u << layer, masks[layer]);
+            openRun.setCollisionFilter(openRun.addBody(1, x, y, BodySquare), 1u << layer, allCollisionLayers);
+        }
+        filteredRun.setLayerStatsEnabled(true);
+        openRun.setLayerStatsEnabled(true);
+        InputState input = {};
+        for (int s = 0; s < 3; s++) {
+            filteredRun.step(input);
+            openRun.step(input);
+
+            const BodyStore& bodies = filteredRun.getBodies();
+            std::set<std::pair<uint32_t, uint32_t>> expected;
+            const ArenaVector<CollisionPair>& openPairs = openRun.getCollidingPairs();
+            for (size_t i = 0; i < openPairs.size(); i++) {
+                const uint32_t a = openPairs[i].a;
+                const uint32_t b = openPairs[i].b;
+                if (layersCollide(bodies.category[a], bodies.mask[a], bodies.category[b], bodies.mask[b])) {
+                    expected.insert(std::make_pair(std::min(a, b), std::max(a, b)));
+                }
+            }
+            std::set<std::pair<uint32_t, uint32_t>> found;
+            const ArenaVector<CollisionPair>& pairs = filteredRun.getCollidingPairs();
+            for (size_t i = 0; i < pairs.size(); i++) {
+                found.insert(std::make_pair(std::min(pairs[i].a, pairs[i].b), std::max(pairs[i].a, pairs[i].b)));
+            }
+            mismatches += found != expected || found.size() != pairs.size();
+            checked += pairs.size() + 1;
+        }
+
+        for (int a = 0; a < layers; a++) {
+            for (int b = a; b < layers; b++) {
+                const LayerPairStats& filtered = filteredRun.getLayerPairStats(a, b);
+                const LayerPairStats& open = openRun.getLayerPairStats(a, b);
+                mismatches += filtered.filtered + filtered.candidates != open.candidates;
+                mismatches += open.filtered != 0;
+                if (layersCollide(1u << a, masks[a], 1u << b, masks[b])) {
+                    mismatches += filtered.filtered != 0 || filtered.colliding != open.colliding;
+                }
+                else {
+                    mismatches += filtered.candidates != 0 || filtered.colliding != 0;
+                }
+                checked += 3;
+            }
+        }
+    }
+    return report("layer filters vs unfiltered broadphase", checked, mismatches);
+}
+
+// Events naming the pair (a, b), handles in slot order as the simulation reports them
+size_t countContactEvents(const Simulation& simulation, ContactEventType type, BodyHandle a, BodyHandle b) {
+    size_t count = 0;
+    const ContactEvent* events = simulation.getContactEvents(type, count);
+    size_t found = 0;
+    for (size_t i = 0; i < count; i++) {
+        found += events[i].a.slot == a.slot && events[i].a.generation == a.generation
+            && events[i].b.slot == b.slot && events[i].b.generation == b.generation;
+    }
+    return found;
+}
+
+// Steps two squares into contact, holds them there and pulls them apart: the pair begins once,
+// stays once per held step and ends once, in that order. Halfway through the hold a pile of
+// overlapping squares is dropped in, so the pair cache grows and rehashes under the held pair,
+// which must keep reading as a stay. Every step the three runs sit back to back in one buffer,
+// the begins and stays are the colliding pairs and the stays and ends are last step's.
+bool checkContactEvents() {
+    Simulation simulation;
+    // Well clear of the player and the scene's own square; 0.02 apart, closing 0.03 a step
+    BodyHandle first = simulation.addBody(1, 20.0f, 0.0f, BodySquare);
+    BodyHandle second = simulation.addBody(1, 20.27f, 0.0f, BodySquare);
+    if (first.slot > second.slot) {
+        std::swap(first, second);
+    }
+    simulation.setVelocity(second, -0.03f / simulationStep, 0.0f);
+
+    const int holdSteps = 20;
+    const int pileSize = 60;
+    size_t checked = 0;
+    size_t mismatches = 0;
+    size_t previousColliding = 0;
+    std::vector<int> begins;
+    std::vector<int> stays;
+    std::vector<int> ends;
+    InputState input = {};
+    const int stepCount = holdSteps + 6;
+    for (int s = 0; s < stepCount; s++) {
+        if (s == 1) {
+            simulation.setVelocity(second, 0.0f, 0.0f);
+        }
+        if (s == 1 + holdSteps) {
+            simulation.setVelocity(second, 0.1f / simulationStep, 0.0f);
+        }
+        if (s == 2 + holdSteps) {
+            simulation.setVelocity(second, 0.0f, 0.0f);
+        }
+        if (s == 1 + holdSteps / 2) {
+            for (int i = 0; i < pileSize; i++) {
+                simulation.addBody(1, 40.0f + 0.001f * i, 0.0f, BodySquare);
+            }
+        }
+        simulation.step(input);
+
+        size_t counts[contactEventTypeCount];
+        const ContactEvent* runs[contactEventTypeCount];
+        for (int type = 0; type < contactEventTypeCount; type++) {
+            runs[type] = simulation.getContactEvents(static_cast<ContactEventType>(type), counts[type]);
+        }
+        const size_t colliding = simulation.getCollidingPairs().size();
+        mismatches += runs[ContactBegin] + counts[ContactBegin] != runs[ContactStay];
+        mismatches += runs[ContactStay] + counts[ContactStay] != runs[ContactEnd];
+        mismatches += counts[ContactBegin] + counts[ContactStay] != colliding;
+        mismatches += counts[ContactStay] + counts[ContactEnd] != previousColliding;
+        // The whole pile begins together the step it lands and stays together the next
+        if (s == 1 + holdSteps / 2) {
+            mismatches += counts[ContactBegin] < static_cast<size_t>(pileSize * (pileSize - 1) / 2);
+        }
+        if (s == 2 + holdSteps / 2) {
+            mismatches += counts[ContactBegin] != 0;
+        }
+        previousColliding = colliding;
+        checked += 6;
+
+        for (size_t n = countContactEvents(simulation, ContactBegin, first, second); n > 0; n--) {
+            begins.push_back(s);
+        }
+        for (size_t n = countContactEvents(simulation, ContactStay, first, second); n > 0; n--) {
+            stays.push_back(s);
+        }
+        for (size_t n = countContactEvents(simulation, ContactEnd, first, second); n > 0; n--) {
+            ends.push_back(s);
+        }
+    }
+
+    mismatches += begins.size() != 1 || begins[0] != 0;
+    mismatches += stays.size() != static_cast<size_t>(holdSteps);
+    for (size_t i = 0; i < stays.size(); i++) {
+        mismatches += stays[i] != static_cast<int>(i) + 1;
+    }
+    mismatches += ends.size() != 1 || ends[0] != 1 + holdSteps;
+    checked += 3 + stays.size();
+    return report("contact events begin, stay and end once", checked, mismatches);
+}
+
+// True when the two runs reported the same contact events of `type`, in the same order
+bool sameContactEvents(const Simulation& first, const Simulation& second, ContactEventType type) {
+    size_t firstCount = 0;
+    size_t secondCount = 0;
+    const ContactEvent* firstEvents = first.getContactEvents(type, firstCount);
+    const ContactEvent* secondEvents = second.getContactEvents(type, secondCount);
+    if (firstCount != secondCount) {
+        return false;
+    }
+    for (size_t i = 0; i < firstCount; i++) {
+        if (firstEvents[i].a.slot != secondEvents[i].a.slot || firstEvents[i].a.generation != secondEvents[i].a.generation
+            || firstEvents[i].b.slot != secondEvents[i].b.slot || firstEvents[i].b.generation != secondEvents[i].b.generation) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The same scene stepped with and without a job system: a pile of squares and circles (so GJK runs
+// in the pair cache shards), boxes larger than a grid cell, fast bodies for the sweeps and dynamic
+// bodies falling onto the pile. Every step both runs report the same colliding pairs and contact
+// events in the same order and agree on the checksum.
+bool checkThreadedSteps() {
+    XorShift rng(0x3C6EF372FE94F82Bull);
+    JobSystem jobs(4);
+    Simulation serialRun;
+    Simulation threadedRun;
+    threadedRun.setJobSystem(&jobs);
+    Simulation* runs[2] = { &serialRun, &threadedRun };
+    const ConvexShape shapes[] = { makeCircleShape(0.2f, 0.2f, 0.2f), boxShape(3.0f, 2.0f) };
+    uint32_t circle = 0;
+    uint32_t large = 0;
+    for (int r = 0; r < 2; r++) {
+        circle = runs[r]->addShape(shapes[0]);
+        large = runs[r]->addShape(shapes[1]);
+    }
+    for (int i = 0; i < 4000; i++) {
+        const int kind = i % 20;
+        const float x = rng.range(20.0f, 45.0f);
+        const float y = rng.range(20.0f, 45.0f);
+        const float speedX = rng.range(-1.0f, 1.0f) / simulationStep;
+        const float speedY = rng.range(-1.0f, 1.0f) / simulationStep;
+        for (int r = 0; r < 2; r++) {
+            if (kind < 15) {
+                runs[r]->addBody(kind < 3 ? circle : 1, x, y, BodySquare);
+            }
+            else if (kind == 15) {
+                runs[r]->addBody(large, x, y, BodySquare);
+            }
+            else if (kind == 16) {
+                runs[r]->setVelocity(runs[r]->addBody(1, x, y, BodySquare), speedX, speedY);
+            }
+            else {
+                runs[r]->setVelocity(runs[r]->addBody(1, x, y, BodySquare | BodyDynamic), 0.0f, -0.05f / simulationStep);
+            }
+        }
+    }
+
+    size_t checked = 0;
+    size_t mismatches = 0;
+    InputState input = {};
+    for (int s = 0; s < 12; s++) {
+        serialRun.step(input);
+        threadedRun.step(input);
+        const ArenaVector<CollisionPair>& serialPairs = serialRun.getCollidingPairs();
+        const ArenaVector<CollisionPair>& threadedPairs = threadedRun.getCollidingPairs();
+        bool samePairs = serialPairs.size() == threadedPairs.size();
+        for (size_t i = 0; samePairs && i < serialPairs.size(); i++) {
+            samePairs = serialPairs[i].a == threadedPairs[i].a && serialPairs[i].b == threadedPairs[i].b;
+        }
+        mismatches += !samePairs;
+        for (int type = 0; type < contactEventTypeCount; type++) {
+            mismatches += !sameContactEvents(serialRun, threadedRun, static_cast<ContactEventType>(type));
+        }
+        mismatches += serialRun.computeChecksum() != threadedRun.computeChecksum();
+        checked += serialPairs.size() + 5;
+    }
+    return report("threaded steps vs serial", checked, mismatches);
+}
+
+// Nearest time at which the ray from (originX, originY) along (directionX, directionY) enters one
+// of the bodies, each grown by (growX, growY) on its low sides; maxTime when it hits none. A cast
+// that doesn't move hits what its origin is in at time 0, and nothing else.
+float bruteForceCast(const BodyStore& bodies, float originX, float originY, float directionX, float directionY,
+    float maxTime, float growX, float growY) {
+    const bool still = rayInverse(directionX) == std::numeric_limits<float>::max()
+        && rayInverse(directionY) == std::numeric_limits<float>::max();
+    float best = maxTime;
+    for (size_t i = 0; i < bodies.size(); i++) {
+        const Aabb target = { bodies.x[i] - growX, bodies.y[i] - growY, bodies.width[i] + growX, bodies.height[i] + growY };
+        SweepHit hit;
+        if (still) {
+            const bool inside = originX >= target.x && originX <= target.x + target.width
+                && originY >= target.y && originY <= target.y + target.height;
+            best = inside && maxTime > 0.0f ? 0.0f : best;
+        }
+        else if (rayCastAabb(target, originX, originY, directionX, directionY, best, hit)) {
+            best = hit.time;
+        }
+    }
+    return best;
+}
+
+// rayCast, boxCast and rayCastBatch against testing every body, for casts that start inside and
+// outside the grid with ordinary, tiny and zero directions, to a finite and an infinite maxTime.
+// Casts that don't move used to walk the grid forever to an infinite maxTime, as did packets with a
+// ray far slower than the rest.
+bool checkCasts() {
+    XorShift rng(0x94D049BB133111EBull);
+    Simulation simulation;
+    for (int i = 0; i < 3000; i++) {
+        simulation.addBody(1, rng.range(-10.0f, 10.0f), rng.range(-10.0f, 10.0f), BodySquare);
+    }
+    InputState input = {};
+    simulation.step(input);
+    // Added after the grid was built, so the casts have to find them without it
+    for (int i = 0; i < 10; i++) {
+        simulation.addBody(1, rng.range(-10.0f, 10.0f), rng.range(-10.0f, 10.0f), BodySquare);
+    }
+    const BodyStore& bodies = simulation.getBodies();
+
+    const float infinity = std::numeric_limits<float>::infinity();
+    const float directions[][2] = { { 0.0f, 0.0f }, { 1e-30f, 0.0f }, { 0.0f, -1e-30f }, { 1e-19f, 1e-19f },
+        { 1.0f, 0.0f }, { 0.0f, 1.0f }, { -0.6f, 0.8f }, { 0.0f, 0.0f } };
+    std::vector<float> originsX;
+    std::vector<float> originsY;
+    std::vector<float> directionsX;
+    std::vector<float> directionsY;
+    size_t checked = 0;
+    size_t mismatches = 0;
+    for (int i = 0; i < 4000; i++) {
+        // Origins well outside the bodies, just outside and among them, some on cell corners
+        const float spread = i % 3 == 0 ? 40.0f : 12.0f;
+        float originX = rng.range(-spread, spread);
+        float originY = rng.range(-spread, spread);
+        if (i % 5 == 0) {
+            originX = std::floor(originX * 2.0f) * 0.5f;
+            originY = std::floor(originY * 2.0f) * 0.5f;
+        }
+        if (i % 50 == 1) {
+            // So far off that a tiny direction's entry time overflows
+            originX = -1e21f;
+            originY = -1e21f;
+        }
+        const float* direction = directions[i % 8];
+        const float directionX = i % 16 < 8 ? direction[0] : rng.range(-1.0f, 1.0f);
+        const float directionY = i % 16 < 8 ? direction[1] : rng.range(-1.0f, 1.0f);
+        const float maxTime = i % 3 == 0 ? 8.0f : infinity;
+
+        CastHit hit;
+        const bool rayHit = simulation.rayCast(originX, originY, directionX, directionY, maxTime, hit);
+        const float rayExpected = bruteForceCast(bodies, originX, originY, directionX, directionY, maxTime, 0.0f, 0.0f);
+        mismatches += rayHit != (rayExpected < maxTime) || (rayHit && hit.time != rayExpected);
+
+        const Aabb box = { originX, originY, 0.3f, 0.2f };
+        const bool boxHit = simulation.boxCast(box, directionX, directionY, maxTime, hit);
+        const float boxExpected = bruteForceCast(bodies, originX, originY, directionX, directionY, maxTime, box.width, box.height);
+        mismatches += boxHit != (boxExpected < maxTime) || (boxHit && hit.time != boxExpected);
+        checked += 2;
+
+        if (maxTime == infinity) {
+            originsX.push_back(originX);
+            originsY.push_back(originY);
+            directionsX.push_back(directionX);
+            directionsY.push_back(directionY);
+        }
+    }
+
+    const RaySoAView rays = { originsX.data(), originsY.data(), directionsX.data(), directionsY.data(), originsX.size() };
+    std::vector<float> times(rays.count);
+    std::vector<BodyHandle> hits(rays.count);
+    simulation.rayCastBatch(rays, infinity, times.data(), hits.data());
+    for (size_t i = 0; i < rays.count; i++) {
+        const float expected = bruteForceCast(bodies, rays.originX[i], rays.originY[i], rays.directionX[i], rays.directionY[i],
+            infinity, 0.0f, 0.0f);
+        mismatches += times[i] != expected || (hits[i].slot == invalidBodyHandle.slot) != (expected == infinity);
+        checked++;
+    }
+    return report("ray and box casts vs brute force", checked, mismatches);
+}
+
+} // namespace
+
+int runSelfTests() {
+    bool passed = true;
+    passed = checkBatchKernels() && passed;
+    passed = checkSpatialHash() && passed;
+    passed = checkSweepAndPrune() && passed;
+    passed = checkDynamicTree() && passed;
+    passed = checkPolygons() && passed;
+    passed = checkContacts() && passed;
+    passed = checkGjk() && passed;
+    passed = checkFastBodies() && passed;
+    passed = checkContactEvents() && passed;
+    passed = checkCollisionFilters() && passed;
+    passed = checkThreadedSteps() && passed;
+    passed = checkCasts() && passed;
+    return passed ? 0 : 1;
+}
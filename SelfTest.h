@@ -0,0 +1,19 @@
+#pragma once
+
+// Checks the collision code against slow reference versions of itself:
+// - the batch kernels against checkCollision, bit for bit
+// - SpatialHashGrid's candidate pairs, threaded and not, against every pair of boxes
+// - SweepAndPrune's pairs and pair events against every pair of boxes
+// - DynamicAabbTree's queries and pair searches against testing every leaf
+// - the SAT test and the simulation on triangle-square pairs whose boxes overlap, touching or not
+// - computeContact's penetration against the push-out distances and EPA
+// - GJK and EPA against circle-circle and capsule-box closed forms, and warm starts against cold
+// - the fast-body resolver against a plank the discrete test lets pass through the square
+// - contact events for a pair stepped into contact, held while the pair cache grows, and pulled apart
+// - layer-filtered broadphase and narrowphase pairs and their per-layer counters against the same
+//   scene unfiltered
+// - a scene stepped with a job system against the same scene stepped without: same colliding
+//   pairs, contact events and checksums
+// - the simulation's ray and box casts against testing every body
+// Prints one line per check and returns 0 when every check passes, 1 otherwise.
+int runSelfTests();
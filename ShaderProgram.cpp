@@ -0,0 +1,127 @@
+#include <GL/glew.h>
+
+#include <cassert>
+#include <iostream>
+
+namespace {
+
+// Captured before ShaderProgram.h reroutes glGetUniformLocation in debug builds, so
+// reflection goes straight to the driver and isn't counted as a stray query
+inline GLint driverGetUniformLocation(GLuint program, const GLchar* name) {
+    return glGetUniformLocation(program, name);
+}
+
+} // namespace
+
+#include "ShaderProgram.h"
+
+// Function to compile shader and check for errors
+GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+        std::cerr << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+    return shader;
+}
+
+// Function to create shader program from vertex and fragment shader source
+GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource) {
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+
+    GLuint shaderProgram = glCreateProgram();
+    glAttachShader(shaderProgram, vertexShader);
+    glAttachShader(shaderProgram, fragmentShader);
+    glLinkProgram(shaderProgram);
+
+    GLint success;
+    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
+        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    return shaderProgram;
+}
+
+ShaderProgram::ShaderProgram(GLuint program) : id(program) {
+    GLint uniformCount = 0;
+    GLint maxNameLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    std::vector<GLchar> nameBuffer(maxNameLength > 0 ? maxNameLength : 1);
+    for (GLint i = 0; i < uniformCount; i++) {
+        GLsizei length = 0;
+        UniformInfo info;
+        glGetActiveUniform(program, static_cast<GLuint>(i), static_cast<GLsizei>(nameBuffer.size()),
+            &length, &info.size, &info.type, nameBuffer.data());
+        info.name.assign(nameBuffer.data(), length);
+        info.location = driverGetUniformLocation(program, info.name.c_str());
+
+        // Arrays are reported as "name[0]"; store the bare name so lookups match the GLSL source
+        const size_t bracket = info.name.find('[');
+        if (bracket != std::string::npos) {
+            info.name.erase(bracket);
+        }
+        uniforms.push_back(info);
+    }
+}
+
+UniformHandle ShaderProgram::getUniform(const char* name) const {
+    for (size_t i = 0; i < uniforms.size(); i++) {
+        if (uniforms[i].name == name) {
+            UniformHandle handle = { uniforms[i].location, uniforms[i].type };
+            return handle;
+        }
+    }
+    UniformHandle missing = { -1, GL_NONE };
+    return missing;
+}
+
+void ShaderProgram::setVec2(UniformHandle handle, const float* value) const {
+    assert(handle.location == -1 || handle.type == GL_FLOAT_VEC2);
+    glUniform2fv(handle.location, 1, value);
+}
+
+void ShaderProgram::setVec4(UniformHandle handle, const float* value) const {
+    assert(handle.location == -1 || handle.type == GL_FLOAT_VEC4);
+    glUniform4fv(handle.location, 1, value);
+}
+
+void ShaderProgram::setMat4(UniformHandle handle, const float* value, bool transpose) const {
+    assert(handle.location == -1 || handle.type == GL_FLOAT_MAT4);
+    glUniformMatrix4fv(handle.location, 1, transpose ? GL_TRUE : GL_FALSE, value);
+}
+
+#ifdef SHADER_QUERY_DEBUG
+namespace {
+
+int strayUniformQueries = 0;
+
+} // namespace
+
+int getStrayUniformQueries() {
+    return strayUniformQueries;
+}
+
+void resetStrayUniformQueries() {
+    strayUniformQueries = 0;
+}
+
+GLint countedGetUniformLocation(GLuint program, const GLchar* name) {
+    strayUniformQueries++;
+    return driverGetUniformLocation(program, name);
+}
+#endif
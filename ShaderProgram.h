@@ -0,0 +1,68 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+// Debug builds count every glGetUniformLocation made outside ShaderProgram's one-time reflection,
+// so a per-frame string lookup sneaking back into the render loop shows up straight away
+#if defined(_DEBUG) && !defined(SHADER_QUERY_DEBUG)
+#define SHADER_QUERY_DEBUG 1
+#endif
+
+// Function to compile shader and check for errors
+GLuint compileShader(GLenum type, const char* source);
+
+// Function to create shader program from vertex and fragment shader source
+GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource);
+
+// Pre-resolved uniform: the location plus the GL type it was declared with
+struct UniformHandle {
+    GLint location;
+    GLenum type;
+};
+
+// One row of the reflected uniform table
+struct UniformInfo {
+    std::string name;
+    GLint location;
+    GLenum type;
+    GLint size;
+};
+
+// Wraps a linked program (e.g. from createShaderProgram) and reflects all of its active uniforms
+// once. Look handles up at setup time and use them for every draw; nothing in the frame needs to
+// go back to the driver by name.
+class ShaderProgram {
+public:
+    ShaderProgram() : id(0) {}
+    explicit ShaderProgram(GLuint program);
+
+    GLuint getId() const { return id; }
+    void use() const { glUseProgram(id); }
+
+    // Returns the handle for `name` (array uniforms may omit the trailing "[0]"),
+    // or location -1 if the program has no such active uniform
+    UniformHandle getUniform(const char* name) const;
+    const std::vector<UniformInfo>& getUniforms() const { return uniforms; }
+
+    // Typed setters; the program must be in use
+    void setVec2(UniformHandle handle, const float* value) const;
+    void setVec4(UniformHandle handle, const float* value) const;
+    void setMat4(UniformHandle handle, const float* value, bool transpose) const;
+
+private:
+    GLuint id;
+    std::vector<UniformInfo> uniforms;
+};
+
+#ifdef SHADER_QUERY_DEBUG
+// Number of stray glGetUniformLocation calls since the last reset
+int getStrayUniformQueries();
+void resetStrayUniformQueries();
+
+GLint countedGetUniformLocation(GLuint program, const GLchar* name);
+#undef glGetUniformLocation
+#define glGetUniformLocation countedGetUniformLocation
+#endif
@@ -0,0 +1,935 @@
+#include "Simulation.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+const float triangleVertices[triangleVertexCount * 3] = {
+    0.0f,  0.25f, 0.0f,  // Top vertex (smaller)
+   -0.25f, -0.25f, 0.0f,  // Bottom-left vertex
+    0.25f, -0.25f, 0.0f   // Bottom-right vertex
+};
+
+// Square vertices
+const float squareVertices[squareVertexCount * 3] = {
+    -0.5f, -0.5f, 0.0f,
+    -0.5f, -0.25f, 0.0f,
+    -0.25f, -0.25f, 0.0f,
+    -0.25f, -0.5f, 0.0f
+};
+
+const uint16_t triangleIndices[triangleIndexCount] = { 0, 1, 2 };
+
+// Two triangles sharing the diagonal from the first corner to the third
+const uint16_t squareIndices[squareIndexCount] = { 0, 1, 2, 0, 2, 3 };
+
+namespace {
+
+// Bodies per job in the per-body passes; a multiple of 8 keeps every chunk on whole AVX lanes
+const size_t bodyGrain = 4096;
+
+// State of a narrowphase pair whose shapes turned out not to touch; the others hold their event type
+const uint8_t notTouching = 0xff;
+
+// A cast whose direction is below rayInverse's cutoff on both axes doesn't move, so it finds only
+// what it starts in, at time 0. Casting to the smallest positive time keeps it to that; otherwise
+// the slab test gives boxes near it huge finite times, which an infinite maxTime would accept.
+float castLimit(float directionX, float directionY, float maxTime) {
+    const float none = std::numeric_limits<float>::max();
+    const bool still = rayInverse(directionX) == none && rayInverse(directionY) == none;
+    return still ? std::min(maxTime, std::numeric_limits<float>::min()) : maxTime;
+}
+
+// Polygon of a box with its min corner at the origin, which is how a body without a shape collides
+ConvexPolygon boxPolygon(float width, float height) {
+    const float corners[8] = { 0.0f, 0.0f, 0.0f, height, width, height, width, 0.0f };
+    return makeConvexPolygon(corners, 4, 2);
+}
+
+} // namespace
+
+// Sets the player's velocity from the keys; the jump is a single upward kick from the ground
+void stepPlayer(const InputState& input, bool grounded, float& velocityX, float& velocityY) {
+    // Control triangle movement
+    velocityX = 0.0f;
+    if (input.left)
+        velocityX -= moveSpeed;
+    if (input.right)
+        velocityX += moveSpeed;
+
+    // Jump when space is pressed while standing on something; holding it jumps again on landing
+    if (input.jump && grounded) {
+        velocityY = jumpSpeed;
+    }
+}
+
+// Runs function(begin, end) over [0, count) in chunks of `grain` across the job system's threads,
+// or over the whole range on this thread without one
+template <typename Function>
+void Simulation::forEachRange(size_t count, size_t grain, Function function) const {
+    if (jobs) {
+        jobs->parallelFor(count, grain, [&function](size_t, size_t begin, size_t end, unsigned) {
+            function(begin, end);
+        });
+    }
+    else if (count) {
+        function(0, count);
+    }
+}
+
+// Writes the indices i in [0, count) that keep(i) accepts to `out`, in order. With a job system
+// every chunk of `grain` counts its own first, then writes them at its offset; keep must be thread
+// safe and give the same answer both times.
+template <typename Keep>
+void Simulation::collectIndices(size_t count, size_t grain, Keep keep, ArenaVector<uint32_t>& out) {
+    if (!jobs) {
+        for (size_t i = 0; i < count; i++) {
+            if (keep(i)) {
+                out.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        return;
+    }
+    collectCounts.assign(JobSystem::chunkCount(count, grain) + 1, 0);
+    jobs->parallelFor(count, grain, [this, &keep](size_t chunk, size_t begin, size_t end, unsigned) {
+        size_t kept = 0;
+        for (size_t i = begin; i < end; i++) {
+            kept += keep(i) ? 1 : 0;
+        }
+        collectCounts[chunk + 1] = kept;
+    });
+    for (size_t chunk = 1; chunk < collectCounts.size(); chunk++) {
+        collectCounts[chunk] += collectCounts[chunk - 1];
+    }
+    out.resize(collectCounts.back());
+    if (out.empty()) {
+        return;
+    }
+    jobs->parallelFor(count, grain, [this, &keep, &out](size_t chunk, size_t begin, size_t end, unsigned) {
+        size_t next = collectCounts[chunk];
+        for (size_t i = begin; next < collectCounts[chunk + 1] && i < end; i++) {
+            if (keep(i)) {
+                out[next++] = static_cast<uint32_t>(i);
+            }
+        }
+    });
+}
+
+Simulation::Simulation()
+    : broadphase(0.5f), jobs(nullptr), binnedBodyCount(0), lastCandidateCount(0),
+      layerStatsEnabled(false), layerPairStats(collisionLayerCount * collisionLayerCount), stepCount(0) {
+    shapes.push_back(makeConvexPolygon(triangleVertices, triangleVertexCount, 3));
+    shapes.push_back(makeConvexPolygon(squareVertices, squareVertexCount, 3));
+    convexShapes.push_back(makeHullShape(shapes[0]));
+    convexShapes.push_back(makeHullShape(shapes[1]));
+    const ConvexPolygon& triangleShape = shapes[0];
+    const ConvexPolygon& squareShape = shapes[1];
+
+    // Initial object positions. Bodies are stored by their box's min corner, so each mesh origin
+    // is placed at its translation and the box starts at the mesh's lower-left extent.
+    const float triangleTranslationX = -1.0f;
+    const float triangleTranslationY = -0.75f;  // Align triangle with square
+    const float squareTranslationX = 0.0f;
+    const float squareTranslationY = -0.5f;  // Square aligned to same horizontal axis
+    player = bodies.create(triangleTranslationX - triangleShape.meshOffsetX, triangleTranslationY - triangleShape.meshOffsetY,
+        triangleShape.width, triangleShape.height, BodyDynamic, 0);
+    square = bodies.create(squareTranslationX - squareShape.meshOffsetX, squareTranslationY - squareShape.meshOffsetY,
+        squareShape.width, squareShape.height, BodySquare, 1);
+    bodies.accelerationY[bodies.indexOf(player)] = -gravity;
+
+    resetScratch();
+    resolveFloor();
+    updateCollisions();
+}
+
+void Simulation::step(const InputState& input) {
+    PROFILE_ZONE("step");
+    resetScratch();
+    forEachRange(bodies.size(), bodyGrain, [this](size_t begin, size_t end) {
+        bodies.savePreviousPositions(begin, end);
+    });
+
+    {
+        PROFILE_ZONE("stepPlayer");
+        const size_t playerIndex = bodies.indexOf(player);
+        stepPlayer(input, (bodies.flags[playerIndex] & BodyGrounded) != 0,
+            bodies.velocityX[playerIndex], bodies.velocityY[playerIndex]);
+    }
+    {
+        PROFILE_ZONE("integrate");
+        forEachRange(bodies.size(), bodyGrain, [this](size_t begin, size_t end) {
+            bodies.integrate(simulationStep, begin, end);
+        });
+        resolveFloor();
+        resolveFastBodies();
+    }
+
+    updateCollisions();
+    landOnContacts();
+    stepCount++;
+}
+
+// Releases last step's scratch arrays in one go. They are emptied first, while their memory is
+// still theirs (nested arrays read their own headers on the way out), then the arena is reset. It
+// sizes itself to the busiest step so far, so a steady scene stops allocating after a few steps.
+void Simulation::resetScratch() {
+    broadphase.releaseScratch();
+    resetArenaVector(candidatePairs, arena);
+    resetArenaVector(collidingPairs, arena);
+    resetArenaVector(fastBodies, arena);
+    resetArenaVector(fastEndsX, arena);
+    resetArenaVector(fastEndsY, arena);
+    resetArenaVector(fastStopsX, arena);
+    resetArenaVector(fastStopsY, arena);
+    resetArenaVector(landingPairs, arena);
+    resetArenaVector(contactEvents, arena);
+    resetArenaVector(shardEnds, arena);
+    resetArenaVector(landedBodies, arena);
+    resetArenaVector(narrowphaseChunks, arena);
+    arena.reset();
+}
+
+// Stops dynamic bodies that fell through the floor on it. Clears every body's grounded flag on the
+// way; standing on the floor sets it again here, standing on a body in landOnContacts.
+void Simulation::resolveFloor() {
+    forEachRange(bodies.size(), bodyGrain, [this](size_t begin, size_t end) {
+        uint32_t* flags = bodies.flags.data();
+        float* y = bodies.y.data();
+        float* velocityY = bodies.velocityY.data();
+        for (size_t i = begin; i < end; i++) {
+            flags[i] &= ~static_cast<uint32_t>(BodyGrounded);
+            if ((flags[i] & BodyDynamic) && y[i] <= floorHeight) {
+                y[i] = floorHeight;
+                velocityY[i] = std::max(velocityY[i], 0.0f);
+                flags[i] |= BodyGrounded;
+            }
+        }
+    });
+}
+
+// Sub-stepped resolver for tunnelling. Slow bodies cost one pass over the arrays and are left to
+// the discrete test. Each fast body is swept from its previous position against every other body
+// moving from its own previous position; at the first contact it stops, drops the part of its
+// motion and velocity heading into the surface, and sweeps the rest of the step from there. Slow
+// bodies move no more than the threshold, so the grid finds every one the sweep could reach within
+// that margin of the swept box. Fast ones are few and are all tried, on the paths they had before
+// any of them was stopped, so two fast bodies that meet both stop where they met.
+void Simulation::resolveFastBodies() {
+    const size_t count = bodies.size();
+    if (count < 2) {
+        return;
+    }
+
+    const float threshold = sweepThreshold * bodies.getMinExtent();
+    auto isFast = [this, threshold](size_t i) {
+        const float moveX = bodies.x[i] - bodies.previousX[i];
+        const float moveY = bodies.y[i] - bodies.previousY[i];
+        return std::fabs(moveX) > threshold || std::fabs(moveY) > threshold;
+    };
+    collectIndices(count, bodyGrain, isFast, fastBodies);
+    if (fastBodies.empty()) {
+        return;
+    }
+    const size_t fastCount = fastBodies.size();
+    fastEndsX.resize(fastCount);
+    fastEndsY.resize(fastCount);
+    fastStopsX.resize(fastCount);
+    fastStopsY.resize(fastCount);
+    for (size_t f = 0; f < fastCount; f++) {
+        fastEndsX[f] = bodies.x[fastBodies[f]];
+        fastEndsY[f] = bodies.y[fastBodies[f]];
+    }
+
+    // Binned at the end-of-step positions; updateCollisions bins again once the sweeps are done.
+    // The sweeps only read the positions, each writes where its body stopped to the side, and the
+    // stops are applied once every sweep is done, so they can run side by side.
+    buildBroadphase();
+    forEachRange(fastCount, 16, [this, threshold](size_t begin, size_t end) {
+        ArenaVector<uint32_t> sweepCandidates{ ArenaAllocator<uint32_t>(&arena) };
+        for (size_t f = begin; f < end; f++) {
+            sweepFastBody(f, threshold, sweepCandidates);
+        }
+    });
+    for (size_t f = 0; f < fastCount; f++) {
+        bodies.x[fastBodies[f]] = fastStopsX[f];
+        bodies.y[fastBodies[f]] = fastStopsY[f];
+    }
+}
+
+// Sweeps fast body f from its previous position to its first contact and on along the surface,
+// writing where it stopped to fastStopsX/Y and zeroing its velocity into the surfaces it hit
+void Simulation::sweepFastBody(size_t f, float threshold, ArenaVector<uint32_t>& sweepCandidates) {
+    const uint32_t body = fastBodies[f];
+    float startX = bodies.previousX[body];
+    float startY = bodies.previousY[body];
+    float moveX = fastEndsX[f] - startX;
+    float moveY = fastEndsY[f] - startY;
+    // Fraction of the step already swept, where every other body is on its way
+    float elapsed = 0.0f;
+
+    for (int iteration = 0; iteration < maxSweepIterations && (moveX != 0.0f || moveY != 0.0f); iteration++) {
+        const Aabb moving = { startX, startY, bodies.width[body], bodies.height[body] };
+        const Aabb reach = { std::min(startX, startX + moveX) - threshold, std::min(startY, startY + moveY) - threshold,
+            moving.width + std::fabs(moveX) + threshold * 2.0f, moving.height + std::fabs(moveY) + threshold * 2.0f };
+        const float remaining = 1.0f - elapsed;
+
+        // Earliest contact the body is moving into; contacts it slides along or leaves don't stop it
+        SweepHit first = { 2.0f, 0.0f, 0.0f };
+        auto sweepOther = [&](uint32_t other, float endX, float endY) {
+            const float otherMoveX = endX - bodies.previousX[other];
+            const float otherMoveY = endY - bodies.previousY[other];
+            const Aabb obstacle = { bodies.previousX[other] + otherMoveX * elapsed, bodies.previousY[other] + otherMoveY * elapsed,
+                bodies.width[other], bodies.height[other] };
+            const float stepMoveX = otherMoveX * remaining;
+            const float stepMoveY = otherMoveY * remaining;
+            SweepHit hit;
+            // The same layer filter the broadphase applies, so the sweep never stops a body on
+            // something it would otherwise pass through
+            if (other != body && layersCollide(bodies.category[body], bodies.mask[body], bodies.category[other], bodies.mask[other])
+                && sweepAabb(moving, moveX, moveY, obstacle, stepMoveX, stepMoveY, hit)
+                && (moveX - stepMoveX) * hit.normalX + (moveY - stepMoveY) * hit.normalY < 0.0f && hit.time < first.time) {
+                first = hit;
+            }
+        };
+
+        sweepCandidates.clear();
+        broadphase.query(reach, [this, threshold, &reach, &sweepCandidates](uint32_t other) {
+            const float otherMoveX = bodies.x[other] - bodies.previousX[other];
+            const float otherMoveY = bodies.y[other] - bodies.previousY[other];
+            if (!(std::fabs(otherMoveX) > threshold || std::fabs(otherMoveY) > threshold)
+                && checkCollision(reach, Aabb{ bodies.x[other], bodies.y[other], bodies.width[other], bodies.height[other] })) {
+                sweepCandidates.push_back(other);
+            }
+        });
+        for (size_t c = 0; c < sweepCandidates.size(); c++) {
+            const uint32_t other = sweepCandidates[c];
+            sweepOther(other, bodies.x[other], bodies.y[other]);
+        }
+        for (size_t o = 0; o < fastBodies.size(); o++) {
+            sweepOther(fastBodies[o], fastEndsX[o], fastEndsY[o]);
+        }
+        if (first.time > 1.0f) {
+            startX += moveX;
+            startY += moveY;
+            break;
+        }
+
+        // Advance to the contact and keep only the motion along the surface
+        startX += moveX * first.time;
+        startY += moveY * first.time;
+        elapsed += remaining * first.time;
+        moveX = first.normalX != 0.0f ? 0.0f : moveX * (1.0f - first.time);
+        moveY = first.normalY != 0.0f ? 0.0f : moveY * (1.0f - first.time);
+        if (first.normalX != 0.0f) {
+            bodies.velocityX[body] = 0.0f;
+        }
+        if (first.normalY != 0.0f) {
+            bodies.velocityY[body] = 0.0f;
+        }
+    }
+
+    fastStopsX[f] = startX;
+    fastStopsY[f] = startY;
+}
+
+void Simulation::buildBroadphase() {
+    if (jobs) {
+        broadphase.build(*jobs, bodies.view(), bodies.category.data(), bodies.mask.data(), arena);
+    }
+    else {
+        broadphase.build(bodies.view(), bodies.category.data(), bodies.mask.data(), arena);
+    }
+}
+
+void Simulation::updateCollisions() {
+    // Bin the bodies and only pass the broadphase candidates to checkCollision
+    {
+        PROFILE_ZONE("broadphase");
+        buildBroadphase();
+        binnedBodyCount = bodies.size();
+        candidatePairs.reserve(lastCandidateCount + lastCandidateCount / 8);
+        if (jobs) {
+            broadphase.findCandidatePairs(*jobs, candidatePairs);
+        }
+        else {
+            broadphase.findCandidatePairs(candidatePairs);
+        }
+    }
+
+    // Box test and SAT only read the bodies and shapes, so with a job system they run on the
+    // workers, one chunk of candidates each, which also sorts its pairs by pair cache shard. Each
+    // shard then takes its pairs from every chunk in chunk order and runs GJK and the touch stamps
+    // on them, on a thread of its own; a pair's simplex and stamps only ever live in its shard.
+    // Last, the chunks write their colliding pairs and begin and stay events at offsets from a
+    // prefix sum. The result is the same however many threads ran: same pairs, same events, in
+    // the same order, and the same cache.
+    {
+        PROFILE_ZONE("narrowphase");
+        const size_t grain = 1024;
+        const size_t chunks = jobs ? JobSystem::chunkCount(candidatePairs.size(), grain) : 1;
+        lastCandidateCount = candidatePairs.size();
+        pairCache.beginStep();
+        narrowphaseChunks.resize(chunks, NarrowphaseChunk(&arena));
+        shardEnds.resize(pairCacheShardCount, ArenaVector<ContactEvent>(ArenaAllocator<ContactEvent>(&arena)));
+        if (lastChunkCounts.size() < chunks) {
+            lastChunkCounts.resize(chunks, 0);
+        }
+        forEachRange(chunks, 1, [this, grain](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; c++) {
+                // Each chunk keeps about as many pairs as it did last step
+                NarrowphaseChunk& chunk = narrowphaseChunks[c];
+                chunk.reserve(lastChunkCounts[c] + lastChunkCounts[c] / 8);
+                const size_t first = jobs ? c * grain : 0;
+                const size_t last = jobs ? std::min(candidatePairs.size(), first + grain) : candidatePairs.size();
+                filterCandidates(first, last, chunk);
+                mapHandles(chunk);
+                if (jobs) {
+                    groupByShard(chunk);
+                }
+                lastChunkCounts[c] = chunk.pairs.size();
+            }
+        });
+        if (jobs) {
+            jobs->parallelFor(pairCacheShardCount, 1, [this](size_t shard, size_t, size_t, unsigned) {
+                touchShard(shard);
+            });
+        }
+        else {
+            // One thread, so the shards needn't be split up: walking the pairs in order keeps each
+            // shard's pairs in the same order as touchShard would, so it comes to the same states
+            if (!narrowphaseChunks.empty()) {
+                touchInOrder(narrowphaseChunks[0]);
+            }
+            for (size_t shard = 0; shard < pairCacheShardCount; shard++) {
+                pairCache.getShard(shard).appendEnded(shardEnds[shard]);
+            }
+        }
+        gatherContacts();
+    }
+    if (layerStatsEnabled) {
+        countLayerPairs();
+    }
+}
+
+// Notes the handles of the chunk's pairs, in slot order as contact events name them, and the pair
+// cache shard of each in `states` until the shards write over it. Thread safe.
+void Simulation::mapHandles(NarrowphaseChunk& chunk) const {
+    const size_t count = chunk.pairs.size();
+    chunk.events.resize(count);
+    chunk.states.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        BodyHandle a = bodies.handleAt(chunk.pairs[i].a);
+        BodyHandle b = bodies.handleAt(chunk.pairs[i].b);
+        if (a.slot > b.slot) {
+            std::swap(a, b);
+        }
+        const ContactEvent event = { a, b };
+        chunk.events[i] = event;
+        chunk.states[i] = static_cast<uint8_t>(PairCache::shardOf(a, b));
+    }
+}
+
+// Sorts the chunk's pairs by pair cache shard into `shardOrder`, keeping their order within each
+// shard. Thread safe.
+void Simulation::groupByShard(NarrowphaseChunk& chunk) const {
+    const size_t count = chunk.pairs.size();
+    chunk.shardOrder.resize(count);
+    std::fill(chunk.shardStarts, chunk.shardStarts + pairCacheShardCount + 1, 0);
+    for (size_t i = 0; i < count; i++) {
+        chunk.shardStarts[chunk.states[i] + 1]++;
+    }
+    for (size_t shard = 0; shard < pairCacheShardCount; shard++) {
+        chunk.shardStarts[shard + 1] += chunk.shardStarts[shard];
+    }
+    size_t next[pairCacheShardCount];
+    std::copy(chunk.shardStarts, chunk.shardStarts + pairCacheShardCount, next);
+    for (size_t i = 0; i < count; i++) {
+        chunk.shardOrder[next[chunk.states[i]]++] = static_cast<uint32_t>(i);
+    }
+}
+
+// Runs GJK on the shard's round pairs and stamps every touching pair in the shard, chunk by chunk,
+// marking each pair as a begin, a stay or not touching; then lists the shard's ended contacts.
+// Only touches its own shard, so the shards can run side by side.
+void Simulation::touchShard(size_t shard) {
+    PairCacheShard& cache = pairCache.getShard(shard);
+    const size_t prefetchDistance = 8;
+    for (size_t c = 0; c < narrowphaseChunks.size(); c++) {
+        NarrowphaseChunk& chunk = narrowphaseChunks[c];
+        const size_t end = chunk.shardStarts[shard + 1];
+        for (size_t k = chunk.shardStarts[shard]; k < end; k++) {
+            if (k + prefetchDistance < end) {
+                const ContactEvent& ahead = chunk.events[chunk.shardOrder[k + prefetchDistance]];
+                cache.prefetch(ahead.a, ahead.b);
+            }
+            const uint32_t i = chunk.shardOrder[k];
+            chunk.states[i] = touchPair(chunk, i, cache);
+        }
+    }
+    cache.appendEnded(shardEnds[shard]);
+}
+
+// touchShard for every shard at once, walking the chunk's pairs in order
+void Simulation::touchInOrder(NarrowphaseChunk& chunk) {
+    const size_t prefetchDistance = 8;
+    const size_t count = chunk.pairs.size();
+    for (size_t i = 0; i < count; i++) {
+        if (i + prefetchDistance < count) {
+            const ContactEvent& ahead = chunk.events[i + prefetchDistance];
+            pairCache.getShard(chunk.states[i + prefetchDistance]).prefetch(ahead.a, ahead.b);
+        }
+        chunk.states[i] = touchPair(chunk, i, pairCache.getShard(chunk.states[i]));
+    }
+}
+
+// Pair i's state: notTouching if its round shapes miss, else whether it begins or stays touching
+uint8_t Simulation::touchPair(const NarrowphaseChunk& chunk, size_t i, PairCacheShard& cache) const {
+    if (chunk.needsGjk[i] && !touchesRound(chunk.pairs[i].a, chunk.pairs[i].b, cache)) {
+        return notTouching;
+    }
+    const ContactEvent event = chunk.events[i];
+    return static_cast<uint8_t>(cache.touchColliding(event.a, event.b) ? ContactStay : ContactBegin);
+}
+
+// Joins the chunks' touching pairs into the colliding pairs and the begin and stay events, each at
+// its chunk's offset so they come out in candidate order, with the shards' end events after them
+// in shard order, and flags the colliding bodies.
+void Simulation::gatherContacts() {
+    PROFILE_ZONE("contact events");
+    const size_t chunks = narrowphaseChunks.size();
+    forEachRange(chunks, 1, [this](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            NarrowphaseChunk& chunk = narrowphaseChunks[c];
+            chunk.collidingCount = 0;
+            chunk.beginCount = 0;
+            for (size_t i = 0; i < chunk.states.size(); i++) {
+                chunk.collidingCount += chunk.states[i] != notTouching;
+                chunk.beginCount += chunk.states[i] == ContactBegin;
+            }
+        }
+    });
+
+    // Offsets of each chunk's runs; the stays follow every begin
+    size_t collidingCount = 0;
+    size_t beginCount = 0;
+    for (size_t c = 0; c < chunks; c++) {
+        narrowphaseChunks[c].collidingOffset = collidingCount;
+        narrowphaseChunks[c].beginOffset = beginCount;
+        collidingCount += narrowphaseChunks[c].collidingCount;
+        beginCount += narrowphaseChunks[c].beginCount;
+    }
+    size_t endCount = 0;
+    for (size_t shard = 0; shard < pairCacheShardCount; shard++) {
+        endCount += shardEnds[shard].size();
+    }
+    collidingPairs.resize(collidingCount);
+    contactEvents.resize(collidingCount + endCount);
+    if (collidingMarks.size() < bodies.size()) {
+        // Only grows with the body count; marks are left cleared after every step
+        std::vector<std::atomic<uint8_t> > grown(bodies.size() + bodies.size() / 2);
+        collidingMarks.swap(grown);
+    }
+
+    forEachRange(chunks, 1, [this, beginCount](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            const NarrowphaseChunk& chunk = narrowphaseChunks[c];
+            size_t colliding = chunk.collidingOffset;
+            size_t begins = chunk.beginOffset;
+            size_t stays = beginCount + chunk.collidingOffset - chunk.beginOffset;
+            for (size_t i = 0; i < chunk.states.size(); i++) {
+                if (chunk.states[i] == notTouching) {
+                    continue;
+                }
+                const CollisionPair pair = chunk.pairs[i];
+                collidingPairs[colliding++] = pair;
+                collidingMarks[pair.a].store(1, std::memory_order_relaxed);
+                collidingMarks[pair.b].store(1, std::memory_order_relaxed);
+                contactEvents[chunk.states[i] == ContactBegin ? begins++ : stays++] = chunk.events[i];
+            }
+        }
+    });
+    ContactEvent* ends = contactEvents.data() + collidingCount;
+    for (size_t shard = 0; shard < pairCacheShardCount; shard++) {
+        ends = std::copy(shardEnds[shard].begin(), shardEnds[shard].end(), ends);
+    }
+
+    contactEventStarts[ContactBegin] = 0;
+    contactEventStarts[ContactStay] = beginCount;
+    contactEventStarts[ContactEnd] = collidingCount;
+    contactEventStarts[contactEventTypeCount] = contactEvents.size();
+
+    // Swaps the marks into the body flags and clears them for the next step
+    forEachRange(bodies.size(), bodyGrain, [this](size_t begin, size_t end) {
+        uint32_t* flags = bodies.flags.data();
+        for (size_t i = begin; i < end; i++) {
+            const uint32_t colliding = collidingMarks[i].load(std::memory_order_relaxed) ? BodyColliding : 0u;
+            flags[i] = (flags[i] & ~static_cast<uint32_t>(BodyColliding)) | colliding;
+            collidingMarks[i].store(0, std::memory_order_relaxed);
+        }
+    });
+}
+
+const ContactEvent* Simulation::getContactEvents(ContactEventType type, size_t& count) const {
+    count = contactEventStarts[type + 1] - contactEventStarts[type];
+    return contactEvents.data() + contactEventStarts[type];
+}
+
+uint32_t Simulation::addShape(const ConvexShape& shape) {
+    float minX = shape.vertexX[0];
+    float minY = shape.vertexY[0];
+    float maxX = shape.vertexX[0];
+    float maxY = shape.vertexY[0];
+    for (int i = 1; i < shape.vertexCount; i++) {
+        minX = std::min(minX, shape.vertexX[i]);
+        minY = std::min(minY, shape.vertexY[i]);
+        maxX = std::max(maxX, shape.vertexX[i]);
+        maxY = std::max(maxY, shape.vertexY[i]);
+    }
+    minX -= shape.radius;
+    minY -= shape.radius;
+
+    ConvexShape moved = shape;
+    for (int i = 0; i < moved.vertexCount; i++) {
+        moved.vertexX[i] -= minX;
+        moved.vertexY[i] -= minY;
+    }
+
+    // Sharp hulls also get the cached SAT axes; everything else only needs the bounds
+    ConvexPolygon polygon = {};
+    if (moved.radius == 0.0f && moved.vertexCount >= 3) {
+        float points[maxPolygonVertices * 2];
+        for (int i = 0; i < moved.vertexCount; i++) {
+            points[i * 2] = moved.vertexX[i];
+            points[i * 2 + 1] = moved.vertexY[i];
+        }
+        polygon = makeConvexPolygon(points, moved.vertexCount, 2);
+    }
+    polygon.width = maxX + shape.radius - minX;
+    polygon.height = maxY + shape.radius - minY;
+    polygon.meshOffsetX = -minX;
+    polygon.meshOffsetY = -minY;
+
+    shapes.push_back(polygon);
+    convexShapes.push_back(moved);
+    return static_cast<uint32_t>(shapes.size() - 1);
+}
+
+namespace {
+
+// FNV-1a over whole 32-bit words; floats are hashed by their bits, so -0 and 0 differ
+uint32_t hashWords(uint32_t hash, const void* data, size_t count) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t word;
+        std::memcpy(&word, bytes + i * sizeof(word), sizeof(word));
+        hash = (hash ^ word) * 16777619u;
+    }
+    return hash;
+}
+
+} // namespace
+
+uint32_t Simulation::computeChecksum() const {
+    uint32_t hash = 2166136261u;
+    const size_t count = bodies.size();
+    hash = hashWords(hash, bodies.x.data(), count);
+    hash = hashWords(hash, bodies.y.data(), count);
+    hash = hashWords(hash, bodies.velocityX.data(), count);
+    hash = hashWords(hash, bodies.velocityY.data(), count);
+    hash = hashWords(hash, bodies.flags.data(), count);
+
+    const uint32_t steps[] = { static_cast<uint32_t>(stepCount), static_cast<uint32_t>(stepCount >> 32) };
+    return hashWords(hash, steps, 2);
+}
+
+BodyHandle Simulation::addBody(uint32_t shape, float x, float y, uint32_t flags) {
+    return bodies.create(x, y, shapes[shape].width, shapes[shape].height, flags, shape);
+}
+
+void Simulation::setVelocity(BodyHandle body, float velocityX, float velocityY) {
+    const size_t index = bodies.indexOf(body);
+    bodies.velocityX[index] = velocityX;
+    bodies.velocityY[index] = velocityY;
+}
+
+void Simulation::setCollisionFilter(BodyHandle body, uint32_t category, uint32_t mask) {
+    const size_t index = bodies.indexOf(body);
+    bodies.category[index] = category;
+    bodies.mask[index] = mask;
+}
+
+void Simulation::setLayerStatsEnabled(bool enabled) {
+    layerStatsEnabled = enabled;
+    broadphase.setCountFiltered(enabled);
+}
+
+void Simulation::resetLayerPairStats() {
+    const LayerPairStats zero = { 0, 0, 0 };
+    std::fill(layerPairStats.begin(), layerPairStats.end(), zero);
+}
+
+// Box test, then the exact test for candidates [begin, end): drops the AABB hits whose actual
+// shapes don't touch, such as the corners of the triangle's box. Sharp polygon pairs are settled
+// with SAT here; pairs with a round shape are kept and flagged for GJK. Thread safe.
+void Simulation::filterCandidates(size_t begin, size_t end, NarrowphaseChunk& out) const {
+    for (size_t i = begin; i < end; i++) {
+        const CollisionPair pair = candidatePairs[i];
+        if (!checkCollision(bodies.x[pair.a], bodies.y[pair.a], bodies.width[pair.a], bodies.height[pair.a],
+            bodies.x[pair.b], bodies.y[pair.b], bodies.width[pair.b], bodies.height[pair.b])) {
+            continue;
+        }
+        const bool round = needsGjk(pair.a, pair.b);
+        if (round || touchesSharp(pair.a, pair.b)) {
+            out.pairs.push_back(pair);
+            out.needsGjk.push_back(round ? 1 : 0);
+        }
+    }
+}
+
+// Adds this step's broadphase and narrowphase pairs to the per-layer-pair counters
+void Simulation::countLayerPairs() {
+    const uint32_t* filtered = broadphase.getFilteredCounts();
+    for (size_t p = 0; filtered && p < layerPairStats.size(); p++) {
+        layerPairStats[p].filtered += filtered[p];
+    }
+    const uint32_t* category = bodies.category.data();
+    for (size_t i = 0; i < candidatePairs.size(); i++) {
+        const CollisionPair pair = candidatePairs[i];
+        layerPairStats[layerPairIndex(collisionLayerOf(category[pair.a]), collisionLayerOf(category[pair.b]))].candidates++;
+    }
+    for (size_t i = 0; i < collidingPairs.size(); i++) {
+        const CollisionPair pair = collidingPairs[i];
+        layerPairStats[layerPairIndex(collisionLayerOf(category[pair.a]), collisionLayerOf(category[pair.b]))].colliding++;
+    }
+}
+
+// Ground contacts: a dynamic body falling into a non-dynamic body it was standing on or above at the
+// start of the step is put back on top and stops falling. Contacts from the side or from below are
+// left alone, so walking into a body still overlaps it (and shows as a collision), but jumping onto
+// it lands there.
+void Simulation::landOnContacts() {
+    PROFILE_ZONE("contacts");
+    // Finding the pairs of one dynamic and one non-dynamic body only reads the flags, so that part
+    // is spread over the threads; the landings go in pair order, as a body can land twice
+    const uint32_t* flags = bodies.flags.data();
+    auto isLanding = [this, flags](size_t i) {
+        return ((flags[collidingPairs[i].a] ^ flags[collidingPairs[i].b]) & BodyDynamic) != 0;
+    };
+    collectIndices(collidingPairs.size(), 4096, isLanding, landingPairs);
+    for (size_t l = 0; l < landingPairs.size(); l++) {
+        uint32_t body = collidingPairs[landingPairs[l]].a;
+        uint32_t other = collidingPairs[landingPairs[l]].b;
+        if (!(bodies.flags[body] & BodyDynamic)) {
+            std::swap(body, other);
+        }
+
+        const float top = bodies.y[other] + bodies.height[other];
+        if (bodies.velocityY[body] <= 0.0f && bodies.previousY[body] >= top - landingTolerance && bodies.y[body] <= top) {
+            bodies.y[body] = top;
+            bodies.velocityY[body] = 0.0f;
+            bodies.flags[body] |= BodyGrounded;
+            landedBodies.push_back(body);
+        }
+    }
+}
+
+uint32_t Simulation::castIgnoreIndex(BodyHandle ignore) const {
+    return bodies.isValid(ignore) ? static_cast<uint32_t>(bodies.indexOf(ignore)) : noRayHit;
+}
+
+bool Simulation::isCastTarget(uint32_t index, uint32_t mask, uint32_t ignoreIndex) const {
+    return (bodies.category[index] & mask) != 0 && index != ignoreIndex;
+}
+
+// Calls callback(index) for the bodies the grid can't find where they are now: added after it
+// was built, or landed since. A body that landed more than once comes up more than once.
+template <typename Callback>
+void Simulation::forEachUnbinned(Callback callback) const {
+    for (size_t i = binnedBodyCount; i < bodies.size(); i++) {
+        callback(static_cast<uint32_t>(i));
+    }
+    for (size_t i = 0; i < landedBodies.size(); i++) {
+        callback(landedBodies[i]);
+    }
+}
+
+bool Simulation::makeCastHit(uint32_t index, const SweepHit& sweep, CastHit& hit) const {
+    if (index == noRayHit) {
+        return false;
+    }
+    hit.body = bodies.handleAt(index);
+    hit.time = sweep.time;
+    hit.normalX = sweep.normalX;
+    hit.normalY = sweep.normalY;
+    return true;
+}
+
+bool Simulation::rayCast(float originX, float originY, float directionX, float directionY, float maxTime,
+    CastHit& hit, uint32_t mask, BodyHandle ignore) const {
+    const uint32_t ignoreIndex = castIgnoreIndex(ignore);
+    uint32_t nearest = noRayHit;
+    SweepHit nearestHit = {};
+    // Returns the time anything further has to beat
+    auto test = [&](uint32_t index, float limit) {
+        const Aabb box = { bodies.x[index], bodies.y[index], bodies.width[index], bodies.height[index] };
+        SweepHit candidate;
+        if (isCastTarget(index, mask, ignoreIndex)
+            && rayCastAabb(box, originX, originY, directionX, directionY, limit, candidate)) {
+            nearest = index;
+            nearestHit = candidate;
+            return candidate.time;
+        }
+        return limit;
+    };
+
+    float limit = castLimit(directionX, directionY, maxTime);
+    forEachUnbinned([&](uint32_t index) { limit = test(index, limit); });
+    broadphase.castThrough(originX, originY, directionX, directionY, limit, 0.0f, 0.0f, test);
+    return makeCastHit(nearest, nearestHit, hit);
+}
+
+// A box touches another exactly when its min corner is inside the other grown by the cast box's
+// size on its low sides, so this is a ray cast of the min corner against the grown boxes
+bool Simulation::boxCast(const Aabb& box, float directionX, float directionY, float maxTime, CastHit& hit,
+    uint32_t mask, BodyHandle ignore) const {
+    const uint32_t ignoreIndex = castIgnoreIndex(ignore);
+    uint32_t nearest = noRayHit;
+    SweepHit nearestHit = {};
+    auto test = [&](uint32_t index, float limit) {
+        const Aabb grown = { bodies.x[index] - box.width, bodies.y[index] - box.height,
+            bodies.width[index] + box.width, bodies.height[index] + box.height };
+        SweepHit candidate;
+        if (isCastTarget(index, mask, ignoreIndex)
+            && rayCastAabb(grown, box.x, box.y, directionX, directionY, limit, candidate)) {
+            nearest = index;
+            nearestHit = candidate;
+            return candidate.time;
+        }
+        return limit;
+    };
+
+    float limit = castLimit(directionX, directionY, maxTime);
+    forEachUnbinned([&](uint32_t index) { limit = test(index, limit); });
+    broadphase.castThrough(box.x, box.y, directionX, directionY, limit, box.width, box.height, test);
+    return makeCastHit(nearest, nearestHit, hit);
+}
+
+void Simulation::rayCastBatch(const RaySoAView& rays, float maxTime, float* times, BodyHandle* hits,
+    uint32_t mask, BodyHandle ignore) const {
+    const uint32_t ignoreIndex = castIgnoreIndex(ignore);
+    auto castPackets = [&](size_t begin, size_t end) {
+        RayPacket packet;
+        auto test = [&](uint32_t index) {
+            if (isCastTarget(index, mask, ignoreIndex)) {
+                const Aabb box = { bodies.x[index], bodies.y[index], bodies.width[index], bodies.height[index] };
+                rayCastAabbPacket(box, index, packet);
+            }
+        };
+
+        for (size_t p = begin; p < end; p++) {
+            const size_t first = p * rayPacketSize;
+            packet.count = std::min(rayPacketSize, rays.count - first);
+            for (size_t lane = 0; lane < rayPacketSize; lane++) {
+                if (lane >= packet.count) {
+                    packet.originX[lane] = 0.0f;
+                    packet.originY[lane] = 0.0f;
+                    packet.directionX[lane] = 0.0f;
+                    packet.directionY[lane] = 0.0f;
+                    packet.inverseX[lane] = 1.0f;
+                    packet.inverseY[lane] = 1.0f;
+                    packet.time[lane] = -1.0f;
+                    packet.hit[lane] = noRayHit;
+                    continue;
+                }
+                packet.originX[lane] = rays.originX[first + lane];
+                packet.originY[lane] = rays.originY[first + lane];
+                packet.directionX[lane] = rays.directionX[first + lane];
+                packet.directionY[lane] = rays.directionY[first + lane];
+                packet.inverseX[lane] = rayInverse(rays.directionX[first + lane]);
+                packet.inverseY[lane] = rayInverse(rays.directionY[first + lane]);
+                packet.time[lane] = castLimit(rays.directionX[first + lane], rays.directionY[first + lane], maxTime);
+                packet.hit[lane] = noRayHit;
+            }
+
+            forEachUnbinned(test);
+            broadphase.castPacket(packet, test);
+            for (size_t lane = 0; lane < packet.count; lane++) {
+                times[first + lane] = packet.hit[lane] != noRayHit ? packet.time[lane] : maxTime;
+                hits[first + lane] = packet.hit[lane] != noRayHit ? bodies.handleAt(packet.hit[lane]) : invalidBodyHandle;
+            }
+        }
+    };
+
+    const size_t packetCount = (rays.count + rayPacketSize - 1) / rayPacketSize;
+    const size_t grain = 16;
+    if (jobs && packetCount > grain) {
+        jobs->parallelFor(packetCount, grain, [&castPackets](size_t, size_t begin, size_t end, unsigned) {
+            castPackets(begin, end);
+        });
+    }
+    else {
+        castPackets(0, packetCount);
+    }
+}
+
+// Sharp polygon pairs use SAT with the cached axes; anything with a radius goes through GJK/EPA,
+// warm-started from the pair's simplex of the previous step. A body without a shape is its own box.
+bool Simulation::needsGjk(uint32_t a, uint32_t b) const {
+    const uint32_t shapeA = bodies.shape[a];
+    const uint32_t shapeB = bodies.shape[b];
+    const bool polygonA = shapeA == noBodyShape || (convexShapes[shapeA].radius == 0.0f && shapes[shapeA].vertexCount >= 3);
+    const bool polygonB = shapeB == noBodyShape || (convexShapes[shapeB].radius == 0.0f && shapes[shapeB].vertexCount >= 3);
+    return !(polygonA && polygonB);
+}
+
+// Only reads the bodies and shapes, so worker threads can call it
+bool Simulation::touchesSharp(uint32_t a, uint32_t b) const {
+    const uint32_t shapeA = bodies.shape[a];
+    const uint32_t shapeB = bodies.shape[b];
+    if (shapeA == noBodyShape && shapeB == noBodyShape) {
+        return true;
+    }
+
+    // Registered shapes are read in place; the box polygon is only built for a body without one
+    ConvexPolygon boxA;
+    ConvexPolygon boxB;
+    if (shapeA == noBodyShape) {
+        boxA = boxPolygon(bodies.width[a], bodies.height[a]);
+    }
+    if (shapeB == noBodyShape) {
+        boxB = boxPolygon(bodies.width[b], bodies.height[b]);
+    }
+    const ConvexPolygon& sharpA = shapeA != noBodyShape ? shapes[shapeA] : boxA;
+    const ConvexPolygon& sharpB = shapeB != noBodyShape ? shapes[shapeB] : boxB;
+    return checkPolygonCollision(sharpA, bodies.x[a], bodies.y[a], sharpB, bodies.x[b], bodies.y[b]);
+}
+
+// Updates the pair's cached simplex, so only ever called by the thread working through its shard
+bool Simulation::touchesRound(uint32_t a, uint32_t b, PairCacheShard& cache) const {
+    // The cached simplex refers to the shapes in slot order, so always run GJK in that order
+    uint32_t first = a;
+    uint32_t second = b;
+    if (bodies.handleAt(first).slot > bodies.handleAt(second).slot) {
+        std::swap(first, second);
+    }
+    PairCacheEntry& cached = cache.touch(bodies.handleAt(first), bodies.handleAt(second));
+
+    // As in touchesSharp: registered shapes in place, a box hull only for a body without a shape.
+    // The box takes the body's size, so there's no single one to share.
+    ConvexShape boxFirst;
+    ConvexShape boxSecond;
+    if (bodies.shape[first] == noBodyShape) {
+        boxFirst = makeHullShape(boxPolygon(bodies.width[first], bodies.height[first]));
+    }
+    if (bodies.shape[second] == noBodyShape) {
+        boxSecond = makeHullShape(boxPolygon(bodies.width[second], bodies.height[second]));
+    }
+    const ConvexShape& shapeFirst = bodies.shape[first] != noBodyShape ? convexShapes[bodies.shape[first]] : boxFirst;
+    const ConvexShape& shapeSecond = bodies.shape[second] != noBodyShape ? convexShapes[bodies.shape[second]] : boxSecond;
+    Contact contact;
+    return collideConvex(shapeFirst, bodies.x[first], bodies.y[first], shapeSecond, bodies.x[second], bodies.y[second],
+        cached.simplex, contact);
+}
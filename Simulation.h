@@ -0,0 +1,258 @@
+#pragma once
+
+#include "BodyStore.h"
+#include "Collision.h"
+#include "ConvexPolygon.h"
+#include "FrameArena.h"
+#include "Gjk.h"
+#include "JobSystem.h"
+#include "PairCache.h"
+#include "SpatialHash.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Simulation runs at a fixed rate, independent of the display refresh rate
+const float simulationStep = 1.0f / 120.0f;
+
+const float moveSpeed = 0.6f;     // Horizontal speed in units per second
+const float gravity = 4.0f;       // Downward acceleration of dynamic bodies in units per second squared
+const float jumpSpeed = 2.0f;     // Take-off speed; under the gravity above a jump peaks 0.5 units up after 0.5 s
+const float floorHeight = -1.0f;  // Dynamic bodies stand on this line when nothing else holds them up
+
+// How far below a body's top a dynamic body may have started the step and still land on it, for
+// rounding in the positions; anything lower came in from the side or from below
+const float landingTolerance = 1e-4f;
+
+// Bodies that move further than this fraction of the smallest body extent in one step are swept
+// instead of trusting the discrete overlap test, which could miss them passing straight through
+const float sweepThreshold = 0.5f;
+// Contacts a fast body may slide along in one step before the rest of its motion is dropped
+const int maxSweepIterations = 4;
+
+// Meshes shared by the collision shapes and the renderer (x, y, z per vertex)
+const int triangleVertexCount = 3;
+const int squareVertexCount = 4;
+extern const float triangleVertices[triangleVertexCount * 3];
+extern const float squareVertices[squareVertexCount * 3];
+
+// Triangle lists over the vertices above, for indexed drawing
+const int triangleIndexCount = 3;
+const int squareIndexCount = 6;
+extern const uint16_t triangleIndices[triangleIndexCount];
+extern const uint16_t squareIndices[squareIndexCount];
+
+// Keys sampled once per frame and fed to every simulation step of that frame
+struct InputState {
+    bool left;
+    bool right;
+    bool jump;
+};
+
+// Applies the keys to the player's velocity: left/right set the walking speed outright, and jump
+// kicks the body upwards if it is `grounded`. Gravity and the integrator do the rest of the arc.
+void stepPlayer(const InputState& input, bool grounded, float& velocityX, float& velocityY);
+
+// Collision work spent on one pair of layers, summed since the counters were last reset
+struct LayerPairStats {
+    uint64_t filtered;    // broadphase pairs the layers dropped before the narrowphase saw them
+    uint64_t candidates;  // broadphase pairs handed to the narrowphase
+    uint64_t colliding;   // pairs the narrowphase found touching
+};
+
+// Nearest body a rayCast or boxCast reached
+struct CastHit {
+    BodyHandle body;
+    float time;     // how far along the cast, in lengths of its direction vector
+    float normalX;  // face of the body's box that was hit; zero when the cast started inside it
+    float normalY;
+};
+
+// The world without any rendering: the player triangle, the square and the collision pipeline.
+// Needs no window or GL context, so it can run headless as well as behind the render loop.
+class Simulation {
+public:
+    Simulation();
+
+    // Spreads the broadphase, the narrowphase and the contact events over the pool's threads; null
+    // (the default) keeps them on the calling thread. The colliding pairs and contact events come
+    // out identical either way.
+    void setJobSystem(JobSystem* jobSystem) { jobs = jobSystem; }
+
+    // Runs one fixed step: applies the player's keys, integrates every body, stops dynamic bodies
+    // at the floor, sweeps the fast ones back to their first contact, rebuilds the broadphase and
+    // collision results, then lands dynamic bodies on whatever they fell onto
+    void step(const InputState& input);
+
+    const BodyStore& getBodies() const { return bodies; }
+    BodyHandle getPlayer() const { return player; }
+    BodyHandle getSquare() const { return square; }
+    // Shape table indexed by BodyStore::shape. Every entry has a ConvexShape for GJK; polygon
+    // shapes also carry their SAT data, and round ones an empty ConvexPolygon with just the bounds.
+    const std::vector<ConvexPolygon>& getShapes() const { return shapes; }
+    const std::vector<ConvexShape>& getConvexShapes() const { return convexShapes; }
+
+    // Registers any convex shape (circle, capsule, rounded hull) and returns its shape id. The
+    // shape is moved so its bounds start at the origin, matching the body box convention.
+    uint32_t addShape(const ConvexShape& shape);
+    // Adds a body using a registered shape, with its box min corner at (x, y)
+    BodyHandle addBody(uint32_t shape, float x, float y, uint32_t flags = 0);
+    // Sets a body's velocity in units per second. It keeps it, plus its acceleration, until a
+    // contact, the floor or the player's keys change it.
+    void setVelocity(BodyHandle body, float velocityX, float velocityY);
+
+    // Puts a body in the layers of `category` and pairs it only with bodies in `mask`'s layers;
+    // see layersCollide. Filtered pairs are dropped by the broadphase and skipped by the fast-body
+    // sweep.
+    void setCollisionFilter(BodyHandle body, uint32_t category, uint32_t mask);
+
+    // Per-layer-pair counters cost a pass over the pairs each step, so they stay off until enabled.
+    // Layers are counted by the lowest bit of each body's category.
+    void setLayerStatsEnabled(bool enabled);
+    bool isLayerStatsEnabled() const { return layerStatsEnabled; }
+    const LayerPairStats& getLayerPairStats(int layerA, int layerB) const { return layerPairStats[layerPairIndex(layerA, layerB)]; }
+    void resetLayerPairStats();
+
+    // Pairs of dense body indices that overlapped in the last step; lives in the step arena, so it
+    // is only valid until the next step
+    const ArenaVector<CollisionPair>& getCollidingPairs() const { return collidingPairs; }
+
+    // Contacts that began, continued or ended in the last step, as a run of the step's event
+    // buffer; game code that only cares about transitions reads the begin and end runs and never
+    // walks the pairs that just stay in contact. Valid until the next step, like the pairs.
+    const ContactEvent* getContactEvents(ContactEventType type, size_t& count) const;
+
+    // Scene queries against the body boxes as the last step left them. They walk that step's
+    // broadphase grid instead of testing every body, plus the few bodies added since it was built
+    // or moved after it by landing. Only bodies with a category bit in `mask` count, never `ignore`.
+
+    // Nearest body whose box the ray origin + direction * t reaches for t in [0, maxTime). The walk
+    // stops at the first grid cell that can't hold anything nearer. A ray starting inside a box
+    // hits it at time 0. A zero direction (or one below rayInverse's cutoff) only finds the boxes
+    // the origin is in, whatever maxTime is; so does a box cast's.
+    bool rayCast(float originX, float originY, float directionX, float directionY, float maxTime, CastHit& hit,
+        uint32_t mask = allCollisionLayers, BodyHandle ignore = invalidBodyHandle) const;
+    // First body `box` would touch moving by direction * t, for t in [0, maxTime)
+    bool boxCast(const Aabb& box, float directionX, float directionY, float maxTime, CastHit& hit,
+        uint32_t mask = allCollisionLayers, BodyHandle ignore = invalidBodyHandle) const;
+    // rayCast for thousands of rays at once, such as AI sensor sweeps. The rays go rayPacketSize at
+    // a time, vectorised across the packet, against the grid cells the packet sweeps over until each
+    // ray has found its hit, so rays next to each other in `rays` should be close in space and point
+    // the same way; a fan from one origin is ideal.
+    // Writes each ray's hit time and body, or maxTime and invalidBodyHandle for a miss. Packets are
+    // spread over the job system's threads when there is one, so call it from the thread that made it.
+    void rayCastBatch(const RaySoAView& rays, float maxTime, float* times, BodyHandle* hits,
+        uint32_t mask = allCollisionLayers, BodyHandle ignore = invalidBodyHandle) const;
+
+    // Scratch memory behind every per-step array, for high-water and overflow reports
+    const FrameArena& getArena() const { return arena; }
+
+    uint64_t getStepCount() const { return stepCount; }
+
+    // Hash of everything a step carries into the next: body positions, velocities and flags and the
+    // step count. Two runs that agree on it step for step did the same work.
+    uint32_t computeChecksum() const;
+
+private:
+    struct NarrowphaseChunk;
+
+    void resetScratch();
+    void resolveFloor();
+    void resolveFastBodies();
+    void sweepFastBody(size_t f, float threshold, ArenaVector<uint32_t>& sweepCandidates);
+    void buildBroadphase();
+    void updateCollisions();
+    void landOnContacts();
+    void countLayerPairs();
+    void filterCandidates(size_t begin, size_t end, NarrowphaseChunk& out) const;
+    void mapHandles(NarrowphaseChunk& chunk) const;
+    void groupByShard(NarrowphaseChunk& chunk) const;
+    void touchShard(size_t shard);
+    void touchInOrder(NarrowphaseChunk& chunk);
+    uint8_t touchPair(const NarrowphaseChunk& chunk, size_t i, PairCacheShard& cache) const;
+    void gatherContacts();
+    bool needsGjk(uint32_t a, uint32_t b) const;
+    bool touchesSharp(uint32_t a, uint32_t b) const;
+    bool touchesRound(uint32_t a, uint32_t b, PairCacheShard& cache) const;
+    template <typename Function>
+    void forEachRange(size_t count, size_t grain, Function function) const;
+    template <typename Keep>
+    void collectIndices(size_t count, size_t grain, Keep keep, ArenaVector<uint32_t>& out);
+    uint32_t castIgnoreIndex(BodyHandle ignore) const;
+    bool isCastTarget(uint32_t index, uint32_t mask, uint32_t ignoreIndex) const;
+    template <typename Callback>
+    void forEachUnbinned(Callback callback) const;
+    bool makeCastHit(uint32_t index, const SweepHit& sweep, CastHit& hit) const;
+
+    BodyStore bodies;
+    std::vector<ConvexPolygon> shapes;
+    std::vector<ConvexShape> convexShapes;
+
+    // Pairs the narrowphase has seen: their GJK simplex and the last steps they were seen and touching
+    PairCache pairCache;
+    BodyHandle player;
+    BodyHandle square;
+
+    // Everything below the arena is rebuilt each step in the arena's memory; resetScratch() hands
+    // it all back at the start of the next step
+    FrameArena arena;
+    SpatialHashGrid broadphase;
+    ArenaVector<CollisionPair> candidatePairs;
+    ArenaVector<CollisionPair> collidingPairs;
+    ArenaVector<uint32_t> fastBodies;
+    ArenaVector<float> fastEndsX;  // where each fast body's step took it, before any sweep stopped it
+    ArenaVector<float> fastEndsY;
+    ArenaVector<float> fastStopsX;  // where each fast body's sweep stopped it
+    ArenaVector<float> fastStopsY;
+    ArenaVector<uint32_t> landingPairs;  // colliding pairs of a dynamic and a non-dynamic body
+    ArenaVector<ContactEvent> contactEvents;  // begins, then stays, then ends
+    ArenaVector<ArenaVector<ContactEvent> > shardEnds;  // each pair cache shard's end events
+    ArenaVector<uint32_t> landedBodies;       // moved by landOnContacts after the grid was built
+    size_t contactEventStarts[contactEventTypeCount + 1];
+
+    // Narrowphase output of one chunk of candidates: the pairs that passed the box test and the
+    // exact test where it could run on a worker, which of them still need GJK, and their handles.
+    // With a job system `shardOrder` lists the pairs by pair cache shard, shard s in
+    // [shardStarts[s], shardStarts[s + 1]). The shards then mark each pair a begin, a stay or
+    // notTouching in `states`.
+    struct NarrowphaseChunk {
+        explicit NarrowphaseChunk(FrameArena* frameArena)
+            : pairs(ArenaAllocator<CollisionPair>(frameArena)), needsGjk(ArenaAllocator<uint8_t>(frameArena)),
+              events(ArenaAllocator<ContactEvent>(frameArena)), shardOrder(ArenaAllocator<uint32_t>(frameArena)),
+              states(ArenaAllocator<uint8_t>(frameArena)), collidingCount(0), beginCount(0), collidingOffset(0),
+              beginOffset(0) {}
+
+        void reserve(size_t count) {
+            pairs.reserve(count);
+            needsGjk.reserve(count);
+        }
+
+        ArenaVector<CollisionPair> pairs;
+        ArenaVector<uint8_t> needsGjk;
+        ArenaVector<ContactEvent> events;
+        ArenaVector<uint32_t> shardOrder;
+        ArenaVector<uint8_t> states;
+        size_t shardStarts[pairCacheShardCount + 1];
+        size_t collidingCount;  // pairs that touch, of which beginCount are begins
+        size_t beginCount;
+        size_t collidingOffset;  // where the chunk's run starts in collidingPairs
+        size_t beginOffset;      // and in the begin events
+    };
+    JobSystem* jobs;
+    ArenaVector<NarrowphaseChunk> narrowphaseChunks;
+    std::vector<std::atomic<uint8_t> > collidingMarks;  // bodies in a colliding pair, set by the chunks
+
+    // Bodies the broadphase grid was built over; later ones are only in the body arrays
+    size_t binnedBodyCount;
+
+    // Sizes from the last step; arena arrays reserve this much up front instead of regrowing
+    size_t lastCandidateCount;
+    std::vector<size_t> lastChunkCounts;
+    std::vector<size_t> collectCounts;  // collectIndices' per-chunk offsets
+
+    bool layerStatsEnabled;
+    std::vector<LayerPairStats> layerPairStats;  // indexed by layerPairIndex
+
+    uint64_t stepCount;
+};
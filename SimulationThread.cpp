@@ -0,0 +1,136 @@
+#include "SimulationThread.h"
+
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <utility>
+
+SimulationThread::SimulationThread(Simulation& simulation, float maxBacklog, InputLogWriter* recorder)
+    : simulation(simulation), recorder(recorder), maxBacklog(maxBacklog), banked(0.0f), bankedKeys(0),
+      stopping(false), busy(false), fresh(false) {}
+
+SimulationThread::~SimulationThread() {
+    stop();
+}
+
+void SimulationThread::start(unsigned threadCount) {
+    // The render thread draws from the start, before the first step has run
+    copySnapshot(0.0f);
+    published = building;
+    fresh = true;
+    thread = std::thread(&SimulationThread::run, this, threadCount);
+}
+
+void SimulationThread::stop() {
+    if (!thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void SimulationThread::advance(float seconds, uint8_t keys) {
+    bool ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        banked = std::min(banked + seconds, maxBacklog);
+        bankedKeys = keys;
+        ready = banked >= simulationStep;
+    }
+    if (ready) {
+        wake.notify_one();
+    }
+}
+
+bool SimulationThread::takeSnapshot(BodySnapshot& snapshot) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!fresh) {
+        return false;
+    }
+    std::swap(snapshot, published);
+    fresh = false;
+    return true;
+}
+
+bool SimulationThread::writeProfileTrace(const char* path) {
+    // Holding the lock keeps the simulation thread from starting another batch until the write is done
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return !busy; });
+    return ::writeProfileTrace(path);
+}
+
+void SimulationThread::run(unsigned threadCount) {
+    // parallelFor may only be called from the thread that made the pool
+    JobSystem jobs(threadCount);
+    simulation.setJobSystem(jobs.getThreadCount() > 1 ? &jobs : nullptr);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return stopping || banked >= simulationStep; });
+        if (banked < simulationStep) {
+            break;
+        }
+        // Take every whole step banked so far, with the newest keys, as the render loop used to
+        int steps = 0;
+        while (banked >= simulationStep) {
+            banked -= simulationStep;
+            steps++;
+        }
+        const uint8_t keys = bankedKeys;
+        const float alpha = banked / simulationStep;
+        busy = true;
+        lock.unlock();
+
+        {
+            PROFILE_ZONE("simulation");
+            const InputState input = unpackInputKeys(keys);
+            for (int s = 0; s < steps; s++) {
+                simulation.step(input);
+                if (recorder) {
+                    recorder->record(keys, simulation.computeChecksum());
+                }
+            }
+        }
+        {
+            PROFILE_ZONE("snapshot");
+            copySnapshot(alpha);
+        }
+
+        // Every zone of the batch is closed, so a trace written from here on reads a still ring
+        lock.lock();
+        std::swap(building, published);
+        fresh = true;
+        busy = false;
+        idle.notify_all();
+    }
+    lock.unlock();
+    simulation.setJobSystem(nullptr);
+}
+
+void SimulationThread::copySnapshot(float alpha) {
+    const BodyStore& bodies = simulation.getBodies();
+    const std::vector<ConvexPolygon>& shapes = simulation.getShapes();
+    const size_t count = bodies.size();
+    building.previousX.resize(count);
+    building.previousY.resize(count);
+    building.x.resize(count);
+    building.y.resize(count);
+    building.flags.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        // Bodies sit at their box min corner; the mesh origin is offset from it
+        const float meshOffsetX = bodies.shape[i] != noBodyShape ? shapes[bodies.shape[i]].meshOffsetX : 0.0f;
+        const float meshOffsetY = bodies.shape[i] != noBodyShape ? shapes[bodies.shape[i]].meshOffsetY : 0.0f;
+        building.previousX[i] = bodies.previousX[i] + meshOffsetX;
+        building.previousY[i] = bodies.previousY[i] + meshOffsetY;
+        building.x[i] = bodies.x[i] + meshOffsetX;
+        building.y[i] = bodies.y[i] + meshOffsetY;
+        building.flags[i] = bodies.flags[i];
+    }
+    building.alpha = alpha;
+    building.stepCount = simulation.getStepCount();
+}
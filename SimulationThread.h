@@ -0,0 +1,85 @@
+#pragma once
+
+#include "InputLog.h"
+#include "Simulation.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Bodies as one batch of completed steps left them, copied out for the render thread. Positions
+// are where each body's mesh origin goes, at the start and the end of the last step.
+struct BodySnapshot {
+    BodySnapshot() : alpha(0.0f), stepCount(0) {}
+
+    size_t size() const { return x.size(); }
+
+    std::vector<float> previousX;
+    std::vector<float> previousY;
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<uint32_t> flags;
+    float alpha;  // fraction of a step banked but not yet run when the snapshot was taken
+    uint64_t stepCount;
+};
+
+// Runs a Simulation's fixed steps on a thread of its own, so the render loop never waits on a
+// step: each frame it banks its frame time and keys with advance() and draws the latest snapshot.
+// The simulation thread runs every whole step the bank covers with the keys banked last, then
+// publishes a snapshot. Snapshots rotate through three buffers, so once each has grown to the
+// body count neither thread allocates or waits on the other's copy.
+//
+// The simulation (and the job system, which is made on the simulation thread as parallelFor
+// requires) belongs to the simulation thread from start() until stop() returns.
+class SimulationThread {
+public:
+    // `maxBacklog` caps the banked time, in seconds, so a simulation that can't keep up drops time
+    // instead of falling ever further behind. A non-null `recorder` logs every step's keys and checksum.
+    SimulationThread(Simulation& simulation, float maxBacklog, InputLogWriter* recorder);
+    ~SimulationThread();
+
+    // `threadCount` is the collision job system's, as for JobSystem; 1 keeps collision on the
+    // simulation thread
+    void start(unsigned threadCount);
+    // Runs out the whole steps already banked, then joins the thread
+    void stop();
+
+    // Banks `seconds` of frame time to be stepped with `keys` (see packInputKeys)
+    void advance(float seconds, uint8_t keys);
+
+    // Swaps the newest snapshot into `snapshot` if one was published since the last call and
+    // returns whether it did; otherwise `snapshot` keeps the one it already has
+    bool takeSnapshot(BodySnapshot& snapshot);
+
+    // writeProfileTrace for while the simulation runs: waits for the batch of steps in flight to
+    // finish and holds the next one back until the trace is written, so the simulation thread and
+    // the job workers are idle as the profiler requires. Call it from the render thread, the only
+    // other thread recording zones.
+    bool writeProfileTrace(const char* path);
+
+private:
+    SimulationThread(const SimulationThread&);
+    SimulationThread& operator=(const SimulationThread&);
+
+    void run(unsigned threadCount);
+    void copySnapshot(float alpha);
+
+    Simulation& simulation;
+    InputLogWriter* recorder;
+    const float maxBacklog;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;  // signalled when a batch of steps is done
+    float banked;
+    uint8_t bankedKeys;
+    bool stopping;
+    bool busy;  // a batch of steps is running, unlocked
+    BodySnapshot published;
+    bool fresh;
+
+    BodySnapshot building;  // only touched by the simulation thread
+    std::thread thread;
+};
@@ -0,0 +1,603 @@
+#include "SpatialHash.h"
+
+#include <algorithm>
+#include <limits>
+
+SpatialHashGrid::SpatialHashGrid(float size)
+    : cellSize(size), inverseCellSize(1.0f / size), bucketMask(0), rowStride(1), originX(0), originY(0), dense(false), categories(nullptr), masks(nullptr),
+      filtering(false), minCellX(0), minCellY(0), maxCellX(0), maxCellY(0), arena(nullptr), countFiltered(false) {
+    boxes = AabbSoAView{ nullptr, nullptr, nullptr, nullptr, 0 };
+}
+
+void SpatialHashGrid::setCellSize(float size) {
+    cellSize = size;
+    inverseCellSize = 1.0f / size;
+}
+
+int32_t SpatialHashGrid::cellCoord(float value) const {
+    // Truncate, then step down for negative non-integers; avoids a libm floor call per corner
+    float scaled = value * inverseCellSize;
+    int32_t truncated = static_cast<int32_t>(scaled);
+    return truncated - (scaled < static_cast<float>(truncated) ? 1 : 0);
+}
+
+// cellCoord for values that may lie far outside [low, high] cells, or be infinite: clamped before
+// the conversion so it can't overflow
+int32_t SpatialHashGrid::clampedCellCoord(float value, int32_t low, int32_t high) const {
+    const float scaled = value * inverseCellSize;
+    if (!(scaled >= static_cast<float>(low))) {
+        return low;
+    }
+    if (scaled >= static_cast<float>(high)) {
+        return high;
+    }
+    return std::min(std::max(cellCoord(value), low), high);
+}
+
+uint32_t SpatialHashGrid::bucketFor(int32_t cellX, int32_t cellY) const {
+    // Row-major linear hash: horizontally adjacent cells land in adjacent buckets and the row
+    // above sits rowStride buckets further on, so neighbour lookups stay close in memory
+    uint32_t hash = static_cast<uint32_t>(cellY - originY) * rowStride + static_cast<uint32_t>(cellX - originX);
+    return hash & bucketMask;
+}
+
+// Empties every scratch array and points it at `frameArena`, without allocating
+void SpatialHashGrid::bindScratch(FrameArena& frameArena) {
+    arena = &frameArena;
+    resetArenaVector(entryKeys, frameArena);
+    resetArenaVector(entries, frameArena);
+    resetArenaVector(entryCells, frameArena);
+    resetArenaVector(entryBuckets, frameArena);
+    resetArenaVector(bucketStarts, frameArena);
+    resetArenaVector(rangeBoxes, frameArena);
+    resetArenaVector(rangeOffsets, frameArena);
+    resetArenaVector(oversize, frameArena);
+    resetArenaVector(oversizeHits, frameArena);
+    resetArenaVector(chunkPairs, frameArena);
+    resetArenaVector(filteredCounts, frameArena);
+}
+
+void SpatialHashGrid::releaseScratch() {
+    if (arena) {
+        bindScratch(*arena);
+    }
+}
+
+// Bounds of boxes [begin, end): the float min and max corners, whether every one of them is a
+// finite cell-sized box, and whether any leaves a layer out. Bounds of ranges combine with merge().
+SpatialHashGrid::BoxBounds SpatialHashGrid::scanBoxes(size_t begin, size_t end) const {
+    const float* boxX = boxes.x;
+    const float* boxY = boxes.y;
+    const float* boxWidth = boxes.width;
+    const float* boxHeight = boxes.height;
+    BoxBounds bounds;
+    bool anyFiltered = false;
+    for (size_t i = begin; i < end; i++) {
+        anyFiltered |= masks[i] != allCollisionLayers || categories[i] == 0;
+    }
+    bounds.anyFiltered = anyFiltered;
+
+    // The usual scene has only finite, cell-sized boxes, and then plain float min and max chains
+    // over the corners give the bounds; anything else takes scanCells, which skips oversize boxes
+    float lowCornerX = std::numeric_limits<float>::max();
+    float lowCornerY = std::numeric_limits<float>::max();
+    float highCornerX = -std::numeric_limits<float>::max();
+    float highCornerY = -std::numeric_limits<float>::max();
+    bool simple = true;
+    for (size_t i = begin; i < end; i++) {
+        lowCornerX = std::min(lowCornerX, boxX[i]);
+        lowCornerY = std::min(lowCornerY, boxY[i]);
+        highCornerX = std::max(highCornerX, boxX[i]);
+        highCornerY = std::max(highCornerY, boxY[i]);
+        simple &= boxX[i] - boxX[i] == 0.0f && boxY[i] - boxY[i] == 0.0f
+            && boxWidth[i] <= cellSize && boxHeight[i] <= cellSize;
+    }
+    bounds.lowCornerX = lowCornerX;
+    bounds.lowCornerY = lowCornerY;
+    bounds.highCornerX = highCornerX;
+    bounds.highCornerY = highCornerY;
+    bounds.simple = simple;
+    bounds.lowX = std::numeric_limits<int32_t>::max();
+    bounds.lowY = std::numeric_limits<int32_t>::max();
+    bounds.highX = std::numeric_limits<int32_t>::min();
+    bounds.highY = std::numeric_limits<int32_t>::min();
+    return bounds;
+}
+
+// Cells holding the grid boxes among [begin, end), for when scanBoxes found something unusual
+void SpatialHashGrid::scanCells(size_t begin, size_t end, BoxBounds& bounds) const {
+    for (size_t i = begin; i < end; i++) {
+        if (boxes.width[i] > cellSize || boxes.height[i] > cellSize) {
+            continue;
+        }
+        const int32_t cellX = cellCoord(boxes.x[i]);
+        const int32_t cellY = cellCoord(boxes.y[i]);
+        bounds.lowX = std::min(bounds.lowX, cellX);
+        bounds.lowY = std::min(bounds.lowY, cellY);
+        bounds.highX = std::max(bounds.highX, cellX);
+        bounds.highY = std::max(bounds.highY, cellY);
+    }
+}
+
+void SpatialHashGrid::BoxBounds::merge(const BoxBounds& other) {
+    lowCornerX = std::min(lowCornerX, other.lowCornerX);
+    lowCornerY = std::min(lowCornerY, other.lowCornerY);
+    highCornerX = std::max(highCornerX, other.highCornerX);
+    highCornerY = std::max(highCornerY, other.highCornerY);
+    lowX = std::min(lowX, other.lowX);
+    lowY = std::min(lowY, other.lowY);
+    highX = std::max(highX, other.highX);
+    highY = std::max(highY, other.highY);
+    simple &= other.simple;
+    anyFiltered |= other.anyFiltered;
+}
+
+// Settles the cells the grid covers and the bucket layout from the boxes' bounds; returns the
+// bucket count
+uint32_t SpatialHashGrid::chooseLayout(BoxBounds bounds) {
+    filtering = bounds.anyFiltered;
+
+    // Far enough inside the int range that cellCoord can't overflow
+    const float cellLimit = 1e9f;
+    const bool simple = bounds.simple
+        && std::max(-bounds.lowCornerX, bounds.highCornerX) * inverseCellSize < cellLimit
+        && std::max(-bounds.lowCornerY, bounds.highCornerY) * inverseCellSize < cellLimit;
+    if (simple && boxes.count != 0) {
+        bounds.lowX = cellCoord(bounds.lowCornerX);
+        bounds.lowY = cellCoord(bounds.lowCornerY);
+        bounds.highX = cellCoord(bounds.highCornerX);
+        bounds.highY = cellCoord(bounds.highCornerY);
+    }
+    minCellX = bounds.lowX;
+    minCellY = bounds.lowY;
+    maxCellX = bounds.highX;
+    maxCellY = bounds.highY;
+
+    // When the rows of occupied cells, with a spare column either side and a spare row above, take
+    // no more buckets than the hash table would, lay them out one after another: every cell then
+    // has a bucket of its own and its forward neighbours sit at fixed offsets from it. Otherwise the
+    // world is too sparse for that, and rows are hashed on a square stride into a table at least
+    // twice the box count, so unrelated cells rarely share a bucket.
+    uint32_t bucketCount = 64;
+    while (bucketCount < boxes.count * 2) {
+        bucketCount <<= 1;
+    }
+    const int64_t spanX = static_cast<int64_t>(maxCellX) - minCellX + 3;
+    const int64_t spanY = static_cast<int64_t>(maxCellY) - minCellY + 2;
+    // Spans are checked one at a time first, so cells at the int limits (from NaN or huge
+    // coordinates) can't overflow the product
+    const int64_t tableSize = static_cast<int64_t>(bucketCount);
+    dense = minCellX <= maxCellX && spanX <= tableSize && spanY <= tableSize && spanX * spanY <= tableSize;
+    if (dense) {
+        bucketCount = static_cast<uint32_t>(spanX * spanY);
+        bucketMask = std::numeric_limits<uint32_t>::max();
+        rowStride = static_cast<uint32_t>(spanX);
+        originX = minCellX - 1;
+        originY = minCellY;
+    }
+    else {
+        bucketMask = bucketCount - 1;
+        rowStride = 1;
+        while (rowStride * rowStride < bucketCount) {
+            rowStride <<= 1;
+        }
+        originX = 0;
+        originY = 0;
+    }
+    return bucketCount;
+}
+
+// Box i's bucket with its crossing bits on top, or noBucket for an oversize box. A neighbour can
+// only be reached when the box pokes across that cell edge.
+uint32_t SpatialHashGrid::entryKey(size_t i) const {
+    if (boxes.width[i] > cellSize || boxes.height[i] > cellSize) {
+        return noBucket;
+    }
+    const int32_t cellX = cellCoord(boxes.x[i]);
+    const int32_t cellY = cellCoord(boxes.y[i]);
+    const uint32_t crossesX = cellCoord(boxes.x[i] + boxes.width[i]) > cellX ? 1u : 0u;
+    const uint32_t crossesY = cellCoord(boxes.y[i] + boxes.height[i]) > cellY ? 1u : 0u;
+    return bucketFor(cellX, cellY) | crossesX << 30 | crossesY << 31;
+}
+
+// Writes box i, keyed `key`, to entry `slot`
+void SpatialHashGrid::placeEntry(uint32_t slot, uint32_t i, uint32_t key) {
+    entries[slot] = i << 2 | key >> 30;
+    if (dense) {
+        entryBuckets[slot] = key & bucketBits;
+    }
+    else {
+        const Cell cell = { cellCoord(boxes.x[i]), cellCoord(boxes.y[i]) };
+        entryCells[slot] = cell;
+    }
+}
+
+void SpatialHashGrid::resizeEntries(size_t binnedCount) {
+    entries.resize(binnedCount);
+    if (dense) {
+        entryBuckets.resize(binnedCount);
+    }
+    else {
+        entryCells.resize(binnedCount);
+    }
+}
+
+void SpatialHashGrid::build(const AabbSoAView& newBoxes, const uint32_t* newCategories, const uint32_t* newMasks,
+    FrameArena& frameArena) {
+    boxes = newBoxes;
+    categories = newCategories;
+    masks = newMasks;
+    bindScratch(frameArena);
+
+    BoxBounds bounds = scanBoxes(0, boxes.count);
+    if (!bounds.simple) {
+        scanCells(0, boxes.count, bounds);
+    }
+    const uint32_t bucketCount = chooseLayout(bounds);
+
+    bucketStarts.assign(bucketCount + 1, 0);
+    entryKeys.resize(boxes.count);
+    for (size_t i = 0; i < boxes.count; i++) {
+        const uint32_t key = entryKey(i);
+        entryKeys[i] = key;
+        if (key == noBucket) {
+            oversize.push_back(static_cast<uint32_t>(i));
+        }
+        else {
+            bucketStarts[key & bucketBits]++;
+        }
+    }
+
+    // Counting sort of the boxes by bucket. An inclusive prefix sum leaves each slot at its
+    // bucket's end; scattering with a pre-decrement walks it back to the bucket's start.
+    uint32_t* starts = bucketStarts.data();
+    uint32_t runningTotal = 0;
+    for (uint32_t b = 0; b <= bucketCount; b++) {
+        runningTotal += starts[b];
+        starts[b] = runningTotal;
+    }
+    resizeEntries(boxes.count - oversize.size());
+    for (size_t i = boxes.count; i > 0; i--) {
+        const uint32_t key = entryKeys[i - 1];
+        if (key != noBucket) {
+            placeEntry(--bucketStarts[key & bucketBits], static_cast<uint32_t>(i - 1), key);
+        }
+    }
+}
+
+void SpatialHashGrid::build(JobSystem& jobs, const AabbSoAView& newBoxes, const uint32_t* newCategories,
+    const uint32_t* newMasks, FrameArena& frameArena) {
+    boxes = newBoxes;
+    categories = newCategories;
+    masks = newMasks;
+    bindScratch(frameArena);
+
+    const size_t grain = 8192;
+    const size_t chunks = JobSystem::chunkCount(boxes.count, grain);
+    ArenaVector<BoxBounds> chunkBounds{ ArenaAllocator<BoxBounds>(arena) };
+    chunkBounds.resize(chunks);
+    jobs.parallelFor(boxes.count, grain, [this, &chunkBounds](size_t chunk, size_t begin, size_t end, unsigned) {
+        chunkBounds[chunk] = scanBoxes(begin, end);
+    });
+    BoxBounds bounds = scanBoxes(0, 0);
+    for (size_t c = 0; c < chunks; c++) {
+        bounds.merge(chunkBounds[c]);
+    }
+    if (!bounds.simple) {
+        jobs.parallelFor(boxes.count, grain, [this, &chunkBounds](size_t chunk, size_t begin, size_t end, unsigned) {
+            scanCells(begin, end, chunkBounds[chunk]);
+        });
+        for (size_t c = 0; c < chunks; c++) {
+            bounds.merge(chunkBounds[c]);
+        }
+    }
+    const uint32_t bucketCount = chooseLayout(bounds);
+
+    // The same stable counting sort in two levels, so no thread needs a histogram of every bucket.
+    // Each chunk of boxes counts its boxes per range of buckets and then, from offsets in chunk
+    // order, moves them into their range in box order. Each range then sorts its own boxes into its
+    // own buckets and entries. Every bucket's entries end up in box order, as in build().
+    const uint32_t rangeSize = std::max<uint32_t>(1, (bucketCount + buildRangeCount - 1) / buildRangeCount);
+    const size_t ranges = (bucketCount + rangeSize - 1) / rangeSize;
+    const size_t columns = ranges + 1;  // the last column counts oversize boxes
+    bucketStarts.assign(bucketCount + 1, 0);
+    entryKeys.resize(boxes.count);
+    rangeOffsets.assign(chunks * columns, 0);
+    jobs.parallelFor(boxes.count, grain, [this, rangeSize, ranges, columns](size_t chunk, size_t begin, size_t end, unsigned) {
+        uint32_t* counts = rangeOffsets.data() + chunk * columns;
+        for (size_t i = begin; i < end; i++) {
+            const uint32_t key = entryKey(i);
+            entryKeys[i] = key;
+            counts[key == noBucket ? ranges : (key & bucketBits) / rangeSize]++;
+        }
+    });
+    // Column by column, so each range's boxes follow the last range's and oversize boxes come last
+    ArenaVector<uint32_t> rangeStarts{ ArenaAllocator<uint32_t>(arena) };
+    rangeStarts.resize(columns + 1);
+    uint32_t runningTotal = 0;
+    for (size_t r = 0; r < columns; r++) {
+        rangeStarts[r] = runningTotal;
+        for (size_t c = 0; c < chunks; c++) {
+            const uint32_t count = rangeOffsets[c * columns + r];
+            rangeOffsets[c * columns + r] = runningTotal;
+            runningTotal += count;
+        }
+    }
+    rangeStarts[columns] = runningTotal;
+    const uint32_t binnedCount = rangeStarts[ranges];
+    oversize.resize(boxes.count - binnedCount);
+    rangeBoxes.resize(binnedCount);
+    jobs.parallelFor(boxes.count, grain, [this, rangeSize, ranges, columns, binnedCount](size_t chunk, size_t begin,
+        size_t end, unsigned) {
+        uint32_t* next = rangeOffsets.data() + chunk * columns;
+        for (size_t i = begin; i < end; i++) {
+            const uint32_t key = entryKeys[i];
+            if (key == noBucket) {
+                oversize[next[ranges]++ - binnedCount] = static_cast<uint32_t>(i);
+            }
+            else {
+                rangeBoxes[next[(key & bucketBits) / rangeSize]++] = static_cast<uint32_t>(i);
+            }
+        }
+    });
+
+    resizeEntries(binnedCount);
+    jobs.parallelFor(ranges, 1, [this, rangeSize, bucketCount, &rangeStarts](size_t range, size_t, size_t, unsigned) {
+        const uint32_t firstBucket = static_cast<uint32_t>(range) * rangeSize;
+        const uint32_t endBucket = std::min(bucketCount, firstBucket + rangeSize);
+        const uint32_t first = rangeStarts[range];
+        const uint32_t end = rangeStarts[range + 1];
+        uint32_t* starts = bucketStarts.data();
+        for (uint32_t k = first; k < end; k++) {
+            starts[entryKeys[rangeBoxes[k]] & bucketBits]++;
+        }
+        uint32_t runningTotal = first;
+        for (uint32_t b = firstBucket; b < endBucket; b++) {
+            runningTotal += starts[b];
+            starts[b] = runningTotal;
+        }
+        for (uint32_t k = end; k > first; k--) {
+            const uint32_t i = rangeBoxes[k - 1];
+            const uint32_t key = entryKeys[i];
+            placeEntry(--starts[key & bucketBits], i, key);
+        }
+    });
+    bucketStarts[bucketCount] = binnedCount;
+}
+
+namespace {
+
+// Stores the pair as (lower, higher) with masks rather than min and max, which compilers tend to
+// turn into a branch that box indices in random order mispredict half the time
+inline void writeOrderedPair(uint32_t a, uint32_t b, CollisionPair& out) {
+    const uint32_t swap = 0u - static_cast<uint32_t>(b < a);
+    const uint32_t difference = (a ^ b) & swap;
+    out.a = a ^ difference;
+    out.b = b ^ difference;
+}
+
+} // namespace
+
+// True if the boxes' layers collide; otherwise the pair is only counted, when counting
+template <bool Filter>
+bool SpatialHashGrid::layersPass(uint32_t a, uint32_t b, uint32_t* filtered) const {
+    if (!Filter || layersCollide(categories[a], masks[a], categories[b], masks[b])) {
+        return true;
+    }
+    if (filtered) {
+        filtered[layerPairIndex(collisionLayerOf(categories[a]), collisionLayerOf(categories[b]))]++;
+    }
+    return false;
+}
+
+// Appends the pair of boxes if their layers collide
+template <bool Filter>
+void SpatialHashGrid::emitPair(uint32_t a, uint32_t b, ArenaVector<CollisionPair>& outPairs, uint32_t* filtered) const {
+    if (layersPass<Filter>(a, b, filtered)) {
+        CollisionPair pair = { std::min(a, b), std::max(a, b) };
+        outPairs.push_back(pair);
+    }
+}
+
+// Pairs entry `e` with the boxes of one neighbour cell; with `crossingOnly`, only those that reach
+// across into the next column
+template <bool Filter>
+void SpatialHashGrid::emitCellPairs(uint32_t e, int32_t cellX, int32_t cellY, bool crossingOnly,
+    ArenaVector<CollisionPair>& outPairs, uint32_t* filtered) const {
+    const uint32_t bucket = bucketFor(cellX, cellY);
+    const uint32_t end = bucketStarts[bucket + 1];
+    for (uint32_t j = bucketStarts[bucket]; j < end; j++) {
+        if (entryCells[j].x == cellX && entryCells[j].y == cellY && (!crossingOnly || entryCrossesX(entries[j]))) {
+            emitPair<Filter>(entryIndex(entries[e]), entryIndex(entries[j]), outPairs, filtered);
+        }
+    }
+}
+
+// Grid boxes are no larger than a cell, so two of them can only overlap when their min corners
+// sit in the same or neighbouring cells. Looking only "forward" (right, up-left, up, up-right)
+// visits every neighbouring cell pair once, so no pair is reported twice, and a neighbour only
+// counts when the box that would have to reach into the other's cell crosses that cell edge.
+// Only reads the grid, so disjoint entry ranges can run on different threads.
+template <bool Filter>
+void SpatialHashGrid::findSparsePairs(uint32_t begin, uint32_t end, ArenaVector<CollisionPair>& outPairs,
+    uint32_t* filtered) const {
+    for (uint32_t i = begin; i < end; i++) {
+        const Cell cell = entryCells[i];
+        const uint32_t entry = entries[i];
+
+        // Later entries of the same run that share the cell
+        const uint32_t bucketEnd = bucketStarts[bucketFor(cell.x, cell.y) + 1];
+        for (uint32_t j = i + 1; j < bucketEnd; j++) {
+            if (entryCells[j].x == cell.x && entryCells[j].y == cell.y) {
+                emitPair<Filter>(entryIndex(entry), entryIndex(entries[j]), outPairs, filtered);
+            }
+        }
+
+        if (entryCrossesX(entry)) {
+            emitCellPairs<Filter>(i, cell.x + 1, cell.y, false, outPairs, filtered);
+        }
+        if (entryCrossesY(entry)) {
+            emitCellPairs<Filter>(i, cell.x - 1, cell.y + 1, true, outPairs, filtered);
+            emitCellPairs<Filter>(i, cell.x, cell.y + 1, false, outPairs, filtered);
+            if (entryCrossesX(entry)) {
+                emitCellPairs<Filter>(i, cell.x + 1, cell.y + 1, false, outPairs, filtered);
+            }
+        }
+    }
+}
+
+// The same search on the dense layout. A cell and the one to its right are neighbouring buckets
+// and the three cells above are one run of buckets, so each entry scans two runs of entries,
+// every one of which it pairs with: no cell lookups and no cell comparisons. Pairs are written
+// ahead of the count, which only moves on for the ones that count, so the scans don't branch on
+// each candidate.
+template <bool Filter>
+void SpatialHashGrid::findDensePairs(uint32_t begin, uint32_t end, ArenaVector<CollisionPair>& outPairs,
+    uint32_t* filtered) const {
+    const uint32_t* grid = entries.data();
+    const uint32_t* buckets = entryBuckets.data();
+    const uint32_t* starts = bucketStarts.data();
+    size_t count = outPairs.size();
+    outPairs.resize(std::max(outPairs.capacity(), count + 64));
+    for (uint32_t i = begin; i < end; i++) {
+        const uint32_t entry = grid[i];
+        const uint32_t bucket = buckets[i];
+        const uint32_t index = entryIndex(entry);
+        const uint32_t crossesX = entryCrossesX(entry) ? 1u : 0u;
+        // Later entries of this cell, and the cell to the right when the box reaches into it
+        const uint32_t rowEnd = starts[bucket + 1 + crossesX];
+        // The cell above always, up-left when that box reaches across to this column, and up-right
+        // when this one reaches across to the next
+        const uint32_t above = bucket + rowStride - 1;
+        const uint32_t aboveBegin = starts[above];
+        const uint32_t upBegin = starts[above + 1];
+        const uint32_t aboveEnd = entryCrossesY(entry) ? starts[above + 2 + crossesX] : aboveBegin;
+
+        const size_t most = (rowEnd - i - 1) + (aboveEnd - aboveBegin);
+        if (count + most > outPairs.size()) {
+            outPairs.resize(std::max(outPairs.size() * 2, count + most));
+        }
+        CollisionPair* out = outPairs.data();
+        for (uint32_t j = i + 1; j < rowEnd; j++) {
+            const uint32_t other = entryIndex(grid[j]);
+            writeOrderedPair(index, other, out[count]);
+            count += layersPass<Filter>(index, other, filtered) ? 1 : 0;
+        }
+        for (uint32_t j = aboveBegin; j < aboveEnd; j++) {
+            const uint32_t other = entryIndex(grid[j]);
+            writeOrderedPair(index, other, out[count]);
+            const uint32_t reaches = static_cast<uint32_t>(j >= upBegin) | (grid[j] & 1u);
+            count += reaches != 0 && layersPass<Filter>(index, other, filtered) ? 1 : 0;
+        }
+    }
+    outPairs.resize(count);
+}
+
+void SpatialHashGrid::findGridPairs(uint32_t begin, uint32_t end, ArenaVector<CollisionPair>& outPairs,
+    uint32_t* filtered) const {
+    if (dense && filtering) {
+        findDensePairs<true>(begin, end, outPairs, filtered);
+    }
+    else if (dense) {
+        findDensePairs<false>(begin, end, outPairs, filtered);
+    }
+    else if (filtering) {
+        findSparsePairs<true>(begin, end, outPairs, filtered);
+    }
+    else {
+        findSparsePairs<false>(begin, end, outPairs, filtered);
+    }
+}
+
+// Oversize boxes are few; test each of oversize[begin, end) against every box with the batch
+// kernel. `hits` is scratch the size of the box count. Only reads the grid, so disjoint ranges can
+// run on different threads.
+void SpatialHashGrid::findOversizePairs(size_t begin, size_t end, ArenaVector<CollisionPair>& outPairs, uint32_t* filtered,
+    uint32_t* hits) const {
+    for (size_t k = begin; k < end; k++) {
+        const uint32_t index = oversize[k];
+        const Aabb box = { boxes.x[index], boxes.y[index], boxes.width[index], boxes.height[index] };
+        const size_t hitCount = checkCollisionBatchIndices(box, boxes, hits);
+        for (size_t h = 0; h < hitCount; h++) {
+            const uint32_t other = hits[h];
+            // Oversize vs oversize pairs are reported once, from the lower index
+            const bool otherOversize = boxes.width[other] > cellSize || boxes.height[other] > cellSize;
+            if (other == index || (otherOversize && other < index)) {
+                continue;
+            }
+            emitPair<true>(index, other, outPairs, filtered);
+        }
+    }
+}
+
+void SpatialHashGrid::findCandidatePairs(ArenaVector<CollisionPair>& outPairs) {
+    const size_t layerPairCount = collisionLayerCount * collisionLayerCount;
+    if (countFiltered) {
+        filteredCounts.assign(layerPairCount, 0);
+    }
+    uint32_t* filtered = countFiltered ? filteredCounts.data() : nullptr;
+    findGridPairs(0, static_cast<uint32_t>(entries.size()), outPairs, filtered);
+    if (!oversize.empty()) {
+        oversizeHits.resize(boxes.count);
+        findOversizePairs(0, oversize.size(), outPairs, filtered, oversizeHits.data());
+    }
+}
+
+void SpatialHashGrid::findCandidatePairs(JobSystem& jobs, ArenaVector<CollisionPair>& outPairs) {
+    // Grid chunks first, then up to maxOversizeChunks chunks of oversize boxes, all in one batch
+    const size_t grain = 2048;
+    const size_t gridChunks = JobSystem::chunkCount(entries.size(), grain);
+    const size_t maxOversizeChunks = 16;
+    const size_t oversizeGrain = std::max<size_t>(1, (oversize.size() + maxOversizeChunks - 1) / maxOversizeChunks);
+    const size_t chunks = gridChunks + JobSystem::chunkCount(oversize.size(), oversizeGrain);
+    if (chunkPairs.size() < chunks) {
+        chunkPairs.resize(chunks, ArenaVector<CollisionPair>(ArenaAllocator<CollisionPair>(arena)));
+    }
+    if (chunkPairCounts.size() < chunks) {
+        chunkPairCounts.resize(chunks, 0);
+    }
+    const size_t layerPairCount = collisionLayerCount * collisionLayerCount;
+    if (countFiltered) {
+        filteredCounts.assign(std::max<size_t>(chunks, 1) * layerPairCount, 0);
+    }
+    jobs.parallelFor(chunks, 1, [this, grain, gridChunks, oversizeGrain, layerPairCount](size_t chunk, size_t, size_t,
+        unsigned) {
+        // Scenes change little between steps; sizing from the last one saves regrowing every list
+        chunkPairs[chunk].clear();
+        chunkPairs[chunk].reserve(chunkPairCounts[chunk] + chunkPairCounts[chunk] / 8);
+        uint32_t* filtered = countFiltered ? filteredCounts.data() + chunk * layerPairCount : nullptr;
+        if (chunk < gridChunks) {
+            const size_t begin = chunk * grain;
+            const size_t end = std::min(entries.size(), begin + grain);
+            findGridPairs(static_cast<uint32_t>(begin), static_cast<uint32_t>(end), chunkPairs[chunk], filtered);
+        }
+        else {
+            const size_t oversizeChunk = chunk - gridChunks;
+            const size_t begin = oversizeChunk * oversizeGrain;
+            const size_t end = std::min(oversize.size(), begin + oversizeGrain);
+            // Hits scratch of its own, straight from the arena: nothing reads it before the kernel writes it
+            uint32_t* hits = static_cast<uint32_t*>(arena->allocate(boxes.count * sizeof(uint32_t), alignof(uint32_t)));
+            findOversizePairs(begin, end, chunkPairs[chunk], filtered, hits);
+        }
+        chunkPairCounts[chunk] = chunkPairs[chunk].size();
+    });
+    if (countFiltered) {
+        for (size_t c = 1; c < chunks; c++) {
+            for (size_t p = 0; p < layerPairCount; p++) {
+                filteredCounts[p] += filteredCounts[c * layerPairCount + p];
+            }
+        }
+        filteredCounts.resize(layerPairCount);
+    }
+
+    // Each chunk copies its list to its offset in the joined list
+    chunkPairOffsets.resize(chunks + 1);
+    chunkPairOffsets[0] = outPairs.size();
+    for (size_t c = 0; c < chunks; c++) {
+        chunkPairOffsets[c + 1] = chunkPairOffsets[c] + chunkPairs[c].size();
+    }
+    outPairs.resize(chunkPairOffsets[chunks]);
+    jobs.parallelFor(chunks, 1, [this, &outPairs](size_t chunk, size_t, size_t, unsigned) {
+        std::copy(chunkPairs[chunk].begin(), chunkPairs[chunk].end(), outPairs.begin() + chunkPairOffsets[chunk]);
+    });
+}
@@ -0,0 +1,490 @@
+#pragma once
+
+#include "Collision.h"
+#include "FrameArena.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Uniform-grid broadphase. Each box is binned once, by the cell holding its min corner, and the
+// boxes are counting-sorted by bucket. Rebuilt from scratch every frame. When the occupied cells fit
+// the bucket table, every cell gets a bucket of its own in row order, so a cell's forward neighbours
+// are the next buckets along and the row above. Otherwise the cells are hashed: worlds wider than
+// rowStride cells alias rows onto the same buckets, which costs extra cell comparisons but never
+// correctness.
+class SpatialHashGrid {
+public:
+    explicit SpatialHashGrid(float size = 0.5f);
+
+    // Cell size should be at least the size of a typical body. Boxes wider or taller than a cell
+    // skip the grid and are tested against every box with the batch kernel instead.
+    void setCellSize(float size);
+    float getCellSize() const { return cellSize; }
+
+    // Bins every box in `newBoxes`, with each box's collision layers from `categories` and `masks`
+    // (one entry per box). The view and arrays must stay valid until findCandidatePairs is done. The
+    // grid's scratch arrays come from `arena`, so query it before the arena is next reset.
+    void build(const AabbSoAView& newBoxes, const uint32_t* categories, const uint32_t* masks, FrameArena& arena);
+    // Same grid, entry for entry, with the passes over the boxes split across the job system's threads
+    void build(JobSystem& jobs, const AabbSoAView& newBoxes, const uint32_t* categories, const uint32_t* masks,
+        FrameArena& arena);
+    // Drops the scratch arrays; call before resetting the arena they came from
+    void releaseScratch();
+
+    // Appends each pair of boxes in the same or adjacent cells exactly once, with a < b. Pairs whose
+    // layers don't collide are dropped here, before anything else looks at them.
+    void findCandidatePairs(ArenaVector<CollisionPair>& outPairs);
+    // Same pairs in the same order, with the grid cells and the oversize boxes split across the job
+    // system's threads. Each chunk fills its own list and the lists are joined in chunk order.
+    void findCandidatePairs(JobSystem& jobs, ArenaVector<CollisionPair>& outPairs);
+
+    size_t getOversizeCount() const { return oversize.size(); }
+
+    // Calls callback(index) for every box binned in a cell it could reach `box` from, after every
+    // oversize box. A superset of the boxes overlapping `box`; the caller does the exact test.
+    template <typename Callback>
+    void query(const Aabb& box, Callback callback) const;
+
+    // Walks the cells along origin + direction * t, t in [0, maxTime], nearest first, and calls
+    // callback(index, maxTime) once for every box binned where the walk could reach it, after every
+    // oversize box. The callback returns the time the walk may stop at, usually its nearest hit so
+    // far, so the walk ends at the first cell that can't hold anything nearer. A box cast walks the
+    // cast box's min corner with its size as the extent; a ray has none. Reads the last build's
+    // grid only, so it stays usable until the scratch arrays are released.
+    template <typename Callback>
+    void castThrough(float originX, float originY, float directionX, float directionY, float maxTime,
+        float extentX, float extentY, Callback callback) const;
+
+    // Walks the cells under a packet of rays outwards from the origins, each ray about two cells
+    // further per slice, calling callback(index) for every box binned where a slice could reach it,
+    // after every oversize box. The callback records hits in the packet; a ray drops out once its
+    // nearest hit comes before its next slice, and the walk ends when every ray has or has left the
+    // grid. Only cells near some ray are walked, and a box rarely comes up twice.
+    template <typename Callback>
+    void castPacket(const RayPacket& packet, Callback callback) const;
+
+    // Counts the pairs the layers drop, per layer pair. Off by default: the threaded search needs a
+    // table per chunk to count without locks.
+    void setCountFiltered(bool enabled) { countFiltered = enabled; }
+    // Pairs dropped in the last search, indexed by layerPairIndex; null unless counting
+    const uint32_t* getFilteredCounts() const { return countFiltered ? filteredCounts.data() : nullptr; }
+
+private:
+    struct Cell {
+        int32_t x;
+        int32_t y;
+    };
+
+    // Cells castPacket walked in this slice or the one before. Slots are stamped with their slice
+    // instead of being cleared between slices, and only cleared at all once a packet needs them;
+    // older ones count as free. A probe that finds no room just walks the cell again, which repeats
+    // callbacks but never misses a box.
+    struct WalkedCells {
+        struct Slot {
+            Cell cell;
+            uint32_t slice;
+        };
+        static const uint32_t slotCount = 1024;  // two slices of 16 spread-out lanes, with room to spare
+        static const uint32_t maxProbes = 8;
+
+        Slot slots[slotCount];
+        uint32_t slice;
+        bool cleared;
+
+        WalkedCells() : slice(2), cleared(false) {}
+        void nextSlice() { slice++; }
+        // True unless the cell was already walked in this slice or the one before
+        bool firstVisit(int32_t x, int32_t y) {
+            if (!cleared) {
+                for (uint32_t i = 0; i < slotCount; i++) {
+                    slots[i].slice = 0;
+                }
+                cleared = true;
+            }
+            const uint32_t hash = static_cast<uint32_t>(x) * 0x9E3779B1u ^ static_cast<uint32_t>(y) * 0x85EBCA77u;
+            for (uint32_t probe = 0; probe < maxProbes; probe++) {
+                Slot& slot = slots[(hash + probe) & (slotCount - 1)];
+                if (slot.slice + 1 < slice) {
+                    slot.cell.x = x;
+                    slot.cell.y = y;
+                    slot.slice = slice;
+                    return true;
+                }
+                if (slot.cell.x == x && slot.cell.y == y) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    // Entries pack the box index above two bits saying whether the box crosses into the next
+    // cell on each axis; a key packs the bucket under those bits the other way up
+    static uint32_t entryIndex(uint32_t entry) { return entry >> 2; }
+    static bool entryCrossesX(uint32_t entry) { return (entry & 1u) != 0; }
+    static bool entryCrossesY(uint32_t entry) { return (entry & 2u) != 0; }
+    static const uint32_t bucketBits = (1u << 30) - 1;
+    static const uint32_t noBucket = 0xFFFFFFFFu;
+    // Ranges of buckets the threaded build sorts the boxes into before sorting each range on its own
+    static const uint32_t buildRangeCount = 64;
+    // Whether entry j is binned in the cell; only a hashed layout lets other cells share its bucket
+    bool entryInCell(uint32_t j, int32_t cellX, int32_t cellY) const {
+        return dense || (entryCells[j].x == cellX && entryCells[j].y == cellY);
+    }
+
+    struct BoxBounds {
+        float lowCornerX;
+        float lowCornerY;
+        float highCornerX;
+        float highCornerY;
+        int32_t lowX;  // cells, only filled in when the corners aren't simple
+        int32_t lowY;
+        int32_t highX;
+        int32_t highY;
+        bool simple;
+        bool anyFiltered;
+
+        void merge(const BoxBounds& other);
+    };
+
+    void bindScratch(FrameArena& frameArena);
+    BoxBounds scanBoxes(size_t begin, size_t end) const;
+    void scanCells(size_t begin, size_t end, BoxBounds& bounds) const;
+    uint32_t chooseLayout(BoxBounds bounds);
+    uint32_t entryKey(size_t i) const;
+    void placeEntry(uint32_t slot, uint32_t i, uint32_t key);
+    void resizeEntries(size_t binnedCount);
+    template <typename Callback>
+    void walkCell(int32_t cellX, int32_t cellY, Callback& callback) const;
+    int32_t cellCoord(float value) const;
+    int32_t clampedCellCoord(float value, int32_t low, int32_t high) const;
+    uint32_t bucketFor(int32_t cellX, int32_t cellY) const;
+    // Filter is false when every pair collides, so the common unlayered scene pays nothing for layers
+    template <bool Filter>
+    bool layersPass(uint32_t a, uint32_t b, uint32_t* filtered) const;
+    template <bool Filter>
+    void emitPair(uint32_t a, uint32_t b, ArenaVector<CollisionPair>& outPairs, uint32_t* filtered) const;
+    template <bool Filter>
+    void emitCellPairs(uint32_t e, int32_t cellX, int32_t cellY, bool crossingOnly,
+        ArenaVector<CollisionPair>& outPairs, uint32_t* filtered) const;
+    template <bool Filter>
+    void findSparsePairs(uint32_t begin, uint32_t end, ArenaVector<CollisionPair>& outPairs, uint32_t* filtered) const;
+    template <bool Filter>
+    void findDensePairs(uint32_t begin, uint32_t end, ArenaVector<CollisionPair>& outPairs, uint32_t* filtered) const;
+    void findGridPairs(uint32_t begin, uint32_t end, ArenaVector<CollisionPair>& outPairs, uint32_t* filtered) const;
+    void findOversizePairs(size_t begin, size_t end, ArenaVector<CollisionPair>& outPairs, uint32_t* filtered,
+        uint32_t* hits) const;
+
+    float cellSize;
+    float inverseCellSize;
+    uint32_t bucketMask;
+    uint32_t rowStride;
+    int32_t originX;  // cell at bucket 0, before the mask
+    int32_t originY;
+    bool dense;  // every occupied cell and its forward neighbours have a bucket of their own
+    AabbSoAView boxes;
+    const uint32_t* categories;
+    const uint32_t* masks;
+    bool filtering;  // some pair of boxes may not collide; otherwise the layers are never looked at
+    int32_t minCellX;  // cells holding the grid entries, for clipping queries
+    int32_t minCellY;
+    int32_t maxCellX;
+    int32_t maxCellY;
+    FrameArena* arena;  // where this step's scratch arrays live
+    bool countFiltered;
+
+    ArenaVector<uint32_t> entryKeys;     // per box, in box order
+    ArenaVector<uint32_t> entries;       // grouped by bucket
+    ArenaVector<uint32_t> entryBuckets;  // bucket of each entry; only kept for the dense layout
+    ArenaVector<Cell> entryCells;        // cell of each entry; only kept for the hashed layout
+    ArenaVector<uint32_t> bucketStarts;  // bucket i owns entries[bucketStarts[i], bucketStarts[i + 1])
+    ArenaVector<uint32_t> oversize;      // boxes larger than a cell
+    ArenaVector<uint32_t> oversizeHits;
+    ArenaVector<uint32_t> rangeBoxes;    // the threaded build's boxes, grouped by range of buckets
+    ArenaVector<uint32_t> rangeOffsets;  // and where each chunk of boxes writes each range
+    ArenaVector<ArenaVector<CollisionPair> > chunkPairs;  // per-chunk output of the threaded search
+    std::vector<size_t> chunkPairCounts;  // last search's pairs per chunk, to size this one's lists
+    std::vector<size_t> chunkPairOffsets;  // where each chunk's list goes in the joined list
+    ArenaVector<uint32_t> filteredCounts;  // one layer pair table per chunk, folded into the first
+};
+
+template <typename Callback>
+void SpatialHashGrid::query(const Aabb& box, Callback callback) const {
+    for (size_t k = 0; k < oversize.size(); k++) {
+        callback(oversize[k]);
+    }
+    if (entries.empty()) {
+        return;
+    }
+
+    // A grid box reaches at most one cell up and right of the cell holding its min corner
+    const int32_t lowX = clampedCellCoord(box.x, minCellX - 1, maxCellX + 1) - 1;
+    const int32_t lowY = clampedCellCoord(box.y, minCellY - 1, maxCellY + 1) - 1;
+    const int32_t highX = clampedCellCoord(box.x + box.width, minCellX - 1, maxCellX + 1);
+    const int32_t highY = clampedCellCoord(box.y + box.height, minCellY - 1, maxCellY + 1);
+    if (highX < lowX || highY < lowY) {
+        return;
+    }
+    const int64_t cellCount = (static_cast<int64_t>(highX) - lowX + 1) * (static_cast<int64_t>(highY) - lowY + 1);
+    // Past one cell per box, listing every box is cheaper than visiting the cells
+    if (cellCount > static_cast<int64_t>(entries.size())) {
+        for (size_t j = 0; j < entries.size(); j++) {
+            callback(entryIndex(entries[j]));
+        }
+        return;
+    }
+    for (int32_t binY = std::max(lowY, minCellY); binY <= std::min(highY, maxCellY); binY++) {
+        for (int32_t binX = std::max(lowX, minCellX); binX <= std::min(highX, maxCellX); binX++) {
+            const uint32_t bucket = bucketFor(binX, binY);
+            const uint32_t end = bucketStarts[bucket + 1];
+            for (uint32_t j = bucketStarts[bucket]; j < end; j++) {
+                if (entryInCell(j, binX, binY)) {
+                    callback(entryIndex(entries[j]));
+                }
+            }
+        }
+    }
+}
+
+template <typename Callback>
+void SpatialHashGrid::castThrough(float originX, float originY, float directionX, float directionY, float maxTime,
+    float extentX, float extentY, Callback callback) const {
+    // Oversize boxes are few, and a big one close by cuts the walk short
+    for (size_t k = 0; k < oversize.size(); k++) {
+        maxTime = callback(oversize[k], maxTime);
+    }
+    if (entries.empty()) {
+        return;
+    }
+
+    // A grid box is binned by its min corner and reaches at most one cell further up and right, so
+    // from the walked point's cell C a cast can only reach boxes binned from C - 1 to C + reach
+    const int32_t reachX = static_cast<int32_t>(std::ceil(extentX * inverseCellSize));
+    const int32_t reachY = static_cast<int32_t>(std::ceil(extentY * inverseCellSize));
+
+    // Clip the walk to the cells with something in reach, which also bounds an infinite maxTime
+    const float inverseX = rayInverse(directionX);
+    const float inverseY = rayInverse(directionY);
+    const float x1 = (static_cast<float>(minCellX - reachX) * cellSize - originX) * inverseX;
+    const float x2 = (static_cast<float>(maxCellX + 2) * cellSize - originX) * inverseX;
+    const float y1 = (static_cast<float>(minCellY - reachY) * cellSize - originY) * inverseY;
+    const float y2 = (static_cast<float>(maxCellY + 2) * cellSize - originY) * inverseY;
+    float time = std::max(std::max(std::min(x1, x2), std::min(y1, y2)), 0.0f);
+    const float exit = std::min(std::max(x1, x2), std::max(y1, y2));
+    // An infinite entry time is a cast that never gets there: one that doesn't move and starts
+    // outside, or one so slow the distance overflows
+    const float infinity = std::numeric_limits<float>::infinity();
+    if (time > exit || !(time < infinity)) {
+        return;
+    }
+
+    // Grid walk: step into whichever neighbouring cell the ray reaches first
+    int32_t cellX = cellCoord(originX + directionX * time);
+    int32_t cellY = cellCoord(originY + directionY * time);
+    const int32_t stepX = inverseX == std::numeric_limits<float>::max() ? 0 : (directionX > 0.0f ? 1 : -1);
+    const int32_t stepY = inverseY == std::numeric_limits<float>::max() ? 0 : (directionY > 0.0f ? 1 : -1);
+    float nextX = stepX == 0 ? infinity : (static_cast<float>(cellX + (stepX > 0 ? 1 : 0)) * cellSize - originX) * inverseX;
+    float nextY = stepY == 0 ? infinity : (static_cast<float>(cellY + (stepY > 0 ? 1 : 0)) * cellSize - originY) * inverseY;
+    const float deltaX = cellSize * std::abs(inverseX);
+    const float deltaY = cellSize * std::abs(inverseY);
+    // A cast that doesn't move sees only what is in reach of its origin's cell; stepping would
+    // never get past it, even to an infinite maxTime
+    const bool still = stepX == 0 && stepY == 0;
+
+    bool first = true;
+    int32_t lastX = 0;
+    int32_t lastY = 0;
+    while (time <= exit && time <= maxTime) {
+        for (int32_t binY = std::max(cellY - 1, minCellY); binY <= std::min(cellY + reachY, maxCellY); binY++) {
+            for (int32_t binX = std::max(cellX - 1, minCellX); binX <= std::min(cellX + reachX, maxCellX); binX++) {
+                // The cells the walk reaches a box from are a rectangle the walk crosses once, so
+                // anything the previous cell could reach was reported there
+                if (!first && binX >= lastX - 1 && binX <= lastX + reachX && binY >= lastY - 1 && binY <= lastY + reachY) {
+                    continue;
+                }
+                const uint32_t bucket = bucketFor(binX, binY);
+                const uint32_t end = bucketStarts[bucket + 1];
+                for (uint32_t j = bucketStarts[bucket]; j < end; j++) {
+                    if (entryInCell(j, binX, binY)) {
+                        maxTime = callback(entryIndex(entries[j]), maxTime);
+                    }
+                }
+            }
+        }
+        if (still) {
+            return;
+        }
+        first = false;
+        lastX = cellX;
+        lastY = cellY;
+        if (nextX < nextY) {
+            cellX += stepX;
+            time = nextX;
+            nextX += deltaX;
+        }
+        else {
+            cellY += stepY;
+            time = nextY;
+            nextY += deltaY;
+        }
+        // Moved past every cell with something in reach; the times can stop growing when the
+        // origin is far off, but the cells never do. The entry cell may round to just outside, so
+        // only leaving counts.
+        if ((stepX > 0 && cellX > maxCellX + 1) || (stepX < 0 && cellX < minCellX - reachX)
+            || (stepY > 0 && cellY > maxCellY + 1) || (stepY < 0 && cellY < minCellY - reachY)) {
+            return;
+        }
+    }
+}
+
+template <typename Callback>
+void SpatialHashGrid::castPacket(const RayPacket& packet, Callback callback) const {
+    for (size_t k = 0; k < oversize.size(); k++) {
+        callback(oversize[k]);
+    }
+    if (entries.empty()) {
+        return;
+    }
+
+    // Each ray's stretch inside the cells a grid box can reach from, as in castThrough
+    const float lowX = static_cast<float>(minCellX) * cellSize;
+    const float lowY = static_cast<float>(minCellY) * cellSize;
+    const float highX = static_cast<float>(maxCellX + 2) * cellSize;
+    const float highY = static_cast<float>(maxCellY + 2) * cellSize;
+    float enter[rayPacketSize];
+    float leave[rayPacketSize];
+    float slice[rayPacketSize];
+    const float infinity = std::numeric_limits<float>::infinity();
+    for (size_t lane = 0; lane < packet.count; lane++) {
+        const float x1 = (lowX - packet.originX[lane]) * packet.inverseX[lane];
+        const float x2 = (highX - packet.originX[lane]) * packet.inverseX[lane];
+        const float y1 = (lowY - packet.originY[lane]) * packet.inverseY[lane];
+        const float y2 = (highY - packet.originY[lane]) * packet.inverseY[lane];
+        enter[lane] = std::max(std::max(std::min(x1, x2), std::min(y1, y2)), 0.0f);
+        leave[lane] = std::min(std::max(x1, x2), std::max(y1, y2));
+        // Each ray's slices advance it two cells, which measured faster than one, so rays of
+        // different speeds all cross the grid in a bounded number of slices. A ray that doesn't
+        // move (as castThrough judges it) only ever sees the boxes around its origin, in one slice.
+        const bool still = packet.inverseX[lane] == std::numeric_limits<float>::max()
+            && packet.inverseY[lane] == std::numeric_limits<float>::max();
+        if (still) {
+            leave[lane] = std::min(leave[lane], enter[lane]);
+        }
+        if (!(enter[lane] < infinity)) {
+            // Never gets there, as in castThrough
+            leave[lane] = -infinity;
+        }
+        slice[lane] = still ? infinity
+            : 2.0f * cellSize / std::max(std::abs(packet.directionX[lane]), std::abs(packet.directionY[lane]));
+    }
+    // Rounding in the slice ends must never lose the cell a hit point is in
+    const float pad = cellSize * 0.01f;
+
+    // Per slice, each lane reaches a rectangle of cells. Lanes heading the same way share most of
+    // theirs, and walking the rectangle around them all is cheapest; once they spread out, that
+    // rectangle is mostly cells no lane is near, so each lane walks its own and cells the packet has
+    // already walked are skipped. Cells walked in the slice before are skipped too, unless the
+    // packet has just switched between the two, which costs repeat callbacks and nothing else.
+    float segmentLowX[rayPacketSize];
+    float segmentLowY[rayPacketSize];
+    float segmentHighX[rayPacketSize];
+    float segmentHighY[rayPacketSize];
+    WalkedCells walked;
+    bool lastUnion = false;
+    int32_t lastFromX = 0;
+    int32_t lastFromY = 0;
+    int32_t lastToX = 0;
+    int32_t lastToY = 0;
+    for (size_t k = 0; ; k++) {
+        float minX = infinity;
+        float minY = infinity;
+        float maxX = -infinity;
+        float maxY = -infinity;
+        // Cells the lanes' own rectangles cover, roughly; a rectangle reaches a cell past each end
+        float laneCells = 0.0f;
+        for (size_t lane = 0; lane < packet.count; lane++) {
+            // Slice ends come from k afresh rather than adding up, so they always move on
+            const float first = k == 0 ? enter[lane] : enter[lane] + static_cast<float>(k) * slice[lane];
+            const float to = enter[lane] + static_cast<float>(k + 1) * slice[lane];
+            const float last = std::min(std::min(to, leave[lane]), packet.time[lane]);
+            if (!(first <= last)) {
+                segmentLowX[lane] = infinity;
+                continue;
+            }
+            const float x1 = packet.originX[lane] + (packet.directionX[lane] != 0.0f ? packet.directionX[lane] * first : 0.0f);
+            const float x2 = packet.originX[lane] + (packet.directionX[lane] != 0.0f ? packet.directionX[lane] * last : 0.0f);
+            const float y1 = packet.originY[lane] + (packet.directionY[lane] != 0.0f ? packet.directionY[lane] * first : 0.0f);
+            const float y2 = packet.originY[lane] + (packet.directionY[lane] != 0.0f ? packet.directionY[lane] * last : 0.0f);
+            segmentLowX[lane] = std::min(x1, x2) - pad;
+            segmentLowY[lane] = std::min(y1, y2) - pad;
+            segmentHighX[lane] = std::max(x1, x2) + pad;
+            segmentHighY[lane] = std::max(y1, y2) + pad;
+            minX = std::min(minX, segmentLowX[lane]);
+            minY = std::min(minY, segmentLowY[lane]);
+            maxX = std::max(maxX, segmentHighX[lane]);
+            maxY = std::max(maxY, segmentHighY[lane]);
+            laneCells += ((segmentHighX[lane] - segmentLowX[lane]) * inverseCellSize + 3.0f) * ((segmentHighY[lane] - segmentLowY[lane]) * inverseCellSize + 3.0f);
+        }
+        if (minX > maxX) {
+            return;
+        }
+
+        const float unionCells = ((maxX - minX) * inverseCellSize + 3.0f) * ((maxY - minY) * inverseCellSize + 3.0f);
+        const bool walkUnion = unionCells <= laneCells;
+        // Boxes reaching into the slice are binned from one cell before its min corner's cell
+        const int32_t fromX = std::max(clampedCellCoord(minX, minCellX, maxCellX + 1) - 1, minCellX);
+        const int32_t fromY = std::max(clampedCellCoord(minY, minCellY, maxCellY + 1) - 1, minCellY);
+        const int32_t toX = clampedCellCoord(maxX, minCellX - 1, maxCellX);
+        const int32_t toY = clampedCellCoord(maxY, minCellY - 1, maxCellY);
+        if (walkUnion) {
+            for (int32_t binY = fromY; binY <= toY; binY++) {
+                for (int32_t binX = fromX; binX <= toX; binX++) {
+                    if (lastUnion && binX >= lastFromX && binX <= lastToX && binY >= lastFromY && binY <= lastToY) {
+                        continue;
+                    }
+                    walkCell(binX, binY, callback);
+                }
+            }
+        }
+        else {
+            for (size_t lane = 0; lane < packet.count; lane++) {
+                if (segmentLowX[lane] == infinity) {
+                    continue;
+                }
+                const int32_t laneFromX = std::max(clampedCellCoord(segmentLowX[lane], minCellX, maxCellX + 1) - 1, minCellX);
+                const int32_t laneFromY = std::max(clampedCellCoord(segmentLowY[lane], minCellY, maxCellY + 1) - 1, minCellY);
+                const int32_t laneToX = clampedCellCoord(segmentHighX[lane], minCellX - 1, maxCellX);
+                const int32_t laneToY = clampedCellCoord(segmentHighY[lane], minCellY - 1, maxCellY);
+                for (int32_t binY = laneFromY; binY <= laneToY; binY++) {
+                    for (int32_t binX = laneFromX; binX <= laneToX; binX++) {
+                        if (walked.firstVisit(binX, binY)) {
+                            walkCell(binX, binY, callback);
+                        }
+                    }
+                }
+            }
+        }
+        lastUnion = walkUnion;
+        lastFromX = fromX;
+        lastFromY = fromY;
+        lastToX = toX;
+        lastToY = toY;
+        walked.nextSlice();
+    }
+}
+
+// Calls callback(index) for every box binned in the cell
+template <typename Callback>
+void SpatialHashGrid::walkCell(int32_t cellX, int32_t cellY, Callback& callback) const {
+    const uint32_t bucket = bucketFor(cellX, cellY);
+    const uint32_t end = bucketStarts[bucket + 1];
+    for (uint32_t j = bucketStarts[bucket]; j < end; j++) {
+        if (entryInCell(j, cellX, cellY)) {
+            callback(entryIndex(entries[j]));
+        }
+    }
+}
@@ -0,0 +1,196 @@
+#include "SweepAndPrune.h"
+
+#include <algorithm>
+
+namespace {
+
+// Endpoint order used on both axes. Equal values put mins before maxes so touching boxes
+// count as overlapping, matching checkCollision.
+template <typename Endpoint>
+inline bool endpointLess(const Endpoint& a, const Endpoint& b) {
+    return a.value < b.value || (a.value == b.value && !a.isMax && b.isMax);
+}
+
+} // namespace
+
+uint64_t SweepAndPrune::pairKey(uint32_t a, uint32_t b) {
+    return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+}
+
+uint32_t SweepAndPrune::addBox(const Aabb& box) {
+    uint32_t id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+        boxes.x[id] = box.x;
+        boxes.y[id] = box.y;
+        boxes.width[id] = box.width;
+        boxes.height[id] = box.height;
+    }
+    else {
+        id = static_cast<uint32_t>(boxes.size());
+        boxes.push(box.x, box.y, box.width, box.height);
+        const EndpointIndex unplaced = { { 0, 0 } };
+        endpointIndex[0].push_back(unplaced);
+        endpointIndex[1].push_back(unplaced);
+    }
+
+    // New endpoints go on the end of each axis. By list order the box overlaps nothing yet,
+    // which matches the pair set; the next sort moves it into place and reports its pairs.
+    const float mins[2] = { box.x, box.y };
+    const float maxs[2] = { box.x + box.width, box.y + box.height };
+    for (int axis = 0; axis < 2; axis++) {
+        Endpoint minEndpoint = { mins[axis], id, 0 };
+        Endpoint maxEndpoint = { maxs[axis], id, 1 };
+        endpointIndex[axis][id].position[0] = static_cast<uint32_t>(endpoints[axis].size());
+        endpoints[axis].push_back(minEndpoint);
+        endpointIndex[axis][id].position[1] = static_cast<uint32_t>(endpoints[axis].size());
+        endpoints[axis].push_back(maxEndpoint);
+    }
+    return id;
+}
+
+void SweepAndPrune::removeBox(uint32_t id) {
+    // Its pairs are the boxes it overlaps on both axes by list position; every other box has one
+    // min endpoint in the x list. Sweeping the box out instead would pass it over boxes it never
+    // touched and report them as added and removed again.
+    const std::vector<Endpoint>& xList = endpoints[0];
+    for (size_t i = 0; i < xList.size(); i++) {
+        const uint32_t other = xList[i].box;
+        if (!xList[i].isMax && other != id && overlapsOnAxis(id, other, 0) && overlapsOnAxis(id, other, 1)) {
+            removePair(id, other);
+        }
+    }
+
+    // Cut its endpoints out; everything after the min moves down
+    for (int axis = 0; axis < 2; axis++) {
+        std::vector<Endpoint>& list = endpoints[axis];
+        const uint32_t first = endpointIndex[axis][id].position[0];
+        list.erase(list.begin() + endpointIndex[axis][id].position[1]);
+        list.erase(list.begin() + first);
+        for (uint32_t i = first; i < list.size(); i++) {
+            endpointIndex[axis][list[i].box].position[list[i].isMax] = i;
+        }
+    }
+    freeIds.push_back(id);
+}
+
+void SweepAndPrune::moveBox(uint32_t id, const Aabb& box) {
+    boxes.x[id] = box.x;
+    boxes.y[id] = box.y;
+    boxes.width[id] = box.width;
+    boxes.height[id] = box.height;
+    endpoints[0][endpointIndex[0][id].position[0]].value = box.x;
+    endpoints[0][endpointIndex[0][id].position[1]].value = box.x + box.width;
+    endpoints[1][endpointIndex[1][id].position[0]].value = box.y;
+    endpoints[1][endpointIndex[1][id].position[1]].value = box.y + box.height;
+}
+
+void SweepAndPrune::update() {
+    const size_t firstEvent = events.size();
+    sortAxis(0);
+    sortAxis(1);
+    dropCancelledEvents(firstEvent);
+}
+
+void SweepAndPrune::dropCancelledEvents(size_t first) {
+    const size_t count = events.size() - first;
+    if (count < 2) {
+        return;
+    }
+    // Group the events by pair, in the order they came within each pair. A pair's events alternate
+    // between added and removed, so an even number of them cancel out and an odd number leave the
+    // first one standing.
+    eventOrder.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        eventOrder[i] = static_cast<uint32_t>(first + i);
+    }
+    const std::vector<PairEvent>& list = events;
+    std::sort(eventOrder.begin(), eventOrder.end(), [&list](uint32_t a, uint32_t b) {
+        const uint64_t keyA = pairKey(list[a].a, list[a].b);
+        const uint64_t keyB = pairKey(list[b].a, list[b].b);
+        return keyA < keyB || (keyA == keyB && a < b);
+    });
+    keptEvents.assign(count, 0);
+    for (size_t i = 0; i < count;) {
+        const uint64_t key = pairKey(events[eventOrder[i]].a, events[eventOrder[i]].b);
+        size_t end = i + 1;
+        while (end < count && pairKey(events[eventOrder[end]].a, events[eventOrder[end]].b) == key) {
+            end++;
+        }
+        if ((end - i) % 2 != 0) {
+            keptEvents[eventOrder[i] - first] = 1;
+        }
+        i = end;
+    }
+
+    // Compact the survivors in the order the sort reported them
+    size_t kept = first;
+    for (size_t i = 0; i < count; i++) {
+        if (keptEvents[i]) {
+            events[kept++] = events[first + i];
+        }
+    }
+    events.resize(kept);
+}
+
+bool SweepAndPrune::overlapsOnAxis(uint32_t a, uint32_t b, int axis) const {
+    // Compares list positions rather than values, so the answer is consistent with the
+    // pair set even while the other axis still has unsorted endpoints
+    return endpointIndex[axis][a].position[0] < endpointIndex[axis][b].position[1] &&
+        endpointIndex[axis][b].position[0] < endpointIndex[axis][a].position[1];
+}
+
+void SweepAndPrune::sortAxis(int axis) {
+    std::vector<Endpoint>& list = endpoints[axis];
+    const int otherAxis = 1 - axis;
+
+    for (size_t i = 1; i < list.size(); i++) {
+        const Endpoint moving = list[i];
+        size_t j = i;
+        while (j > 0 && endpointLess(moving, list[j - 1])) {
+            const Endpoint passed = list[j - 1];
+            if (moving.box != passed.box) {
+                if (!moving.isMax && passed.isMax) {
+                    // A min moved below another box's max: they start overlapping on this axis
+                    if (overlapsOnAxis(moving.box, passed.box, otherAxis)) {
+                        addPair(moving.box, passed.box);
+                    }
+                }
+                else if (moving.isMax && !passed.isMax) {
+                    // A max moved below another box's min: they stop overlapping. Only pairs that
+                    // overlap on the other axis can be in the set, which skips most hash lookups.
+                    if (overlapsOnAxis(moving.box, passed.box, otherAxis)) {
+                        removePair(moving.box, passed.box);
+                    }
+                }
+            }
+            list[j] = passed;
+            endpointIndex[axis][passed.box].position[passed.isMax] = static_cast<uint32_t>(j);
+            j--;
+        }
+        list[j] = moving;
+        endpointIndex[axis][moving.box].position[moving.isMax] = static_cast<uint32_t>(j);
+    }
+}
+
+void SweepAndPrune::addPair(uint32_t a, uint32_t b) {
+    if (pairs.insert(pairKey(a, b)).second) {
+        PairEvent event = { std::min(a, b), std::max(a, b), PairEvent::Added };
+        events.push_back(event);
+    }
+}
+
+void SweepAndPrune::removePair(uint32_t a, uint32_t b) {
+    if (pairs.erase(pairKey(a, b)) != 0) {
+        PairEvent event = { std::min(a, b), std::max(a, b), PairEvent::Removed };
+        events.push_back(event);
+    }
+}
+
+void SweepAndPrune::getPairs(std::vector<CollisionPair>& outPairs) const {
+    for (std::unordered_set<uint64_t>::const_iterator it = pairs.begin(); it != pairs.end(); ++it) {
+        CollisionPair pair = { static_cast<uint32_t>(*it >> 32), static_cast<uint32_t>(*it & 0xFFFFFFFFu) };
+        outPairs.push_back(pair);
+    }
+}
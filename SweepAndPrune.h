@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Collision.h"
+
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+// Change to the overlapping pair set reported by SweepAndPrune::update
+struct PairEvent {
+    enum Type : uint8_t {
+        Added,
+        Removed
+    };
+
+    uint32_t a;
+    uint32_t b;
+    Type type;
+};
+
+// Incremental sweep-and-prune broadphase. Box endpoints stay sorted on both axes across frames
+// and are repaired with insertion sort, so a frame where little moves costs close to O(n).
+// Every swap of a min past a max flips that pair's overlap on one axis, which is turned into
+// pair add/remove events instead of rescanning.
+class SweepAndPrune {
+public:
+    // Returns a box id; ids of removed boxes are reused
+    uint32_t addBox(const Aabb& box);
+    void removeBox(uint32_t id);
+
+    // Stores the new bounds; the sorted axes are repaired on the next update()
+    void moveBox(uint32_t id, const Aabb& box);
+
+    // Re-sorts both axes and appends the resulting pair changes to the event list, one per pair
+    // whose overlap changed since the last update; removed boxes report their pairs straight away
+    void update();
+
+    const std::vector<PairEvent>& getEvents() const { return events; }
+    void clearEvents() { events.clear(); }
+
+    // Appends every currently overlapping pair (a < b)
+    void getPairs(std::vector<CollisionPair>& outPairs) const;
+    size_t getPairCount() const { return pairs.size(); }
+
+    // Bounds indexed by box id, for feeding pairs to filterCollidingPairs
+    AabbSoAView getBoxes() const { return boxes.view(); }
+
+private:
+    struct Endpoint {
+        float value;
+        uint32_t box : 31;
+        uint32_t isMax : 1;
+    };
+
+    // Positions of one box's min and max endpoints in an axis list, kept together so the
+    // overlap test touches one cache line per box
+    struct EndpointIndex {
+        uint32_t position[2];
+    };
+
+    static uint64_t pairKey(uint32_t a, uint32_t b);
+    bool overlapsOnAxis(uint32_t a, uint32_t b, int axis) const;
+    void sortAxis(int axis);
+    // Nets out the events from `first` on: sorting one axis against the other's stale order can
+    // add a pair the next sort removes again, or the other way round
+    void dropCancelledEvents(size_t first);
+    void addPair(uint32_t a, uint32_t b);
+    void removePair(uint32_t a, uint32_t b);
+
+    std::vector<Endpoint> endpoints[2];          // sorted endpoint lists for x and y
+    std::vector<EndpointIndex> endpointIndex[2]; // per axis, indexed by box id
+    AabbSoA boxes;
+    std::vector<uint32_t> freeIds;
+    std::unordered_set<uint64_t> pairs;
+    std::vector<PairEvent> events;
+    std::vector<uint32_t> eventOrder;  // scratch for dropCancelledEvents
+    std::vector<uint8_t> keptEvents;
+};
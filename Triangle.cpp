@@ -1,137 +1,375 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <cassert>
 #include <iostream>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+
+#include "AllocationCounter.h"
+#include "BatchRenderer.h"
+#include "Benchmark.h"
+#include "GpuTimer.h"
+#include "InputLog.h"
+#include "InstancedRenderer.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "SelfTest.h"
+#include "ShaderProgram.h"
+#include "Simulation.h"
+#include "SimulationThread.h"
 
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-
-// Vertex shader source code
-const char* vertexShaderSource = R"(
-#version 330 core
-layout(location = 0) in vec3 aPos;
-uniform mat4 transform;
-void main()
-{
-    gl_Position = transform * vec4(aPos, 1.0);
+// Helper function to initialize identity matrix
+void identityMatrix(float* matrix) {
+    for (int i = 0; i < 16; i++) {
+        matrix[i] = (i % 5 == 0) ? 1.0f : 0.0f;  // Set diagonal to 1, others to 0
+    }
 }
-)";
-
-// Fragment shader source code
-const char* fragmentShaderSource = R"(
-#version 330 core
-out vec4 FragColor;
-uniform vec4 triangleColor; // Color of the triangle
 
-void main()
-{
-    FragColor = triangleColor;
-}
-)";
-
-// Function to compile shader and check for errors
-GLuint compileShader(GLenum type, const char* source) {
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &source, nullptr);
-    glCompileShader(shader);
-
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-        std::cerr << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+// Set the colour based on the collision
+void setCollisionColor(bool isColliding, float* color) {
+    color[0] = 0.4f; // Default color (green)
+    color[1] = 0.8f;
+    color[2] = 0.6f;
+    color[3] = 1.0f;
+    if (isColliding) {
+        color[0] = 1.0f; // Red
+        color[1] = 0.0f; // No green
+        color[2] = 0.0f; // No blue
     }
-    return shader;
 }
 
-// Function to create shader program
-GLuint createShaderProgram() {
-    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
-    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
-
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    GLint success;
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
-        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+// Longest frame the simulation will catch up on, and the most time it may have banked and not yet
+// stepped; anything beyond is dropped so a stall can't make it run ever more steps to catch up
+const float maxFrameTime = 0.25f;
+
+// Where the frame profiler's Chrome trace goes, on F9 and on exit
+const char* const profileTracePath = "frame_profile.json";
+
+// Function to hand every body in `snapshot` to `renderer` between its last two simulated positions
+// using the snapshot's leftover fraction of a step, walking the body arrays front to back
+template <typename Renderer>
+void submitBodies(Renderer& renderer, const BodySnapshot& snapshot) {
+    const float alpha = snapshot.alpha;
+    renderer.begin();
+    for (size_t i = 0; i < snapshot.size(); i++) {
+        InstanceData instance = { snapshot.previousX[i] + (snapshot.x[i] - snapshot.previousX[i]) * alpha,
+            snapshot.previousY[i] + (snapshot.y[i] - snapshot.previousY[i]) * alpha,
+            1.0f, 1.0f, { 0.0f, 0.0f, 0.0f, 0.0f } };
+        setCollisionColor((snapshot.flags[i] & BodyColliding) != 0, instance.color);
+        if (snapshot.flags[i] & BodySquare) {
+            renderer.addSquare(instance);
+        }
+        else {
+            renderer.addTriangle(instance);
+        }
     }
+}
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    return shaderProgram;
+// Scripted input for headless runs: walk right into the square and back out again,
+// jumping once a second, so every run exercises both the jump and the collision paths
+InputState headlessInput(uint64_t tick) {
+    const uint64_t stepsPerSecond = static_cast<uint64_t>(1.0f / simulationStep + 0.5f);
+    const uint64_t cycle = tick % (8 * stepsPerSecond);
+    InputState input;
+    input.right = cycle < 4 * stepsPerSecond;
+    input.left = !input.right;
+    input.jump = tick % stepsPerSecond == 0;
+    return input;
 }
 
-// Helper function to initialize identity matrix
-void identityMatrix(float* matrix) {
-    for (int i = 0; i < 16; i++) {
-        matrix[i] = (i % 5 == 0) ? 1.0f : 0.0f;  // Set diagonal to 1, others to 0
+// Scene option bits, stored in input logs so a replay builds the same scene. With
+// sceneDecorationLayer the scattered squares go in a decoration layer that only pairs with the
+// default layer, so the broadphase drops every square-vs-square pair, the way a level skips
+// decoration-vs-decoration work.
+const uint32_t sceneDecorationLayer = 1u << 0;
+
+const uint32_t decorationCategory = 1u << 1;
+
+// Function to scatter `count` static squares over a square area that grows with the count, so
+// bigger scenes keep roughly the same density; seeded, so every run gets the same layout
+void addScatteredBodies(Simulation& simulation, uint64_t count, uint32_t sceneFlags) {
+    const float side = std::sqrt(static_cast<float>(count)) * 0.5f;
+    uint32_t seed = 0x9E3779B9u;
+    for (uint64_t i = 0; i < count; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        const float x = static_cast<float>(seed & 0xFFFF) / 65535.0f * side;
+        const float y = static_cast<float>(seed >> 16) / 65535.0f * side;
+        const BodyHandle body = simulation.addBody(1, x, y, BodySquare);
+        if (sceneFlags & sceneDecorationLayer) {
+            simulation.setCollisionFilter(body, decorationCategory, defaultCollisionCategory);
+        }
     }
 }
 
-// Helper function to create a translation matrix
-void createTranslationMatrix(float x, float y, float* matrix) {
-    identityMatrix(matrix);  // Start with identity matrix
-    matrix[3] = x;  // Translate on x-axis
-    matrix[7] = y;  // Translate on y-axis
+// Function to print the collision work of every layer pair that saw any
+void printLayerPairStats(const Simulation& simulation) {
+    std::cout << "layer pair      filtered    candidates     colliding\n";
+    for (int a = 0; a < collisionLayerCount; a++) {
+        for (int b = a; b < collisionLayerCount; b++) {
+            const LayerPairStats& stats = simulation.getLayerPairStats(a, b);
+            if (stats.filtered == 0 && stats.candidates == 0) {
+                continue;
+            }
+            std::cout << std::setw(4) << a << " vs " << std::setw(2) << b << std::setw(14) << stats.filtered
+                << std::setw(14) << stats.candidates << std::setw(14) << stats.colliding << "\n";
+        }
+    }
+    std::cout << std::flush;
 }
 
-// Collision detection function for two AABBs (Axis-Aligned Bounding Boxes)
-bool checkCollision(float x1, float y1, float width1, float height1,
-    float x2, float y2, float width2, float height2) {
-    return !(x1 + width1 < x2 || x1 > x2 + width2 || y1 + height1 < y2 || y1 > y2 + height2);
+// How far the headless sensor sweep looks, in units
+const float sensorRange = 4.0f;
+
+// Function to aim `count` unit-length rays evenly round a full turn, for a sensor sweep
+void aimSensorFan(size_t count, std::vector<float>& directionX, std::vector<float>& directionY) {
+    directionX.resize(count);
+    directionY.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const float angle = 6.2831853f * static_cast<float>(i) / static_cast<float>(count);
+        directionX[i] = std::cos(angle);
+        directionY[i] = std::sin(angle);
+    }
 }
 
-int checkCollisionDirection(float x1, float y1, float width1, float height1,
-    float x2, float y2, float width2, float height2) {
-    if (x1 + width1 > x2 && x1 < x2 + width2 && y1 + height1 > y2 && y1 < y2 + height2) {
-        // Left collision
-        if (x1 + width1 > x2 && x1 < x2) {
-            if (y1 + height1 > y2 && y1 < y2 + height2) {
-                return 1; // Collision from the left
+// Function to step the world with no window or GL context and report throughput. With `replay` the
+// scene, the step count and every step's keys come from the log and each step's checksum is
+// checked against it; otherwise the scripted input runs for `ticks` steps. An open `recorder` logs
+// every step. With `sensorRays`, after each step the player probes straight down for what it
+// stands over and sweeps that many rays round itself, the way AI sensors would. Checksums and
+// queries are left out of the reported step time.
+int runHeadless(uint64_t ticks, uint64_t extraBodies, uint32_t sceneFlags, unsigned threads, bool profile,
+    uint64_t sensorRays, const InputLog* replay, InputLogWriter& recorder) {
+    if (replay) {
+        ticks = replay->getTickCount();
+        extraBodies = replay->getExtraBodies();
+        sceneFlags = replay->getSceneFlags();
+        if (replay->getStep() != simulationStep) {
+            std::cerr << "WARNING::REPLAY::log was recorded with a step of " << replay->getStep()
+                << " s, this build steps " << simulationStep << " s; checksums won't match" << std::endl;
+        }
+    }
+    const bool checksums = replay || recorder.isOpen();
+    uint64_t mismatches = 0;
+    uint64_t firstMismatch = 0;
+    double checksumSeconds = 0.0;
+
+    Simulation simulation;
+    addScatteredBodies(simulation, extraBodies, sceneFlags);
+    simulation.setLayerStatsEnabled((sceneFlags & sceneDecorationLayer) != 0);
+    JobSystem jobs(threads);
+    simulation.setJobSystem(jobs.getThreadCount() > 1 ? &jobs : nullptr);
+    uint64_t collidingSteps = 0;
+    uint64_t collidingPairs = 0;
+    uint64_t contactBegins = 0;
+    uint64_t contactEnds = 0;
+    setProfilerEnabled(profile);
+
+    std::vector<float> sensorOriginX(sensorRays);
+    std::vector<float> sensorOriginY(sensorRays);
+    std::vector<float> sensorDirectionX;
+    std::vector<float> sensorDirectionY;
+    aimSensorFan(sensorRays, sensorDirectionX, sensorDirectionY);
+    std::vector<float> sensorTimes(sensorRays);
+    std::vector<BodyHandle> sensorHits(sensorRays);
+    uint64_t groundProbeHits = 0;
+    uint64_t sensorRayHits = 0;
+    double querySeconds = 0.0;
+
+#ifdef ALLOCATION_COUNTER
+    // After one full cycle of the scripted input every buffer has seen its largest step, so from
+    // then on a step must not touch the heap
+    const uint64_t warmupTicks = 8 * static_cast<uint64_t>(1.0f / simulationStep + 0.5f);
+#endif
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t tick = 0; tick < ticks; tick++) {
+#ifdef ALLOCATION_COUNTER
+        const uint64_t allocationsBefore = getAllocationCount();
+#endif
+        const InputState input = replay ? unpackInputKeys(replay->getRecord(tick).keys) : headlessInput(tick);
+        simulation.step(input);
+#ifdef ALLOCATION_COUNTER
+        // Recorded input can reach a bigger scene state at any point, so only scripted runs settle
+        assert(replay || tick < warmupTicks || getAllocationCount() == allocationsBefore);
+#endif
+        const size_t pairs = simulation.getCollidingPairs().size();
+        collidingSteps += pairs != 0 ? 1 : 0;
+        collidingPairs += pairs;
+        // Transitions only, the way game code would react to contacts
+        size_t events;
+        simulation.getContactEvents(ContactBegin, events);
+        contactBegins += events;
+        simulation.getContactEvents(ContactEnd, events);
+        contactEnds += events;
+
+        if (sensorRays != 0) {
+            const auto queryStart = std::chrono::steady_clock::now();
+            const BodyStore& bodies = simulation.getBodies();
+            const BodyHandle player = simulation.getPlayer();
+            const size_t playerIndex = bodies.indexOf(player);
+            const float centreX = bodies.x[playerIndex] + bodies.width[playerIndex] * 0.5f;
+            const float centreY = bodies.y[playerIndex] + bodies.height[playerIndex] * 0.5f;
+
+            // Down from the triangle's base to the top of whatever it is over
+            CastHit ground;
+            groundProbeHits += simulation.rayCast(centreX, bodies.y[playerIndex], 0.0f, -1.0f, sensorRange, ground,
+                allCollisionLayers, player) ? 1 : 0;
+
+            std::fill(sensorOriginX.begin(), sensorOriginX.end(), centreX);
+            std::fill(sensorOriginY.begin(), sensorOriginY.end(), centreY);
+            const RaySoAView sensors = { sensorOriginX.data(), sensorOriginY.data(), sensorDirectionX.data(),
+                sensorDirectionY.data(), sensorOriginX.size() };
+            simulation.rayCastBatch(sensors, sensorRange, sensorTimes.data(), sensorHits.data(), allCollisionLayers, player);
+            for (size_t r = 0; r < sensorHits.size(); r++) {
+                sensorRayHits += bodies.isValid(sensorHits[r]) ? 1 : 0;
             }
+            querySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - queryStart).count();
         }
 
-        // Right collision
-        if (x1 < x2 + width2 && x1 + width1 > x2 + width2) {
-            if (y1 + height1 > y2 && y1 < y2 + height2) {
-                return 2; // Collision from the right
+        if (checksums) {
+            const auto checksumStart = std::chrono::steady_clock::now();
+            const uint32_t checksum = simulation.computeChecksum();
+            if (replay && checksum != replay->getRecord(tick).checksum) {
+                firstMismatch = mismatches == 0 ? tick : firstMismatch;
+                mismatches++;
+            }
+            if (recorder.isOpen()) {
+                recorder.record(packInputKeys(input, false), checksum);
             }
+            checksumSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - checksumStart).count();
         }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+        - checksumSeconds - querySeconds;
+
+    std::cout << "bodies: " << simulation.getBodies().size() << "\n"
+        << "threads: " << jobs.getThreadCount() << "\n"
+        << "steps: " << simulation.getStepCount() << "\n"
+        << "seconds: " << seconds << "\n"
+        << "steps/sec: " << static_cast<uint64_t>(seconds > 0.0 ? simulation.getStepCount() / seconds : 0.0) << "\n"
+        << "colliding steps: " << collidingSteps << "\n"
+        << "colliding pairs: " << collidingPairs << "\n"
+        << "contact begins: " << contactBegins << "\n"
+        << "contact ends: " << contactEnds << "\n"
+        << "arena high-water bytes: " << simulation.getArena().getHighWaterMark() << "\n"
+        << "arena overflows: " << simulation.getArena().getOverflowCount() << std::endl;
+    if (sensorRays != 0) {
+        std::cout << "ground probe hits: " << groundProbeHits << "\n"
+            << "sensor ray hits: " << sensorRayHits << "\n"
+            << "query seconds: " << querySeconds << "\n"
+            << "ns per sensor ray: " << (ticks != 0 ? querySeconds * 1e9 / static_cast<double>(ticks * sensorRays) : 0.0)
+            << std::endl;
+    }
+    if (simulation.isLayerStatsEnabled()) {
+        printLayerPairStats(simulation);
+    }
+    if (profile) {
+        writeProfileTrace(profileTracePath);
+    }
+    if (recorder.isOpen() && !recorder.close()) {
+        std::cerr << "Failed to write the input log" << std::endl;
+        return -1;
+    }
+    if (replay) {
+        std::cout << "checksum mismatches: " << mismatches << std::endl;
+        if (mismatches != 0) {
+            std::cout << "first mismatch at step: " << firstMismatch << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
 
-        // Top collision
-        if (y1 + height1 > y2 && y1 < y2) {
-            if (x1 + width1 > x2 && x1 < x2 + width2) {
-                return 3; // Collision from the top
-            }
+int main(int argc, char** argv) {
+    // "--threads T" sets the collision worker count, caller included (default: every hardware thread)
+    // "--bodies M" adds M static squares to the scene
+    // "--profile" records timing zones in a headless run and writes them out at the end
+    // "--record F" logs every step's keys and world checksum to F, in a window or a headless run
+    // "--layers" puts the added squares in a decoration layer that doesn't pair with itself and
+    // prints the work per layer pair at the end of a headless run
+    // "--rays R" probes the ground and sweeps R sensor rays round the player after every headless step
+    unsigned threads = 0;
+    unsigned long long extraBodies = 0;
+    unsigned long long sensorRays = 0;
+    const char* recordPath = nullptr;
+    // "--instanced" draws with the instanced renderer instead of the batch renderer
+    bool profile = false;
+    bool useInstanced = false;
+    uint32_t sceneFlags = 0;
+    for (int i = 1; i < argc; i++) {
+        profile = profile || std::strcmp(argv[i], "--profile") == 0;
+        sceneFlags |= std::strcmp(argv[i], "--layers") == 0 ? sceneDecorationLayer : 0;
+        useInstanced = useInstanced || std::strcmp(argv[i], "--instanced") == 0;
+    }
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::strcmp(argv[i], "--threads") == 0) {
+            threads = static_cast<unsigned>(std::strtoul(argv[i + 1], nullptr, 10));
+        }
+        if (std::strcmp(argv[i], "--bodies") == 0) {
+            extraBodies = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+        if (std::strcmp(argv[i], "--record") == 0) {
+            recordPath = argv[i + 1];
         }
+        if (std::strcmp(argv[i], "--rays") == 0) {
+            sensorRays = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+    }
+    InputLogWriter recorder;
+    if (recordPath && !recorder.open(recordPath, extraBodies, sceneFlags)) {
+        std::cerr << "Failed to open " << recordPath << " for recording" << std::endl;
+        return -1;
+    }
 
-        // Bottom collision
-        if (y1 < y2 + height2 && y1 + height1 > y2 + height2) {
-            if (x1 + width1 > x2 && x1 < x2 + width2) {
-                return 4; // Collision from the bottom
+    // "--headless N" runs N simulation steps without opening a window
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            const unsigned long long ticks = i + 1 < argc ? std::strtoull(argv[i + 1], nullptr, 10) : 0;
+            if (ticks == 0) {
+                std::cerr << "Usage: " << argv[0] << " --headless <ticks> [--bodies <count>] [--layers] [--rays <count>] [--threads <count>] [--profile] [--record <file>]" << std::endl;
+                return -1;
             }
+            return runHeadless(ticks, extraBodies, sceneFlags, threads, profile, sensorRays, nullptr, recorder);
+        }
+        // "--replay F" reruns the log F headless, as fast as it will go, checking every step's checksum
+        if (std::strcmp(argv[i], "--replay") == 0) {
+            InputLog replay;
+            if (i + 1 >= argc || !replay.load(argv[i + 1])) {
+                std::cerr << "Usage: " << argv[0] << " --replay <input log> [--rays <count>] [--threads <count>] [--profile] [--record <file>]" << std::endl;
+                return -1;
+            }
+            return runHeadless(0, 0, 0, threads, profile, sensorRays, &replay, recorder);
+        }
+        // "--bench [file]" times the collision primitives and saves the results as JSON
+        if (std::strcmp(argv[i], "--bench") == 0) {
+            return runCollisionBenchmark(i + 1 < argc ? argv[i + 1] : "collision_bench.json");
+        }
+        // "--selftest" checks the collision code against reference versions of it; non-zero exit on a mismatch
+        if (std::strcmp(argv[i], "--selftest") == 0) {
+            return runSelfTests();
         }
     }
 
-    return 0; // No collision
-}
-
-int main() {
     // Initialize GLFW
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
         return -1;
     }
 
+    // Ask for a 3.3 core context explicitly; core-only drivers (Mesa's llvmpipe among them) would
+    // otherwise hand out a legacy 2.1 context. Forward compatibility is required on macOS.
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+
     // Create GLFW window and context
     GLFWwindow* window = glfwCreateWindow(1920, 1080, "Controllable Triangle with Collision", nullptr, nullptr);
     if (!window) {
@@ -141,157 +379,147 @@ int main() {
     }
     glfwMakeContextCurrent(window);
 
-    // Initialize GLEW
+    // Initialize GLEW. Without glewExperimental it looks entry points up through the extension
+    // string, which a core context doesn't have, and leaves core functions null.
+    glewExperimental = GL_TRUE;
     if (glewInit() != GLEW_OK) {
         std::cerr << "Failed to initialize GLEW" << std::endl;
         glfwTerminate();
         return -1;
     }
+    glGetError();  // glewInit still queries GL_EXTENSIONS the legacy way; drop the GL_INVALID_ENUM
+
+    // Every shape is written into one streamed vertex buffer and drawn in one call per material;
+    // the instanced renderer (one draw call per shape type) stays available for comparison
+    float viewTransform[16];
+    identityMatrix(viewTransform);
+    InstancedRenderer instancedRenderer;
+    BatchRenderer batchRenderer;
+    if (useInstanced) {
+        instancedRenderer.init(triangleVertices, triangleVertexCount, triangleIndices, triangleIndexCount,
+            squareVertices, squareVertexCount, squareIndices, squareIndexCount);
+        instancedRenderer.setViewTransform(viewTransform);
+    }
+    else {
+        batchRenderer.init(triangleVertices, triangleIndices, triangleIndexCount,
+            squareVertices, squareIndices, squareIndexCount, 4096);
+        batchRenderer.setViewTransform(viewTransform);
+    }
 
-    float vertices[] = {
-        0.0f,  0.25f, 0.0f,  // Top vertex (smaller)
-       -0.25f, -0.25f, 0.0f,  // Bottom-left vertex
-        0.25f, -0.25f, 0.0f   // Bottom-right vertex
-    };
-
-    // Square vertices
-    float squareVertices[] = {
-        -0.5f, -0.5f, 0.0f,
-        -0.5f, -0.25f, 0.0f,
-        -0.25f, -0.25f, 0.0f,
-        -0.25f, -0.5f, 0.0f
-    };
-
-    // Generate VAOs and VBOs
-    GLuint VAO[2], VBO[2];
-    glGenVertexArrays(2, VAO);
-    glGenBuffers(2, VBO);
-
-    // Triangle
-    glBindVertexArray(VAO[0]);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    // Square
-    glBindVertexArray(VAO[1]);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(squareVertices), squareVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    // Compile and link shader program
-    GLuint shaderProgram = createShaderProgram();
-    glUseProgram(shaderProgram);
-
-    // Initial object positions
-    float translationX = -1.0f;
-    float translationY = -0.75f;  // Align triangle with square
-    float squareTranslationX = 0.0f;
-    float squareTranslationY = -0.5f;  // Square aligned to same horizontal axis
-
-    // Jumping variables
-    bool isJumping = false;
-    bool isFalling = false;
-    float jumpHeight = 0.0f;
-    float jumpSpeed = 0.1f;
-    float jumpStartTime = 0.0f;
-    float jumpDuration = 1.0f;
+    // GPU time per render pass, reported with the CPU zones
+    GpuTimer gpuTimer;
+    gpuTimer.init();
+
+    // The simulation steps on a thread of its own; the render loop only banks time and keys for it
+    // and draws whatever step it finished last, so a slow step costs a stale frame, not a late one
+    Simulation simulation;
+    addScatteredBodies(simulation, extraBodies, sceneFlags);
+    SimulationThread simulationThread(simulation, maxFrameTime, recorder.isOpen() ? &recorder : nullptr);
+    simulationThread.start(threads);
+    BodySnapshot snapshot;
 
     // Time tracking
-    float deltaTime = 0.0f;
-    float lastFrame = 0.0f;
+    float lastFrame = static_cast<float>(glfwGetTime());
+
+    // Sync buffer swaps to the display so rendering doesn't spin faster than it can be shown
+    glfwSwapInterval(1);
+
+    // Zones are recorded for the whole session; F9 writes what the rings hold so far
+    setProfilerEnabled(true);
+    bool profileKeyWasDown = false;
 
     // Render loop
     while (!glfwWindowShouldClose(window)) {
-        // Calculate deltaTime
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
+        PROFILE_ZONE("frame");
+
+        // Calculate the frame time, to bank for the fixed-rate simulation with this frame's keys
+        float currentFrame = static_cast<float>(glfwGetTime());
+        float frameTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        if (frameTime > maxFrameTime) {
+            frameTime = maxFrameTime;  // Drop time after a stall instead of trying to catch up
+        }
 
         // Process input
-        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-            glfwSetWindowShouldClose(window, true);
-
-        // Control triangle movement
-        if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-            translationX -= 0.01f;
-        if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-            translationX += 0.01f;
-
-        // Start jump when space is pressed
-        if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && !isJumping) {
-            isJumping = true;
-            jumpStartTime = currentFrame;
-            isFalling = false;
+        InputState input;
+        bool escape;
+        {
+            PROFILE_ZONE("input");
+            escape = glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS;
+            if (escape)
+                glfwSetWindowShouldClose(window, true);
+
+            input.left = glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS;
+            input.right = glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS;
+            input.jump = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+
+            const bool profileKeyDown = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+            if (profileKeyDown && !profileKeyWasDown) {
+                simulationThread.writeProfileTrace(profileTracePath);
+            }
+            profileKeyWasDown = profileKeyDown;
         }
 
-        // Handle jumping logic
-        if (isJumping) {
-            float jumpProgress = (currentFrame - jumpStartTime) / jumpDuration;
-            if (jumpProgress < 1.0f) {
-                jumpHeight = sinf(jumpProgress * M_PI) * 0.5f;  // Upward motion
+        // Bank the frame for the simulation thread, which runs as many fixed steps as it covers
+        simulationThread.advance(frameTime, packInputKeys(input, escape));
+
+        // Hand the bodies to the renderer as the last finished step left them, interpolated by the
+        // leftover fraction of a step
+        {
+            PROFILE_ZONE("submit shapes");
+            simulationThread.takeSnapshot(snapshot);
+            if (useInstanced) {
+                submitBodies(instancedRenderer, snapshot);
             }
             else {
-                jumpHeight = 0.0f;
-                isJumping = false;
-                isFalling = true;  // Start falling
+                // Room for every body as a square, the larger of the two meshes
+                batchRenderer.reserve(snapshot.size() * squareIndexCount);
+                submitBodies(batchRenderer, snapshot);
             }
         }
 
-        // Handle falling logic
-        if (isFalling) {
-            jumpHeight -= jumpSpeed;  // Move down after jump
-            if (jumpHeight <= 0.0f) {
-                jumpHeight = 0.0f;
-                isFalling = false;  // Land when touching the ground (adjust this logic if you have a ground)
+        // Rendering the scene (triangle and square)
+        {
+            PROFILE_ZONE("draw");
+            glClear(GL_COLOR_BUFFER_BIT);
+            if (useInstanced) {
+                instancedRenderer.draw(&gpuTimer);
+            }
+            else {
+                batchRenderer.draw(&gpuTimer);
             }
+            gpuTimer.endFrame();
         }
 
-        // Only check for collision when falling
-        bool isColliding = checkCollision(
-            translationX, translationY + jumpHeight, 0.5f, 0.5f,  // Triangle position and size
-            squareTranslationX - 0.25f, squareTranslationY - 0.25f, 0.5f, 0.5f // Square position and size
-        );
-
-        // Set the triangle's color based on the collision
-        float triangleColor[4] = { 0.4f, 0.8f, 0.6f, 1.0f }; // Default color (green)
-        if (isColliding) {
-            triangleColor[0] = 1.0f; // Red
-            triangleColor[1] = 0.0f; // No green
-            triangleColor[2] = 0.0f; // No blue
+        {
+            PROFILE_ZONE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
+        {
+            PROFILE_ZONE("glfwPollEvents");
+            glfwPollEvents();
         }
 
-        // Set the uniform for the triangle color
-        GLuint colorLoc = glGetUniformLocation(shaderProgram, "triangleColor");
-        glUniform4fv(colorLoc, 1, triangleColor);
-
-        // Rendering the scene (triangle and square)
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        // Draw the triangle
-        float transform[16];
-        createTranslationMatrix(translationX, translationY + jumpHeight, transform);
-        GLuint transformLoc = glGetUniformLocation(shaderProgram, "transform");
-        glUniformMatrix4fv(transformLoc, 1, GL_TRUE, transform);
-        glBindVertexArray(VAO[0]);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-
-        // Draw the square
-        createTranslationMatrix(squareTranslationX, squareTranslationY, transform);
-        glUniformMatrix4fv(transformLoc, 1, GL_TRUE, transform);
-        glBindVertexArray(VAO[1]);
-        glDrawArrays(GL_QUADS, 0, 4);
-
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+#ifdef SHADER_QUERY_DEBUG
+        // Uniforms are resolved up front; any lookup by name during the frame is a regression
+        if (getStrayUniformQueries() != 0) {
+            std::cerr << "WARNING::SHADER::" << getStrayUniformQueries() << " glGetUniformLocation calls this frame" << std::endl;
+            resetStrayUniformQueries();
+        }
+#endif
     }
 
+    // Runs out the steps banked by the last frame, so the recording ends on the escape key
+    simulationThread.stop();
+    writeProfileTrace(profileTracePath);
+    if (recorder.isOpen()) {
+        if (recorder.close()) {
+            std::cout << "Recorded " << recorder.getTickCount() << " steps to " << recordPath << std::endl;
+        }
+        else {
+            std::cerr << "Failed to write the input log " << recordPath << std::endl;
+        }
+    }
     glfwTerminate();
     return 0;
 }
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+// Small deterministic generator, so every benchmark and self-test run works on identical data
+struct XorShift {
+    uint64_t state;
+
+    explicit XorShift(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    // Uniform float in [low, high)
+    float range(float low, float high) {
+        return low + (high - low) * static_cast<float>(next() >> 40) * (1.0f / 16777216.0f);
+    }
+};